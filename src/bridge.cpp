@@ -1,67 +1,54 @@
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
 #include <optional>
 #include "bridge.hpp"
 
 #if defined(_WIN32)
+// keeps windows.h from defining min and max macros, which break std::min and std::max below
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
 class NamedPipeBridge final: public SlimeVRBridge {
     private:
         static constexpr char* pipe_name = "\\\\.\\pipe\\SlimeVRInput";
         HANDLE pipe = INVALID_HANDLE_VALUE;
-        // our buffer "size" will probably always be 0, we're just making use of the capacity.
-        std::vector<uint8_t> buffer;
 
         void pipe_error() {
             status = BRIDGE_ERROR;
             fmt::print("Bridge error: 0x{:x}\n", GetLastError());
         }
     public:
-        bool getNextMessage(messages::ProtobufMessage &msg) final override {
-            if (status != BRIDGE_CONNECTED) {
-                return false;
-            }
+        explicit NamedPipeBridge(const BridgeConfig &config) : SlimeVRBridge(config) {}
 
-            DWORD read_bytes = 0;
-            uint8_t size_bytes[4];
-            if (!PeekNamedPipe(pipe, size_bytes, 4, &read_bytes, NULL, NULL)) {
+    protected:
+        bool readAvailable(FrameDecoder &decoder) final override {
+            DWORD available = 0;
+            if (!PeekNamedPipe(pipe, NULL, 0, NULL, &available, NULL)) {
                 pipe_error();
                 return false;
-            } else if (read_bytes != 4) {
+            } else if (available == 0) {
                 return false;
             }
 
-            DWORD size = size_bytes[0] | size_bytes[1] << 8 | size_bytes[2] << 16 | size_bytes[3] << 24;
-            buffer.reserve(size);
-            if (!ReadFile(pipe, buffer.data(), size, &read_bytes, NULL)) {
+            DWORD read_bytes = 0;
+            if (!ReadFile(pipe, decoder.PrepareWrite(available), available, &read_bytes, NULL)) {
                 pipe_error();
                 return false;
             }
+            decoder.CommitWrite(read_bytes);
 
-            return msg.ParseFromArray(buffer.data() + 4, size - 4);
+            return read_bytes > 0;
         }
 
-        bool sendMessage(messages::ProtobufMessage &msg) final override {
-            if (status != BRIDGE_CONNECTED) {
-                return false;
-            }
-
-            DWORD size = msg.ByteSizeLong() + 4; // wire size includes 4 bytes for size
-            buffer.reserve(size);
-
-            buffer[0] = size & 0xFF;
-            buffer[1] = (size >> 8) & 0xFF;
-            buffer[2] = (size >> 16) & 0xFF;
-            buffer[3] = (size >> 24) & 0xFF;
-            if (!msg.SerializeToArray(buffer.data() + 4, size - 4)) {
-                return false;
-            }
-            
+        bool writeBatch(const uint8_t *data, size_t size) final override {
             DWORD _written = 0;
-            if (!WriteFile(pipe, buffer.data(), size, &_written, NULL)) {
+            if (!WriteFile(pipe, data, (DWORD)size, &_written, NULL)) {
                 pipe_error();
                 return false;
             }
@@ -89,6 +76,11 @@ class NamedPipeBridge final: public SlimeVRBridge {
 
 #else
 #include "unix_sockets.hpp"
+#include "outbound_queue.hpp"
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include "shm_ring.hpp"
+#endif
 
 #include <cstdlib>
 #include <filesystem>
@@ -101,152 +93,370 @@ private:
     static constexpr std::string_view XDG_DATA_DIR_DEFAULT = ".local/share";
     static constexpr std::string_view SLIMEVR_DATA_DIR = "slimevr";
     static constexpr std::string_view SOCKET_NAME = "SlimeVRInput";
-    inline static constexpr int HEADER_SIZE = 4;
-    inline static constexpr int BUFFER_SIZE = 1024;
-    using ByteBuffer = std::array<uint8_t, BUFFER_SIZE>;
-
-    ByteBuffer byteBuffer;
+    // read at least this much at a time, more if a bigger message is waiting to complete
+    inline static constexpr size_t RECV_CHUNK_SIZE = 4096;
+    // largest message that can be received in SeqPacket mode, anything bigger is a broken connection
+    inline static constexpr size_t MAX_PACKET_SIZE = 64 * 1024;
+    // with LatestPoseWins anything sitting in the kernel buffer can't be coalesced anymore, so keep it small
+    inline static constexpr int COALESCING_SEND_BUFFER_SIZE = 4096;
     BasicLocalClient client;
+    OutboundQueue queue;
+    const bool coalescing;
+    const SocketMode socket_mode;
+    uint64_t reported_drops = 0;
+    bool dropping = false;
+    int send_buffer_size = 0; // as the kernel reports it, read once per connection
 
-    /// @return iterator after header
-    template <typename TBufIt>
-    std::optional<TBufIt> WriteHeader(TBufIt bufBegin, int bufSize, int msgSize) {
-        const int totalSize = msgSize + HEADER_SIZE; // include header bytes in total size
-        if (bufSize < totalSize) return std::nullopt; // header won't fit
-
-        const auto size = static_cast<uint32_t>(totalSize);
-        TBufIt it = bufBegin;
-        *(it++) = static_cast<uint8_t>(size);
-        *(it++) = static_cast<uint8_t>(size >> 8U);
-        *(it++) = static_cast<uint8_t>(size >> 16U);
-        *(it++) = static_cast<uint8_t>(size >> 24U);
-        return it;
-    }
-    /// @return iterator after header
-    template <typename TBufIt>
-    std::optional<TBufIt> ReadHeader(TBufIt bufBegin, int numBytesRecv, int& outMsgSize) {
-        if (numBytesRecv < HEADER_SIZE) return std::nullopt; // header won't fit
-
-        uint32_t size = 0;
-        TBufIt it = bufBegin;
-        size = static_cast<uint32_t>(*(it++));
-        size |= static_cast<uint32_t>(*(it++)) << 8U;
-        size |= static_cast<uint32_t>(*(it++)) << 16U;
-        size |= static_cast<uint32_t>(*(it++)) << 24U;
-
-        const auto totalSize = static_cast<int>(size);
-        if (totalSize < HEADER_SIZE) return std::nullopt;
-        outMsgSize = totalSize - HEADER_SIZE;
-        return it;
+    // retry delays while the server isn't there, a new socket showing up skips the wait
+    inline static constexpr std::chrono::milliseconds MIN_RETRY_DELAY{50};
+    inline static constexpr std::chrono::milliseconds MAX_RETRY_DELAY{5000};
+    // candidates in order of preference, resolved once since the environment doesn't change under us
+    std::vector<fs::path> socket_paths;
+#if defined(__linux__)
+    // watches the directories of socket_paths for the socket being created, only while disconnected
+    Descriptor inotify = -1;
+#endif
+    std::chrono::milliseconds retry_delay = MIN_RETRY_DELAY;
+    std::chrono::steady_clock::time_point next_attempt = std::chrono::steady_clock::now();
+    uint64_t connect_attempts = 0;
+
+    static std::vector<fs::path> resolveSocketPaths() {
+        std::vector<fs::path> paths;
+        if (const char* ptr = std::getenv("XDG_RUNTIME_DIR")) {
+            const fs::path xdg_runtime = ptr;
+            paths.push_back(xdg_runtime / SOCKET_NAME);
+        }
+        paths.push_back(fs::path(TMP_DIR) / SOCKET_NAME);
+        // try using home dir if the vrserver is run in a chroot like
+        if (const char* ptr = std::getenv("XDG_DATA_DIR")) {
+            const fs::path data_dir = ptr;
+            paths.push_back(data_dir / SLIMEVR_DATA_DIR / SOCKET_NAME);
+        } else if (const char* ptr = std::getenv("HOME")) {
+            const fs::path home = ptr;
+            paths.push_back(home / XDG_DATA_DIR_DEFAULT / SLIMEVR_DATA_DIR / SOCKET_NAME);
+        }
+        return paths;
     }
 
-    void connect() final {
-        if (!client.IsOpen()) {
-            fs::path socket;
-            // TODO: do this once in the constructor or something
-            if(const char* ptr = std::getenv("XDG_RUNTIME_DIR")) {
-                const fs::path xdg_runtime = ptr;
-                socket = (xdg_runtime / SOCKET_NAME);
+#if defined(__linux__)
+    void watchSocketDirectories() {
+        if (inotify != -1) return;
+        const std::optional<SysReturn> fd = SysCallBlocking(::inotify_init1, IN_NONBLOCK | IN_CLOEXEC);
+        if (!fd || fd->IsError()) {
+            fmt::print("bridge: can't watch for the socket, falling back to polling.\n");
+            return;
+        }
+        inotify = fd->Unwrap();
+        for (const fs::path &path : socket_paths) {
+            // directories that don't exist yet are only covered by the retries
+            (void)SysCall(::inotify_add_watch, inotify, path.parent_path().c_str(), IN_CREATE | IN_MOVED_TO);
+        }
+    }
+    // while connected every file created next to the socket would queue an event until the next disconnect
+    void unwatchSocketDirectories() {
+        if (inotify == -1) return;
+        (void)SysCall(::close, inotify);
+        inotify = -1;
+    }
+    // drains pending inotify events, true if one of them was for a file named like the socket
+    bool socketAppeared() {
+        if (inotify == -1) return false;
+        bool appeared = false;
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            const std::optional<SysReturn> bytes = SysCallBlocking(::read, inotify, buffer, sizeof(buffer));
+            if (!bytes || bytes->IsError() || bytes->Unwrap() <= 0) break;
+            for (char *it = buffer; it < buffer + bytes->Unwrap(); ) {
+                const auto *event = reinterpret_cast<const inotify_event *>(it);
+                if (event->len > 0 && SOCKET_NAME == event->name) appeared = true;
+                it += sizeof(inotify_event) + event->len;
             }
-            if(!fs::exists(socket)) {
-                socket = (fs::path(TMP_DIR) / SOCKET_NAME);
+        }
+        return appeared;
+    }
+#else
+    void watchSocketDirectories() {}
+    void unwatchSocketDirectories() {}
+    bool socketAppeared() { return false; }
+#endif
+
+    void openClient(const fs::path &socket) {
+        if (socket_mode == SocketMode::SeqPacket) {
+            try {
+                client.Open(socket.native(), LocalSocketType::SeqPacket);
+                return;
+            } catch (const std::system_error& e) {
+                if (e.code() != std::errc::wrong_protocol_type) throw;
+                fmt::print("bridge socket: server doesn't accept seqpacket connections, using a stream.\n");
             }
-            // try using home dir if the vrserver is run in a chroot like
-            if(!fs::exists(socket)) {
-                if (const char* ptr = std::getenv("XDG_DATA_DIR")) {
-                    const fs::path data_dir = ptr;
-                    socket = (data_dir / SLIMEVR_DATA_DIR / SOCKET_NAME);
-                } else if (const char* ptr = std::getenv("HOME")) {
-                    const fs::path home = ptr;
-                    socket = (home / XDG_DATA_DIR_DEFAULT / SLIMEVR_DATA_DIR / SOCKET_NAME);
+        }
+        client.Open(socket.native(), LocalSocketType::Stream);
+    }
+
+    bool tryConnect(const fs::path &socket) {
+        fmt::print("bridge socket: {}\n", std::string(socket));
+        try {
+            openClient(socket);
+            if (coalescing) client.SetSendBufferSize(COALESCING_SEND_BUFFER_SIZE);
+            send_buffer_size = client.GetSendBufferSize();
+            queue.Start(client.GetDescriptor(), client.GetType());
+            status = BRIDGE_CONNECTED;
+            return true;
+        } catch (const std::exception& e) {
+            client.Close();
+            fmt::print("bridge connect error: {}\n", e.what());
+            return false;
+        }
+    }
+
+    // runs every tick while disconnected, so it only touches the filesystem when a retry is due
+    // or the socket was just created.
+    void connect() final {
+        if (client.IsOpen()) return;
+
+        const auto now = std::chrono::steady_clock::now();
+        if (!socketAppeared() && now < next_attempt) return;
+
+        connect_attempts += 1;
+        for (const fs::path &socket : socket_paths) {
+            std::error_code ec;
+            if (fs::exists(socket, ec)) {
+                if (tryConnect(socket)) {
+                    // a retry that was still pending mustn't hold up the first attempt after the next disconnect
+                    retry_delay = MIN_RETRY_DELAY;
+                    next_attempt = now;
+                    unwatchSocketDirectories();
+                    return;
                 }
-            }
-            if(fs::exists(socket)) {
-                fmt::print("bridge socket: {}", std::string(socket));
-                client.Open(socket.native());
+                break; // the preferred socket is there but not answering, don't fall through to another server's
             }
         }
+
+        next_attempt = now + retry_delay;
+        retry_delay = std::min(retry_delay * 2, MAX_RETRY_DELAY);
     }
     void reset() final {
+        queue.Stop();
         client.Close();
+        status = BRIDGE_DISCONNECTED;
+        watchSocketDirectories();
     }
+    // the socket is only ever closed by reset(), so the descriptor stays valid for the tick loop until then.
+    // a closed connection shows up as a recv of 0 bytes in readAvailable, or a failed send on the I/O thread.
     void update() final {
-        client.UpdateOnce();
+        if (queue.IsFailed()) {
+            fmt::print("bridge send queue stopped, reconnecting.\n");
+            status = BRIDGE_ERROR;
+        }
+
+        // only log the start and end of an overflow, not every dropped write
+        const QueueStats stats = queue.GetStats();
+        if (stats.dropped_writes != reported_drops && !dropping) {
+            fmt::print("bridge send queue full, dropping messages.\n");
+            dropping = true;
+        } else if (stats.dropped_writes == reported_drops && dropping) {
+            fmt::print("bridge send queue recovered, {} writes dropped so far.\n", stats.dropped_writes);
+            dropping = false;
+        }
+        reported_drops = stats.dropped_writes;
+
+        // whatever the I/O thread already handed to the kernel but the server hasn't read
+        if (client.IsOpen()) {
+            recordQueueDepth(client.GetSendQueueSize().value_or(-1), client.GetRecvQueueSize().value_or(-1), send_buffer_size);
+        }
     }
 
 public:
-    bool getNextMessage(messages::ProtobufMessage &msg) final {
-        if (!client.IsOpen()) return false;
+    explicit UnixSocketBridge(const BridgeConfig &config) : SlimeVRBridge(config),
+        queue(config.queue_size, config.drop_policy),
+        coalescing(config.backpressure == BackpressureMode::LatestPoseWins),
+        socket_mode(config.socket_mode),
+        socket_paths(resolveSocketPaths()) {
+        watchSocketDirectories();
+    }
+    ~UnixSocketBridge() {
+        unwatchSocketDirectories();
+    }
+
+    QueueStats getQueueStats() const final {
+        return queue.GetStats();
+    }
 
-        int bytesRecv = 0;
+    ReconnectStats getReconnectStats() const final {
+        return {connect_attempts, retry_delay};
+    }
+
+    int getReadDescriptor() const final {
+        return status == BRIDGE_CONNECTED && client.IsOpen() ? client.GetDescriptor() : -1;
+    }
+
+protected:
+    bool readAvailable(FrameDecoder &decoder) final {
+        if (!client.IsOpen()) return false;
+        if (client.GetType() == LocalSocketType::SeqPacket) return readPacket(decoder);
+        const size_t wanted = std::max(RECV_CHUNK_SIZE, decoder.GetPendingFrameSize());
+        uint8_t *dest = decoder.PrepareWrite(wanted);
         try {
-            bytesRecv = client.RecvOnce(byteBuffer.begin(), HEADER_SIZE);
+            const std::optional<int> bytesRecv = client.RecvAvailable(dest, static_cast<int>(wanted));
+            if (!bytesRecv) return false; // nothing waiting
+            if (*bytesRecv == 0) {
+                fmt::print("bridge recv error: server closed the connection\n");
+                status = BRIDGE_ERROR;
+                return false;
+            }
+            decoder.CommitWrite(static_cast<size_t>(*bytesRecv));
+            return true;
         } catch (const std::exception& e) {
-            client.Close();
-            fmt::print("bridge send error: {}\n", e.what());
-            return false;
-        }
-        if (bytesRecv == 0) return false; // no message waiting
-
-        int msgSize = 0;
-        const std::optional msgBeginIt = ReadHeader(byteBuffer.begin(), bytesRecv, msgSize);
-        if (!msgBeginIt) {
-            fmt::print("bridge recv error: invalid message header or size\n");
-            return false;
-        }
-        if (msgSize <= 0) {
-            fmt::print("bridge recv error: empty message\n");
+            status = BRIDGE_ERROR;
+            fmt::print("bridge recv error: {}\n", e.what());
             return false;
         }
+    }
+    // one whole message per recv, the size prefix is put back so the decoder sees the same frames as a stream
+    bool readPacket(FrameDecoder &decoder) {
+        uint8_t *dest = decoder.PrepareWrite(HEADER_SIZE + MAX_PACKET_SIZE);
         try {
-            if (!client.RecvAll(*msgBeginIt, msgSize)) {
-                fmt::print("bridge recv error: client closed\n");
+            const std::optional<int> bytesRecv = client.RecvMessage(dest + HEADER_SIZE, static_cast<int>(MAX_PACKET_SIZE));
+            if (!bytesRecv) return false; // nothing waiting
+            if (*bytesRecv == 0) {
+                // an empty message can't be told apart from the end of the connection, so the server never sends one
+                fmt::print("bridge recv error: server closed the connection\n");
+                status = BRIDGE_ERROR;
+                return false;
+            }
+            if (static_cast<size_t>(*bytesRecv) > MAX_PACKET_SIZE) {
+                fmt::print("bridge recv error: message of {} bytes is too big\n", *bytesRecv);
+                status = BRIDGE_ERROR;
                 return false;
             }
+            const auto size = static_cast<uint32_t>(HEADER_SIZE + *bytesRecv);
+            dest[0] = size & 0xFF;
+            dest[1] = (size >> 8) & 0xFF;
+            dest[2] = (size >> 16) & 0xFF;
+            dest[3] = (size >> 24) & 0xFF;
+            decoder.CommitWrite(size);
+            return true;
         } catch (const std::exception& e) {
-            client.Close();
-            fmt::print("bridge send error: {}\n", e.what());
-            return false;
-        }
-        if (!msg.ParseFromArray(&(**msgBeginIt), msgSize)) {
-            fmt::print("bridge recv error: failed to parse\n");
+            status = BRIDGE_ERROR;
+            fmt::print("bridge recv error: {}\n", e.what());
             return false;
         }
-
-        return true;
     }
-    bool sendMessage(messages::ProtobufMessage &msg) final {
+    size_t writableBytes() const final {
+        // only hand over the next batch once the last one is on its way, whatever is waiting
+        // in the queue is already too late to be replaced by a newer pose.
+        return queue.IsEmpty() ? queue.GetWritable() : 0;
+    }
+    bool writeBatch(const uint8_t *data, size_t size) final {
         if (!client.IsOpen()) return false;
-        const auto bufBegin = byteBuffer.begin();
-        const auto bufferSize = static_cast<int>(std::distance(bufBegin, byteBuffer.end()));
-        const auto msgSize = static_cast<int>(msg.ByteSizeLong());
-        const std::optional msgBeginIt = WriteHeader(bufBegin, bufferSize, msgSize);
-        if (!msgBeginIt) {
-            fmt::print("bridge send error: failed to write header\n");
+        // never blocks, the I/O thread does the actual sending
+        if (!queue.Push(data, size)) {
+            if (queue.IsFailed()) status = BRIDGE_ERROR;
             return false;
         }
-        if (!msg.SerializeToArray(&(**msgBeginIt), msgSize)) {
-            fmt::print("bridge send error: failed to serialize\n");
-            return false;
-        }
-        int bytesToSend = static_cast<int>(std::distance(bufBegin, *msgBeginIt + msgSize));
-        if (bytesToSend <= 0) {
-            fmt::print("bridge send error: empty message\n");
-            return false;
+        return true;
+    }
+};
+
+#if defined(__linux__)
+// frames go straight into a ring in memory shared with the server, no syscalls unless the server is asleep.
+class ShmBridge final : public SlimeVRBridge {
+private:
+    static constexpr std::string_view SEGMENT_NAME = "/SlimeVRInput";
+    // checking whether the server is still running is a syscall, so don't do it every frame
+    inline static constexpr uint32_t LIVENESS_CHECK_FRAMES = 100;
+    std::optional<ShmEndpoint> endpoint;
+    const DropPolicy drop_policy;
+    const bool coalescing;
+    uint32_t frames_since_check = 0;
+    QueueStats stats;
+
+    // retry delays while the server isn't there, opening the segment is a couple of syscalls
+    inline static constexpr std::chrono::milliseconds MIN_RETRY_DELAY{50};
+    inline static constexpr std::chrono::milliseconds MAX_RETRY_DELAY{5000};
+    std::chrono::milliseconds retry_delay = MIN_RETRY_DELAY;
+    std::chrono::steady_clock::time_point next_attempt = std::chrono::steady_clock::now();
+    uint64_t connect_attempts = 0;
+
+    // runs every tick while disconnected, so it only tries to open the segment when a retry is due.
+    void connect() final {
+        const auto now = std::chrono::steady_clock::now();
+        if (now < next_attempt) return;
+
+        connect_attempts += 1;
+        std::optional<ShmEndpoint> opened = ShmEndpoint::Open(SEGMENT_NAME);
+        if (!opened) {
+            next_attempt = now + retry_delay;
+            retry_delay = std::min(retry_delay * 2, MAX_RETRY_DELAY);
+            return;
         }
-        if (bytesToSend > bufferSize) {
-            fmt::print("bridge send error: message too big\n");
-            return false;
+        endpoint.emplace(std::move(*opened));
+        fmt::print("bridge shared memory: {}\n", SEGMENT_NAME);
+        stats.capacity = endpoint->Outbound().GetCapacity();
+        frames_since_check = 0;
+        retry_delay = MIN_RETRY_DELAY;
+        status = BRIDGE_CONNECTED;
+    }
+    void reset() final {
+        endpoint.reset();
+        status = BRIDGE_DISCONNECTED;
+    }
+    void update() final {
+        if (++frames_since_check < LIVENESS_CHECK_FRAMES) return;
+        frames_since_check = 0;
+        if (!endpoint || !endpoint->IsPeerAlive()) {
+            fmt::print("bridge shared memory: server went away.\n");
+            status = BRIDGE_ERROR;
         }
-        try {
-            return client.Send(bufBegin, bytesToSend);
-        } catch (const std::exception& e) {
-            client.Close();
-            fmt::print("bridge send error: {}\n", e.what());
+    }
+
+public:
+    explicit ShmBridge(const BridgeConfig &config) : SlimeVRBridge(config),
+        drop_policy(config.drop_policy),
+        coalescing(config.backpressure == BackpressureMode::LatestPoseWins) {}
+
+    QueueStats getQueueStats() const final {
+        return stats;
+    }
+
+    ReconnectStats getReconnectStats() const final {
+        return {connect_attempts, retry_delay};
+    }
+
+protected:
+    bool readAvailable(FrameDecoder &decoder) final {
+        if (!endpoint) return false;
+        SpscRingView inbound = endpoint->Inbound();
+        const auto regions = inbound.Peek();
+        const size_t total = regions[0].size + regions[1].size;
+        if (total == 0) return false;
+
+        uint8_t *dest = decoder.PrepareWrite(total);
+        std::memcpy(dest, regions[0].data, regions[0].size);
+        std::memcpy(dest + regions[0].size, regions[1].data, regions[1].size);
+        decoder.CommitWrite(total);
+        inbound.Consume(total);
+        return true;
+    }
+    size_t writableBytes() const final {
+        if (!endpoint) return 0;
+        const SpscRingView outbound = const_cast<ShmEndpoint&>(*endpoint).Outbound();
+        if (coalescing && !outbound.IsEmpty()) return 0; // same as the socket, wait for the server to catch up
+        return outbound.GetCapacity() - outbound.GetUsed();
+    }
+    bool writeBatch(const uint8_t *data, size_t size) final {
+        if (!endpoint) return false;
+        if (!endpoint->Write(data, size)) {
+            stats.dropped_writes += 1;
+            stats.dropped_bytes += size;
+            if (drop_policy == DropPolicy::Reconnect) status = BRIDGE_ERROR;
             return false;
         }
+        stats.high_water = std::max(stats.high_water, endpoint->Outbound().GetUsed());
+        return true;
     }
 };
+#endif
 
 #endif
 
@@ -254,12 +464,31 @@ bool SlimeVRBridge::runFrame() {
     switch (status) {
         case BRIDGE_DISCONNECTED:
             connect();
-            return status == BRIDGE_CONNECTED;
+            if (status == BRIDGE_CONNECTED) {
+                connection_id += 1;
+                startHandshake();
+                return true;
+            }
+            return false;
         case BRIDGE_ERROR:
             reset();
+            clearBuffers();
             return false;
         case BRIDGE_CONNECTED:
             update();
+            if (handshake == HandshakeState::Pending && std::chrono::steady_clock::now() >= handshake_deadline) {
+                // nothing changes, the basic protocol is all that's been used so far anyway.
+                handshake = HandshakeState::Unanswered;
+                fmt::print("bridge: server didn't answer the handshake, sticking to the basic protocol.\n");
+            }
+            if (serverSupports(messages::PingPong_Feature_ROUND_TRIP)) {
+                const auto now = std::chrono::steady_clock::now();
+                // a ping that never gets answered isn't retried, the next one measures the link just as well
+                if (now >= next_ping) {
+                    next_ping = now + PING_INTERVAL;
+                    ping_due = true;
+                }
+            }
             return false;
         default:
             // uhhh, what?
@@ -269,12 +498,497 @@ bool SlimeVRBridge::runFrame() {
     }
 }
 
-// TODO: take some kind of configuration input for switching between named pipes, unix sockets, websockets?
-std::unique_ptr<SlimeVRBridge> SlimeVRBridge::factory() {
+bool SlimeVRBridge::getNextMessage(messages::ProtobufMessage &msg) {
+    if (status != BRIDGE_CONNECTED) {
+        return false;
+    }
+
+    const uint8_t *body = nullptr;
+    size_t body_size = 0;
+    while (true) {
+        switch (decoder.Next(body, body_size)) {
+            case FrameDecoder::Result::Frame:
+                if (CompactPose::Is(body, body_size)) {
+                    uint64_t timestamp_us;
+                    if (!CompactPose::Decode(body, body_size, *msg.mutable_position(), timestamp_us)) {
+                        fmt::print("bridge recv error: malformed compact pose\n");
+                        continue;
+                    }
+                    return true;
+                }
+                if (QuantizedPose::Is(body, body_size)) {
+                    uint64_t timestamp_us;
+                    if (!QuantizedPose::Decode(body, body_size, *msg.mutable_position(), timestamp_us)) {
+                        fmt::print("bridge recv error: malformed quantized pose\n");
+                        continue;
+                    }
+                    return true;
+                }
+                if (!msg.ParseFromArray(body, static_cast<int>(body_size))) {
+                    // the framing is still intact, so only this message is lost.
+                    fmt::print("bridge recv error: failed to parse\n");
+                    continue;
+                }
+                if (msg.has_ping_pong()) {
+                    // the handshake and probes are the bridge's business, nobody else needs to see them
+                    handlePingPong(msg.ping_pong());
+                    continue;
+                }
+                return true;
+            case FrameDecoder::Result::Invalid:
+                fmt::print("bridge recv error: invalid message size {}\n", decoder.GetPendingFrameSize());
+                status = BRIDGE_ERROR;
+                return false;
+            case FrameDecoder::Result::Incomplete:
+                if (!readAvailable(decoder)) {
+                    return false;
+                }
+                break;
+        }
+    }
+}
+
+size_t SlimeVRBridge::receiveMessages(const MessageHandler &handler) {
+    size_t count = 0;
+    messages::ProtobufMessage msg;
+    while (getNextMessage(msg)) {
+        handler(msg);
+        count += 1;
+    }
+    return count;
+}
+
+bool SlimeVRBridge::sendMessage(messages::ProtobufMessage &msg) {
+    if (status != BRIDGE_CONNECTED) {
+        return false;
+    }
+
+    // only formats with a timestamp need the clock read
+    uint64_t timestamp_us = 0;
+    if (active_format != WireFormat::Protobuf) {
+        timestamp_us = msg.has_position() && msg.position().has_timestamp()
+            ? msg.position().timestamp()
+            : std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    if (backpressure == BackpressureMode::LatestPoseWins) {
+        const messages::ProtobufMessage *queued = &msg;
+        if (msg.has_position()) {
+            const int32_t tracker_id = msg.position().tracker_id();
+            uint64_t &seq = pending_positions.try_emplace(tracker_id, NO_PENDING_POSITION).first->second;
+            if (seq != NO_PENDING_POSITION) {
+                // keeps the slot of the stale one, so it still comes after that tracker's TrackerAdded.
+                PendingMessage &slot = pending[pending_begin + (seq - pending_front_seq)];
+                *slot.msg().mutable_position() = msg.position();
+                slot.timestamp_us = timestamp_us;
+                batch_stats.coalesced_positions += 1;
+                return true;
+            }
+            seq = pending_front_seq + (pending_end - pending_begin);
+        } else if (msg.has_position_batch()) {
+            if (pending_batch != NO_PENDING_POSITION) {
+                PendingMessage &slot = pending[pending_begin + (pending_batch - pending_front_seq)];
+                slot.timestamp_us = timestamp_us;
+                if (pending_batch + 1 == pending_front_seq + (pending_end - pending_begin)) {
+                    // nothing was queued after it, so it can take every tracker's position
+                    mergePositions(*slot.msg().mutable_position_batch(), msg.position_batch(), nullptr);
+                    return true;
+                }
+                // a tracker that's new since may have its TrackerAdded queued after the batch,
+                // its position has to come after that.
+                messages::PositionBatch *unmerged = unmerged_batch.mutable_position_batch();
+                unmerged->mutable_positions()->Clear();
+                mergePositions(*slot.msg().mutable_position_batch(), msg.position_batch(), unmerged);
+                if (unmerged->positions_size() == 0) {
+                    return true;
+                }
+                queued = &unmerged_batch;
+            }
+            pending_batch = pending_front_seq + (pending_end - pending_begin);
+        }
+        pushPending(*queued, timestamp_us);
+        batch_stats.max_pending = std::max(batch_stats.max_pending, static_cast<uint32_t>(pending_end - pending_begin));
+        return true;
+    }
+
+    if (!appendFrame(msg, timestamp_us)) {
+        return false;
+    }
+
+    if (batch.size() >= MAX_BATCH_SIZE) {
+        return flush();
+    }
+
+    return true;
+}
+
+WireFormat SlimeVRBridge::formatOf(const messages::ProtobufMessage &msg) const {
+    return msg.has_position() && !HasVelocity(msg.position()) ? active_format : WireFormat::Protobuf;
+}
+
+size_t SlimeVRBridge::bodySize(const messages::ProtobufMessage &msg) const {
+    switch (formatOf(msg)) {
+        case WireFormat::CompactPose:
+            return CompactPose::BODY_SIZE;
+        case WireFormat::QuantizedPose:
+            return QuantizedPose::BODY_SIZE;
+        case WireFormat::Protobuf:
+            break;
+    }
+    return HotMessageEncoder::Handles(msg) ? HotMessageEncoder::Size(msg) : msg.ByteSizeLong();
+}
+
+size_t SlimeVRBridge::frameSize(const messages::ProtobufMessage &msg) const {
+    return HEADER_SIZE + bodySize(msg);
+}
+
+bool SlimeVRBridge::appendFrame(const messages::ProtobufMessage &msg, uint64_t timestamp_us) {
+    const WireFormat format = formatOf(msg);
+    const size_t msg_size = bodySize(msg);
+    const size_t offset = batch.size();
+    batch.resize(offset + HEADER_SIZE + msg_size);
+
+    const auto size = static_cast<uint32_t>(HEADER_SIZE + msg_size); // wire size includes the header
+    uint8_t *frame = batch.data() + offset;
+    frame[0] = size & 0xFF;
+    frame[1] = (size >> 8) & 0xFF;
+    frame[2] = (size >> 16) & 0xFF;
+    frame[3] = (size >> 24) & 0xFF;
+    if (format == WireFormat::CompactPose) {
+        CompactPose::Encode(msg.position(), timestamp_us, frame + HEADER_SIZE);
+    } else if (format == WireFormat::QuantizedPose) {
+        QuantizedPose::Encode(msg.position(), timestamp_us, frame + HEADER_SIZE);
+    } else if (HotMessageEncoder::Handles(msg)) {
+        HotMessageEncoder::Encode(msg, frame + HEADER_SIZE);
+    } else if (!msg.SerializeToArray(frame + HEADER_SIZE, static_cast<int>(msg_size))) {
+        batch.resize(offset);
+        fmt::print("bridge send error: failed to serialize\n");
+        return false;
+    }
+    batch_messages += 1;
+    if (!msg.has_position() && !msg.has_position_batch()) {
+        batch_has_control = true;
+    }
+
+    return true;
+}
+
+void SlimeVRBridge::pushPending(const messages::ProtobufMessage &msg, uint64_t timestamp_us) {
+    if (pending_end == pending.size()) {
+        if (pending_begin > 0) {
+            // move what's left to the front, swapping keeps the spare slots' allocations.
+            for (size_t i = pending_begin; i < pending_end; ++i) {
+                PendingMessage &to = pending[i - pending_begin];
+                PendingMessage &from = pending[i];
+                to.kinds[from.kind].Swap(&from.kinds[from.kind]);
+                to.kind = from.kind;
+                to.timestamp_us = from.timestamp_us;
+            }
+            pending_end -= pending_begin;
+            pending_begin = 0;
+        } else {
+            pending.emplace_back();
+        }
+    }
+
+    PendingMessage &slot = pending[pending_end++];
+    slot.kind = kindOf(msg);
+    slot.timestamp_us = timestamp_us;
+    // copying the whole message would clear it first, and clearing frees the submessage.
+    // copied into the one that's already there, only strings that grew allocate.
+    messages::ProtobufMessage &into = slot.msg();
+    switch (msg.message_case()) {
+        case messages::ProtobufMessage::kPosition:
+            *into.mutable_position() = msg.position();
+            break;
+        case messages::ProtobufMessage::kUserAction:
+            *into.mutable_user_action() = msg.user_action();
+            break;
+        case messages::ProtobufMessage::kTrackerAdded:
+            *into.mutable_tracker_added() = msg.tracker_added();
+            break;
+        case messages::ProtobufMessage::kTrackerStatus:
+            *into.mutable_tracker_status() = msg.tracker_status();
+            break;
+        case messages::ProtobufMessage::kPositionBatch:
+            *into.mutable_position_batch() = msg.position_batch();
+            break;
+        case messages::ProtobufMessage::kPingPong:
+            *into.mutable_ping_pong() = msg.ping_pong();
+            break;
+        case messages::ProtobufMessage::MESSAGE_NOT_SET:
+            break;
+    }
+}
+
+size_t SlimeVRBridge::kindOf(const messages::ProtobufMessage &msg) {
+    switch (msg.message_case()) {
+        case messages::ProtobufMessage::kPosition: return 1;
+        case messages::ProtobufMessage::kUserAction: return 2;
+        case messages::ProtobufMessage::kTrackerAdded: return 3;
+        case messages::ProtobufMessage::kTrackerStatus: return 4;
+        case messages::ProtobufMessage::kPositionBatch: return 5;
+        case messages::ProtobufMessage::kPingPong: return 6;
+        case messages::ProtobufMessage::MESSAGE_NOT_SET: break;
+    }
+    return 0;
+}
+
+void SlimeVRBridge::mergePositions(messages::PositionBatch &into, const messages::PositionBatch &from, messages::PositionBatch *unmerged) {
+    for (const messages::Position &position: from.positions()) {
+        auto it = std::find_if(into.mutable_positions()->begin(), into.mutable_positions()->end(), [&](const messages::Position &pending) {
+            return pending.tracker_id() == position.tracker_id();
+        });
+        if (it != into.mutable_positions()->end()) {
+            *it = position;
+            batch_stats.coalesced_positions += 1;
+        } else {
+            *(unmerged ? unmerged : &into)->add_positions() = position;
+        }
+    }
+}
+
+void SlimeVRBridge::movePendingToBatch() {
+    const size_t writable = writableBytes();
+    const size_t budget = std::min(writable, MAX_BATCH_SIZE);
+    const size_t capacity = getQueueStats().capacity; // 0 if the transport has no limit
+
+    // strictly in order, the first message that doesn't fit holds back everything after it.
+    while (pending_begin < pending_end) {
+        const PendingMessage &front = pending[pending_begin];
+        const messages::ProtobufMessage &msg = front.msg();
+        const size_t size = frameSize(msg);
+        // a message bigger than a whole batch goes on its own, as soon as the transport can take it
+        const bool fits = batch.size() + size <= budget || (batch.empty() && size > MAX_BATCH_SIZE && size <= writable);
+        // and one that's bigger than the send queue itself would hold back everything after it forever
+        const bool never_fits = capacity != 0 && size > capacity;
+        if (!fits && !never_fits) {
+            break;
+        }
+
+        if (never_fits) {
+            fmt::print("bridge send error: message of {} bytes doesn't fit in the send queue\n", size);
+        } else {
+            // a message that fails to serialize would never succeed, so it's dropped either way.
+            appendFrame(msg, front.timestamp_us);
+        }
+
+        if (msg.has_position()) {
+            pending_positions[msg.position().tracker_id()] = NO_PENDING_POSITION;
+        } else if (msg.has_position_batch() && pending_batch == pending_front_seq) {
+            // an older batch can still be pending behind the newest one
+            pending_batch = NO_PENDING_POSITION;
+        }
+        pending_begin += 1;
+        pending_front_seq += 1;
+    }
+
+    if (pending_begin == pending_end) {
+        pending_begin = 0;
+        pending_end = 0;
+    }
+}
+
+void SlimeVRBridge::clearBuffers() {
+    decoder.Clear();
+    batch.clear();
+    batch_messages = 0;
+    batch_has_control = false;
+    batch_has_ping = false;
+    ping_due = false;
+    pending.clear();
+    pending_begin = 0;
+    pending_end = 0;
+    pending_positions.clear();
+    pending_batch = NO_PENDING_POSITION;
+    pending_front_seq = 0;
+}
+
+void SlimeVRBridge::startHandshake() {
+    handshake = HandshakeState::Pending;
+    handshake_deadline = std::chrono::steady_clock::now() + HANDSHAKE_TIMEOUT;
+    server_features = 0;
+    // nothing the server might not understand until it says otherwise
+    active_format = WireFormat::Protobuf;
+
+    messages::ProtobufMessage msg;
+    messages::PingPong *hello = msg.mutable_ping_pong();
+    hello->set_protocol_version(PROTOCOL_VERSION);
+    hello->add_features(messages::PingPong_Feature_POSITION_BATCH);
+    hello->add_features(messages::PingPong_Feature_COMPACT_POSE);
+    hello->add_features(messages::PingPong_Feature_QUANTIZED_POSE);
+    hello->add_features(messages::PingPong_Feature_POSITION_TIMESTAMP);
+    hello->add_features(messages::PingPong_Feature_POSITION_VELOCITY);
+    hello->add_features(messages::PingPong_Feature_ROUND_TRIP);
+    sendMessage(msg);
+
+    link_stats = LinkStats{};
+    next_ping = std::chrono::steady_clock::now();
+    ping_due = false;
+    rtt_warned = false;
+    queue_warned = false;
+}
+
+void SlimeVRBridge::handlePingPong(const messages::PingPong &ping_pong) {
+    // without any of these it's just a keepalive
+    if (ping_pong.protocol_version() != 0) {
+        handleHandshake(ping_pong);
+    }
+    if (ping_pong.pong_timestamp() != 0) {
+        recordRoundTrip(ping_pong.pong_timestamp());
+    }
+    if (ping_pong.ping_timestamp() != 0) {
+        // goes out with the rest of the tick
+        probe_message.mutable_ping_pong()->Clear();
+        probe_message.mutable_ping_pong()->set_pong_timestamp(ping_pong.ping_timestamp());
+        sendMessage(probe_message);
+    }
+}
+
+void SlimeVRBridge::handleHandshake(const messages::PingPong &ping_pong) {
+    server_features = 0;
+    for (int feature: ping_pong.features()) {
+        // features this feeder doesn't know about can't be used anyway
+        if (feature > 0 && feature < 32) {
+            server_features |= 1U << static_cast<uint32_t>(feature);
+        }
+    }
+    handshake = HandshakeState::Complete;
+
+    active_format = WireFormat::Protobuf;
+    if (wire_format == WireFormat::CompactPose && serverSupports(messages::PingPong_Feature_COMPACT_POSE)) {
+        active_format = WireFormat::CompactPose;
+    } else if (wire_format == WireFormat::QuantizedPose && serverSupports(messages::PingPong_Feature_QUANTIZED_POSE)) {
+        active_format = WireFormat::QuantizedPose;
+    } else if (wire_format != WireFormat::Protobuf) {
+        fmt::print("bridge: server doesn't support the requested wire format, using protobuf.\n");
+    }
+
+    fmt::print("bridge: server speaks protocol version {}, features {:#x}", ping_pong.protocol_version(), server_features);
+    if (ping_pong.max_rate() != 0) {
+        fmt::print(", wants at most {} positions per second per tracker", ping_pong.max_rate());
+    }
+    fmt::print("\n");
+}
+
+void SlimeVRBridge::appendPing() {
+    // stamped as the last frame of the batch, right before it's written, so the rest of the tick isn't counted as round trip
+    probe_message.mutable_ping_pong()->Clear();
+    probe_message.mutable_ping_pong()->set_ping_timestamp(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+    // with LatestPoseWins it waits for a flush the transport has room for, a ping stuck behind the backlog would be stale
+    if (backpressure == BackpressureMode::LatestPoseWins
+        && (pending_begin != pending_end || batch.size() + frameSize(probe_message) > std::min(writableBytes(), MAX_BATCH_SIZE))) {
+        return;
+    }
+    if (appendFrame(probe_message, 0)) {
+        ping_due = false;
+        batch_has_ping = true;
+    }
+}
+
+void SlimeVRBridge::recordRoundTrip(uint64_t ping_timestamp_us) {
+    const uint64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    if (ping_timestamp_us > now_us) {
+        return; // not one of ours
+    }
+    const auto rtt_us = static_cast<uint32_t>(std::min<uint64_t>(now_us - ping_timestamp_us, UINT32_MAX));
+
+    rtt_samples[link_stats.pongs_received % RTT_WINDOW] = rtt_us;
+    link_stats.pongs_received += 1;
+    link_stats.rtt_last_us = rtt_us;
+    link_stats.rtt_min_us = link_stats.pongs_received == 1 ? rtt_us : std::min(link_stats.rtt_min_us, rtt_us);
+
+    // a pong only comes every PING_INTERVAL, so the window is simply sorted again each time
+    const size_t count = std::min<size_t>(link_stats.pongs_received, RTT_WINDOW);
+    std::array<uint32_t, RTT_WINDOW> sorted;
+    std::copy_n(rtt_samples.begin(), count, sorted.begin());
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; ++i) total += sorted[i];
+    link_stats.rtt_avg_us = static_cast<uint32_t>(total / count);
+    const size_t p99 = count * 99 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.begin() + count);
+    link_stats.rtt_p99_us = sorted[p99];
+
+    // only the start and end of a slow stretch is logged, with some slack so it doesn't flap
+    if (!rtt_warned && link_stats.rtt_p99_us >= RTT_WARN_US) {
+        fmt::print("bridge: slow round trips to the server, p99 {:.1f}ms, avg {:.1f}ms\n",
+            link_stats.rtt_p99_us / 1000.0, link_stats.rtt_avg_us / 1000.0);
+        rtt_warned = true;
+    } else if (rtt_warned && link_stats.rtt_p99_us < RTT_WARN_US / 2) {
+        fmt::print("bridge: round trips to the server recovered, p99 {:.1f}ms\n", link_stats.rtt_p99_us / 1000.0);
+        rtt_warned = false;
+    }
+}
+
+void SlimeVRBridge::recordQueueDepth(int send_bytes, int recv_bytes, int send_buffer_bytes) {
+    link_stats.send_queue_bytes = send_bytes;
+    link_stats.recv_queue_bytes = recv_bytes;
+    link_stats.max_send_queue_bytes = std::max(link_stats.max_send_queue_bytes, send_bytes);
+    link_stats.send_buffer_bytes = send_buffer_bytes;
+    if (send_bytes < 0 || send_buffer_bytes <= 0) {
+        return;
+    }
+
+    // the server not keeping up shows here long before anything gets dropped
+    if (!queue_warned && send_bytes >= send_buffer_bytes / 2) {
+        fmt::print("bridge: server is falling behind, {} of {} bytes unread in the socket\n", send_bytes, send_buffer_bytes);
+        queue_warned = true;
+    } else if (queue_warned && send_bytes < send_buffer_bytes / 4) {
+        fmt::print("bridge: server caught up, {} bytes unread in the socket\n", send_bytes);
+        queue_warned = false;
+    }
+}
+
+bool SlimeVRBridge::flush() {
+    if (backpressure == BackpressureMode::LatestPoseWins) {
+        movePendingToBatch();
+    }
+    if (ping_due && status == BRIDGE_CONNECTED) {
+        appendPing();
+    }
+
+    if (batch.empty()) {
+        return true;
+    }
+
+    const bool written = status == BRIDGE_CONNECTED && writeBatch(batch.data(), batch.size());
+    if (written) {
+        if (batch_has_ping) link_stats.pings_sent += 1;
+        batch_stats.flushes += 1;
+        batch_stats.messages += batch_messages;
+        batch_stats.bytes += batch.size();
+        batch_stats.max_messages = std::max(batch_stats.max_messages, batch_messages);
+        batch_stats.max_bytes = std::max(batch_stats.max_bytes, static_cast<uint32_t>(batch.size()));
+    }
+
+    // a newer position is coming next tick anyway, but nothing else is ever sent twice.
+    // reconnecting makes the trackers get resent once it's back.
+    if (!written && batch_has_control && status == BRIDGE_CONNECTED) {
+        fmt::print("bridge: dropped tracker updates, reconnecting to resend them.\n");
+        status = BRIDGE_ERROR;
+    }
+    batch.clear();
+    batch_messages = 0;
+    batch_has_control = false;
+    batch_has_ping = false;
+
+    return written;
+}
+
+// TODO: websockets?
+std::unique_ptr<SlimeVRBridge> SlimeVRBridge::factory(const BridgeConfig &config) {
 #if defined(_WIN32)
-    return std::make_unique<NamedPipeBridge>();
+    if (config.transport == BridgeTransport::SharedMemory) {
+        fmt::print("Shared memory bridge isn't supported on this platform, using the named pipe.\n");
+    }
+    // named pipe writes are still synchronous, the queue settings don't apply
+    return std::make_unique<NamedPipeBridge>(config);
 #elif defined(__linux__)
-    return std::make_unique<UnixSocketBridge>();
+    if (config.transport == BridgeTransport::SharedMemory) {
+        return std::make_unique<ShmBridge>(config);
+    }
+    return std::make_unique<UnixSocketBridge>(config);
 #else
     #error Unsupported platform
 #endif
@@ -1,5 +1,14 @@
 #pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include <ProtobufMessages.pb.h>
+#include "frame_decoder.hpp"
+#include "wire_format.hpp"
 
 enum BridgeStatus {
     BRIDGE_DISCONNECTED = 0,
@@ -7,24 +16,242 @@ enum BridgeStatus {
     BRIDGE_ERROR = 2,
 };
 
+// counters for outbound batches, updated by every successful flush()
+struct BatchStats {
+    uint64_t flushes = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    uint32_t max_messages = 0;
+    uint32_t max_bytes = 0;
+    // only used by BackpressureMode::LatestPoseWins
+    uint64_t coalesced_positions = 0; // pending positions replaced by a newer one for the same tracker
+    uint32_t max_pending = 0; // most messages ever waiting for room in the send queue
+
+    double messagesPerFlush() const { return flushes ? (double)messages / flushes : 0.0; }
+    double bytesPerFlush() const { return flushes ? (double)bytes / flushes : 0.0; }
+};
+
+// health of the current connection, reset every time the bridge (re-)connects
+struct LinkStats {
+    // round trips are only measured when the server supports PingPong::ROUND_TRIP
+    uint64_t pings_sent = 0;
+    uint64_t pongs_received = 0;
+    uint32_t rtt_last_us = 0;
+    uint32_t rtt_min_us = 0; // over the whole connection
+    uint32_t rtt_avg_us = 0; // over the last RTT_WINDOW round trips, like the p99
+    uint32_t rtt_p99_us = 0;
+    // sampled every tick, only unix sockets can report these. -1 where they're unknown
+    int send_queue_bytes = -1; // sent, but not read by the server yet
+    int recv_queue_bytes = -1; // sent by the server, but not read by us yet
+    int max_send_queue_bytes = -1;
+    int send_buffer_bytes = -1;
+};
+
+// what to do with outbound messages that don't fit in the send queue
+enum class DropPolicy {
+    Newest,   // discard the write that didn't fit, keep what's already queued. a dropped write with anything
+              // but positions in it reconnects, since tracker and status updates are never resent otherwise
+    Reconnect // give up on the connection, the server gets a full resync once it reconnects
+};
+
+// how messages are handed to the transport when the server falls behind
+enum class BackpressureMode {
+    Queue,         // every message goes straight to the send queue, subject to the drop policy
+    LatestPoseWins // messages wait until the queue has room, and only the newest position per tracker is kept
+};
+
+// how to reach the server
+enum class BridgeTransport {
+    Socket,      // named pipe on windows, unix socket everywhere else
+    SharedMemory // shared memory rings, linux only, for a server on the same machine that supports it
+};
+
+// how messages are delimited on a unix socket
+enum class SocketMode {
+    Stream,   // every message is prefixed with its size
+    SeqPacket // every message is its own packet, falls back to Stream if the server doesn't accept it
+};
+
+// how far the handshake with the server got on the current connection
+enum class HandshakeState {
+    Pending,   // sent ours, waiting for the server's
+    Complete,  // the server answered, its features can be used
+    Unanswered // the server didn't answer in time, it's probably older than the handshake
+};
+
+struct BridgeConfig {
+    BridgeTransport transport = BridgeTransport::Socket;
+    SocketMode socket_mode = SocketMode::Stream;
+    // bytes that can be waiting to be sent before the drop policy kicks in
+    size_t queue_size = 256 * 1024;
+    DropPolicy drop_policy = DropPolicy::Newest;
+    BackpressureMode backpressure = BackpressureMode::Queue;
+    // anything but Protobuf is opt-in, and only used once the server says it supports it
+    WireFormat wire_format = WireFormat::Protobuf;
+};
+
+struct QueueStats {
+    size_t capacity = 0;
+    size_t high_water = 0; // most bytes ever waiting in the queue
+    uint64_t dropped_writes = 0;
+    uint64_t dropped_bytes = 0;
+};
+
+// how often the bridge has looked for a server that wasn't there
+struct ReconnectStats {
+    uint64_t attempts = 0; // every time it looked, including the ones that connected
+    std::chrono::milliseconds retry_delay{0}; // the wait after the next failed attempt, back to the shortest once connected
+};
+
 class SlimeVRBridge {
     public:
-        SlimeVRBridge() {}
+        explicit SlimeVRBridge(const BridgeConfig &config) : backpressure(config.backpressure), wire_format(config.wire_format) {}
 
         virtual ~SlimeVRBridge() {};
 
-        BridgeStatus status;
+        BridgeStatus status = BRIDGE_DISCONNECTED;
 
         // returns true if the pipe has *just* (re-)connected
         bool runFrame();
 
-        virtual bool getNextMessage(messages::ProtobufMessage &msg) = 0;
-        virtual bool sendMessage(messages::ProtobufMessage &msg) = 0;
+        using MessageHandler = std::function<void(messages::ProtobufMessage &msg)>;
 
-        static std::unique_ptr<SlimeVRBridge> factory();
+        // decodes the next complete message from the server, never blocks.
+        // partial messages are kept until the rest arrives on a later call.
+        bool getNextMessage(messages::ProtobufMessage &msg);
+        // hands every complete message that is available right now to handler, returns how many there were
+        size_t receiveMessages(const MessageHandler &handler);
+
+        // queues a message in the outbound batch, it isn't written until the next flush()
+        bool sendMessage(messages::ProtobufMessage &msg);
+        // writes every message queued since the last flush in one go
+        bool flush();
+
+        const BatchStats &getBatchStats() const { return batch_stats; }
+        // only bridges with a send queue have anything to report
+        virtual QueueStats getQueueStats() const { return {}; }
+        // only bridges that back off between attempts have anything to report
+        virtual ReconnectStats getReconnectStats() const { return {}; }
+
+        // descriptor that becomes readable when the server sends something, -1 if there's none to wait on
+        virtual int getReadDescriptor() const { return -1; }
+        // changes every time the bridge (re-)connects
+        uint32_t getConnectionId() const { return connection_id; }
+
+        HandshakeState getHandshakeState() const { return handshake; }
+        // false until the server has said so in its handshake
+        bool serverSupports(messages::PingPong_Feature feature) const { return (server_features >> feature) & 1U; }
+        // the wire format positions are currently sent in, starts as Protobuf on every connection
+        WireFormat getWireFormat() const { return active_format; }
+        const LinkStats &getLinkStats() const { return link_stats; }
+
+        static std::unique_ptr<SlimeVRBridge> factory(const BridgeConfig &config);
+
+    protected:
+        // every frame on the wire is prefixed with its little endian size, including the prefix itself
+        static constexpr size_t HEADER_SIZE = 4;
+
+        // write a buffer of one or more complete frames
+        virtual bool writeBatch(const uint8_t *data, size_t size) = 0;
+        // read whatever the transport has available into decoder, returns false if nothing was read
+        virtual bool readAvailable(FrameDecoder &decoder) = 0;
+        // how many bytes writeBatch can currently take without dropping anything
+        virtual size_t writableBytes() const { return SIZE_MAX; }
+        // for transports that can see the kernel's socket queues, called from update()
+        void recordQueueDepth(int send_bytes, int recv_bytes, int send_buffer_bytes);
 
     private:
+        // flush early rather than letting a single batch grow without bound
+        static constexpr size_t MAX_BATCH_SIZE = 64 * 1024;
+        // bumped when the handshake itself changes, features are negotiated separately
+        static constexpr uint32_t PROTOCOL_VERSION = 1;
+        // how long the server gets to answer the handshake before it's assumed to predate it
+        static constexpr std::chrono::milliseconds HANDSHAKE_TIMEOUT{1000};
+        // how often the round trip is measured, and over how many of the last ones the p99 is taken
+        static constexpr std::chrono::milliseconds PING_INTERVAL{250};
+        static constexpr size_t RTT_WINDOW = 256;
+        // a p99 round trip above this is logged, this close to the tick interval positions arrive late
+        static constexpr uint32_t RTT_WARN_US = 20000;
+
+        const BackpressureMode backpressure;
+        const WireFormat wire_format; // the one asked for, active_format is the one in use
+        WireFormat active_format = WireFormat::Protobuf;
+        uint32_t connection_id = 0;
+
+        HandshakeState handshake = HandshakeState::Pending;
+        std::chrono::steady_clock::time_point handshake_deadline;
+        uint32_t server_features = 0; // 1 << PingPong::Feature
+
+        LinkStats link_stats;
+        std::chrono::steady_clock::time_point next_ping;
+        bool ping_due = false; // a ping goes out with the next flush
+        std::array<uint32_t, RTT_WINDOW> rtt_samples{}; // ring, the last RTT_WINDOW round trips
+        bool rtt_warned = false;
+        bool queue_warned = false;
+        // reused for every ping and pong, so probing doesn't allocate
+        messages::ProtobufMessage probe_message;
+
+        FrameDecoder decoder;
+
+        std::vector<uint8_t> batch;
+        uint32_t batch_messages = 0;
+        bool batch_has_control = false; // the batch holds something besides positions, it can't just be dropped
+        bool batch_has_ping = false;
+        BatchStats batch_stats;
+
+        // one per ProtobufMessage::message case, MESSAGE_NOT_SET included
+        static constexpr size_t MESSAGE_KINDS = 7;
+
+        struct PendingMessage {
+            // a message of every kind, so a slot keeps what it allocated for each kind it has held.
+            // switching a ProtobufMessage to another kind would free the old one and allocate a new one.
+            std::array<messages::ProtobufMessage, MESSAGE_KINDS> kinds;
+            size_t kind = 0; // the one in kinds that's in use, see kindOf
+            uint64_t timestamp_us; // when it was sent, for formats that carry one
+
+            messages::ProtobufMessage &msg() { return kinds[kind]; }
+            const messages::ProtobufMessage &msg() const { return kinds[kind]; }
+        };
+
+        // a pending_positions entry for a tracker with no position waiting
+        static constexpr uint64_t NO_PENDING_POSITION = UINT64_MAX;
+
+        // LatestPoseWins: messages that haven't fit in the send queue yet, in order, in pending[pending_begin, pending_end).
+        // a newer position replaces the pending one for its tracker in place, so there's at most one per tracker.
+        // slots outside the range are kept around to be reused, so queueing a position doesn't allocate.
+        std::vector<PendingMessage> pending;
+        size_t pending_begin = 0;
+        size_t pending_end = 0;
+        uint64_t pending_front_seq = 0; // sequence number of pending[pending_begin]
+        // tracker_id -> sequence number, entries are kept once sent for the same reason
+        std::unordered_map<int32_t, uint64_t> pending_positions;
+        // sequence number of the newest pending PositionBatch, newer ones are merged into it
+        uint64_t pending_batch = NO_PENDING_POSITION;
+        // positions that can't be merged into the pending batch, they're queued as a batch of their own
+        messages::ProtobufMessage unmerged_batch;
+
+        // how msg goes on the wire, positions without velocities can be sent as a fixed size record instead of a ProtobufMessage
+        WireFormat formatOf(const messages::ProtobufMessage &msg) const;
+        size_t bodySize(const messages::ProtobufMessage &msg) const;
+        size_t frameSize(const messages::ProtobufMessage &msg) const;
+        bool appendFrame(const messages::ProtobufMessage &msg, uint64_t timestamp_us);
+        // newer positions replace the ones for the same tracker. positions of other trackers are appended to into,
+        // or to unmerged if it's given
+        void mergePositions(messages::PositionBatch &into, const messages::PositionBatch &from, messages::PositionBatch *unmerged);
+        // index into PendingMessage::kinds for msg
+        static size_t kindOf(const messages::ProtobufMessage &msg);
+        void pushPending(const messages::ProtobufMessage &msg, uint64_t timestamp_us);
+        void movePendingToBatch();
+        void clearBuffers();
+        void startHandshake();
+        void handleHandshake(const messages::PingPong &ping_pong);
+        // handshakes, keepalives and round trip probes all arrive as a PingPong
+        void handlePingPong(const messages::PingPong &ping_pong);
+        // adds the due ping to the end of the batch, if there's room for it
+        void appendPing();
+        void recordRoundTrip(uint64_t ping_timestamp_us);
+
         virtual void connect() = 0;
         virtual void reset() = 0;
         virtual void update() = 0;
-};
\ No newline at end of file
+};
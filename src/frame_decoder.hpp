@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// resumable decoder for frames prefixed with their little endian uint32 size (including the prefix)
+/// partial headers and bodies are kept across calls, so reads can stop wherever the transport runs dry
+class FrameDecoder {
+public:
+    static constexpr size_t HEADER_SIZE = 4;
+    /// anything bigger is treated as a corrupt stream rather than allocated
+    static constexpr size_t MAX_FRAME_SIZE = 1024 * 1024;
+
+    enum class Result {
+        Frame,      /// a complete frame was returned
+        Incomplete, /// more bytes are needed
+        Invalid     /// the size prefix is garbage, the stream can't be recovered
+    };
+
+    /// get space to receive at least minSize bytes into, valid until the next call to Next
+    uint8_t* PrepareWrite(size_t minSize) {
+        if (mBegin == mEnd) {
+            mBegin = mEnd = 0;
+        }
+        if (mBuffer.size() - mEnd < minSize) {
+            // move the partial frame to the front before growing
+            if (mBegin > 0) std::memmove(mBuffer.data(), mBuffer.data() + mBegin, mEnd - mBegin);
+            mEnd -= mBegin;
+            mBegin = 0;
+            if (mBuffer.size() - mEnd < minSize) mBuffer.resize(mEnd + minSize);
+        }
+        return mBuffer.data() + mEnd;
+    }
+    /// mark bytes written after PrepareWrite as received
+    void CommitWrite(size_t size) { mEnd += size; }
+    /// the size of the frame waiting to complete, or 0 if the header hasn't fully arrived
+    size_t GetPendingFrameSize() const {
+        if (mEnd - mBegin < HEADER_SIZE) return 0;
+        return ReadSize(mBuffer.data() + mBegin);
+    }
+
+    /// pop the next complete frame, body points into the decoder's buffer and excludes the header
+    Result Next(const uint8_t*& body, size_t& bodySize) {
+        const size_t available = mEnd - mBegin;
+        if (available < HEADER_SIZE) return Result::Incomplete;
+
+        const size_t frameSize = ReadSize(mBuffer.data() + mBegin);
+        if (frameSize < HEADER_SIZE || frameSize > MAX_FRAME_SIZE) return Result::Invalid;
+        if (available < frameSize) return Result::Incomplete;
+
+        body = mBuffer.data() + mBegin + HEADER_SIZE;
+        bodySize = frameSize - HEADER_SIZE;
+        mBegin += frameSize;
+        return Result::Frame;
+    }
+
+    void Clear() { mBegin = mEnd = 0; }
+
+private:
+    static size_t ReadSize(const uint8_t* it) {
+        return static_cast<size_t>(it[0])
+            | static_cast<size_t>(it[1]) << 8U
+            | static_cast<size_t>(it[2]) << 16U
+            | static_cast<size_t>(it[3]) << 24U;
+    }
+
+    std::vector<uint8_t> mBuffer;
+    size_t mBegin = 0; /// start of the first unconsumed frame
+    size_t mEnd = 0; /// end of received bytes
+};
@@ -7,6 +7,9 @@
 #include <optional>
 #include <cerrno>
 #include <memory>
+#include <algorithm>
+#include <bitset>
+#include <cmath>
 #include <fmt/core.h>
 #include <fmt/ostream.h>
 #include <iostream>
@@ -17,6 +20,7 @@
 #include "pathtools_excerpt.h"
 #include "matrix_utils.h"
 #include "bridge.hpp"
+#include "tick_loop.hpp"
 #include "setup.hpp"
 #include "version.h"
 #include <ProtobufMessages.pb.h>
@@ -26,6 +30,10 @@ using namespace vr;
 // TODO: Temp Path
 static constexpr const char* actions_path = "./bindings/actions.json";
 static constexpr const char* config_path = "./config.txt";
+// how often devices are re-detected without an event asking for it
+static constexpr uint32_t detect_sweep_ms = 1000;
+// SteamVR clamps predictions to 100ms anyway
+static constexpr float max_predicted_seconds = 0.1f;
 
 enum class BodyPosition {
 	Head = 0,
@@ -162,6 +170,8 @@ class UniverseTranslation {
 		// TODO: do we want to store this differently?
 		vr::HmdVector3_t translation;
 		float yaw;
+		// the above, worked out once so applying it to poses is cheap
+		RigidTransform transform;
 
 		static UniverseTranslation parse(simdjson::ondemand::object &&obj) {
 			UniverseTranslation res;
@@ -174,6 +184,7 @@ class UniverseTranslation {
 				iii += 1;
 			}
 			res.yaw = obj["yaw"].get_double();
+			res.transform = RigidTransform::FromUniverse(res.translation, res.yaw);
 
 			return res;
 		}
@@ -185,7 +196,8 @@ enum class TrackerState {
 	RUNNING
 };
 
-struct TrackerInfo {
+// what a tracker is, only needed when it's (re-)detected or announced to the server.
+struct TrackerDescription {
 	std::string name = "";
 	std::optional<std::string> serial = std::nullopt;
 
@@ -196,6 +208,17 @@ struct TrackerInfo {
 	std::optional<std::string> deviceType = std::nullopt;
 	std::optional<std::string> controllerType = std::nullopt;
 	std::optional<std::string> inputProfilePath = std::nullopt;
+};
+
+// what a tracker is doing, touched every tick so it's kept small and free of strings.
+struct TrackerInfo {
+	/// last rotation actually sent, for the dead-band filter
+	HmdQuaternion_t sent_rotation = {};
+	/// last position actually sent, for the dead-band filter
+	HmdVector3_t sent_position = {};
+	/// number of ticks since a position was last sent
+	uint32_t ticks_since_sent = 0;
+	messages::Position_DataSource sent_data_source = messages::Position_DataSource_NONE;
 
 	SlimeVRPosition position = SlimeVRPosition::None;
 	messages::TrackerStatus_Status status = messages::TrackerStatus_Status_DISCONNECTED;
@@ -207,18 +230,169 @@ struct TrackerInfo {
 	uint8_t detect_timeout = 0;
 
 	bool is_slimevr = false;
+
+	/// cleared to force the next position to be sent regardless of the dead band.
+	bool position_sent = false;
+};
+
+// decides which position messages are worth sending, all zero sends every tick like before.
+struct PositionFilter {
+	/// metres the tracker has to move from the last sent position, 0 sends any change unless min_rotation_delta is set
+	float min_position_delta = 0.0f;
+	/// radians the tracker has to turn from the last sent rotation, 0 sends any change unless min_position_delta is set
+	float min_rotation_delta = 0.0f;
+	/// don't resend a pose if the compositor hasn't presented a new frame since
+	bool skip_repeated_frames = false;
+	/// ticks after which a position is sent anyway, so the server doesn't time the tracker out
+	uint32_t keepalive_ticks = 100;
+
+	bool enabled() const { return min_position_delta > 0.0f || min_rotation_delta > 0.0f || skip_repeated_frames; }
+};
+
+// how poses are sampled from OpenVR and what's sent along with them
+struct PoseOptions {
+	/// how far ahead of now poses are asked for, to make up for the time they take to reach the server
+	float predicted_seconds = 0.0f;
+	/// predict half the measured round trip further ahead, once the server answers round trip probes
+	bool predict_latency = false;
+	/// send velocities with every position
+	bool send_velocity = false;
+	/// send when the pose was sampled with every position
+	bool send_timestamp = false;
+	/// send every tracker's position in one PositionBatch per tick
+	bool batch_positions = false;
+};
+
+// the PoseOptions that are actually in use, some need the server to support them first
+struct PoseFeatures {
+	bool batch_positions = false;
+	bool send_velocity = false;
+	bool send_timestamp = false;
+
+	bool operator!=(const PoseFeatures &other) const {
+		return batch_positions != other.batch_positions || send_velocity != other.send_velocity || send_timestamp != other.send_timestamp;
+	}
+};
+
+struct PositionStats {
+	uint64_t sent = 0;
+	uint64_t suppressed_unchanged = 0; // within the dead band
+	uint64_t suppressed_repeated_frame = 0;
+};
+
+// string properties of each device, fetched once and kept until OpenVR says they changed.
+// each fetch is two IPC calls and an allocation, and Detect wants eight of them per device.
+class PropertyCache {
+public:
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t replaced = 0; // devices found with another serial than the one their properties were cached for
+	};
+
+	// fetch is only called on a miss, failures are cached too so they aren't retried (or logged) every time.
+	template<typename F>
+	const std::optional<std::string> &Get(TrackedDeviceIndex_t index, ETrackedDeviceProperty prop, F &&fetch) {
+		auto &device = devices[index];
+		auto it = device.find(prop);
+		if (it != device.end()) {
+			stats.hits += 1;
+			return it->second;
+		}
+		stats.misses += 1;
+		return device.emplace(prop, fetch()).first->second;
+	}
+
+	// the device at index was (de)activated, it might not even be the same device anymore.
+	void InvalidateDevice(TrackedDeviceIndex_t index) {
+		if (index < k_unMaxTrackedDeviceCount) {
+			devices[index].clear();
+		}
+	}
+	// entries belong to the serial they were cached with, in case a device was replaced without the events for it being seen.
+	// fetch_serial is only called if there's a cached serial to compare with. returns true if the entries were dropped.
+	template<typename F>
+	bool VerifySerial(TrackedDeviceIndex_t index, F &&fetch_serial) {
+		auto &device = devices[index];
+		auto it = device.find(ETrackedDeviceProperty::Prop_SerialNumber_String);
+		if (it == device.end() || fetch_serial() == it->second) {
+			return false;
+		}
+		device.clear();
+		stats.replaced += 1;
+		return true;
+	}
+	// returns true if the property was cached, i.e. someone cares that it changed.
+	bool InvalidateProperty(TrackedDeviceIndex_t index, ETrackedDeviceProperty prop) {
+		if (index >= k_unMaxTrackedDeviceCount) {
+			return false;
+		}
+		if (prop == ETrackedDeviceProperty::Prop_SerialNumber_String) {
+			// a new serial means a different device, nothing else can be trusted either.
+			bool cached = !devices[index].empty();
+			devices[index].clear();
+			return cached;
+		}
+		return devices[index].erase(prop) > 0;
+	}
+
+	const Stats &GetStats() const {
+		return stats;
+	}
+
+private:
+	std::unordered_map<ETrackedDeviceProperty, std::optional<std::string>> devices[k_unMaxTrackedDeviceCount];
+	Stats stats;
+};
+
+// what a pose action's origin resolved to
+struct RoleBinding {
+	bool valid = false;
+	VRInputValueHandle_t origin = k_ulInvalidInputValueHandle;
+	std::optional<TrackedDeviceIndex_t> index = std::nullopt;
+	std::optional<std::string> name = std::nullopt;
+};
+
+struct RoleBindingStats {
+	uint64_t lookups = 0;
+	uint64_t rebuilds = 0; // lookups that had to ask OpenVR
 };
 
 class Trackers {
 private:
 	TrackerInfo tracker_info[k_unMaxTrackedDeviceCount] = {};
 	TrackedDevicePose_t poses[k_unMaxTrackedDeviceCount];
+	PoseBatch pose_batch;
+	uint32_t pose_slots[k_unMaxTrackedDeviceCount] = {}; // tracker index -> pose_batch slot, only valid for this tick's poses
+
+	// trackers found by the last Detect, as a mask while detecting and as a sorted list for Tick to walk.
+	std::bitset<k_unMaxTrackedDeviceCount> current_tracker_mask;
+	TrackedDeviceIndex_t current_trackers[k_unMaxTrackedDeviceCount];
+	uint32_t current_trackers_size = 0;
 
-	std::set<TrackedDeviceIndex_t> current_trackers = {};
-	//TrackedDeviceIndex_t current_trackers[k_unMaxTrackedDeviceCount];
-	//uint32_t current_trackers_size = 0;
+	TrackerDescription tracker_descriptions[k_unMaxTrackedDeviceCount] = {};
 
 	SlimeVRBridge &bridge;
+
+	PropertyCache property_cache;
+	RoleBinding role_bindings[(int)BodyPosition::BodyPosition_Count];
+	RoleBindingStats role_binding_stats;
+	PositionFilter filter;
+	/// cos(filter.min_rotation_delta / 2), worked out once for ShouldSendPosition
+	double min_rotation_dot;
+	PoseOptions pose_options;
+	/// what pose_options comes down to with the server on the other end, see UpdatePoseFeatures
+	PoseFeatures pose_features;
+	/// when this tick's poses were sampled, microseconds on the steady clock
+	uint64_t capture_timestamp_us = 0;
+	PositionStats position_stats;
+	uint64_t last_frame = 0;
+	bool actions_valid = false;
+
+	// sent every tick, so they're built once and refilled rather than allocated each time.
+	messages::ProtobufMessage position_message;
+	messages::ProtobufMessage status_message;
+	messages::ProtobufMessage batch_message;
 public:
 	VRActiveActionSet_t actionSet;
 	std::optional<std::pair<uint64_t, UniverseTranslation>> current_universe = std::nullopt;
@@ -226,7 +400,7 @@ private:
 	ETrackingUniverseOrigin universe;
 	VRActionHandle_t action_handles[(int)BodyPosition::BodyPosition_Count];
 
-	Trackers(SlimeVRBridge &bridge, ETrackingUniverseOrigin universe): bridge(bridge), universe(universe) {}
+	Trackers(SlimeVRBridge &bridge, ETrackingUniverseOrigin universe, const PositionFilter &filter, const PoseOptions &pose_options): bridge(bridge), filter(filter), min_rotation_dot(cos(filter.min_rotation_delta / 2)), pose_options(pose_options), universe(universe) {}
 
 	std::optional<std::string> GetStringProp(TrackedDeviceIndex_t index, ETrackedDeviceProperty prop) {
 		if (index >= k_unMaxTrackedDeviceCount) {
@@ -253,6 +427,10 @@ private:
 		return GetOpenVRString(get_prop);
 	}
 
+	const std::optional<std::string> &GetCachedStringProp(TrackedDeviceIndex_t index, ETrackedDeviceProperty prop) {
+		return property_cache.Get(index, prop, [&]() { return GetStringProp(index, prop); });
+	}
+
 	std::optional<std::string> GetLocalizedName(VRInputValueHandle_t handle, EVRInputStringBits flags) {
 		std::string name = std::string(100, '\0');
 		EVRInputError input_error = VRInput()->GetOriginLocalizedName(handle, name.data(), 100, flags | EVRInputStringBits::VRInputString_ControllerType);
@@ -270,6 +448,32 @@ private:
 		return name;
 	}
 
+	// device and name an action's origin resolves to, only looked up again when the origin changes.
+	const RoleBinding &ResolveRoleBinding(unsigned int action, VRInputValueHandle_t origin) {
+		RoleBinding &binding = role_bindings[action];
+		role_binding_stats.lookups += 1;
+		if (binding.valid && binding.origin == origin) {
+			return binding;
+		}
+		role_binding_stats.rebuilds += 1;
+
+		binding.valid = true;
+		binding.origin = origin;
+		binding.index = GetIndex(origin);
+		binding.name = std::nullopt;
+		if (binding.index.has_value()) {
+			// TODO: I feel like this 'only left+right hand' thing is going to bite us in the ass later with things that aren't index/vive trackers.
+			// oh well.
+			binding.name = GetLocalizedName(
+				origin,
+				(action == (int)BodyPosition::LeftHand || action == (int)BodyPosition::RightHand)
+					? EVRInputStringBits::VRInputString_Hand
+					: (EVRInputStringBits)0
+			);
+		}
+		return binding;
+	}
+
 	std::optional<TrackedDeviceIndex_t> GetIndex(VRInputValueHandle_t value_handle) {
 		InputOriginInfo_t info;
 		EVRInputError error = VRInput()->GetOriginTrackedDeviceInfo(value_handle, &info, sizeof(info));
@@ -304,23 +508,102 @@ private:
 
 		info->status = status_val;
 
-		messages::ProtobufMessage message;
-		messages::TrackerStatus *status = message.mutable_tracker_status();
+		messages::TrackerStatus *status = status_message.mutable_tracker_status();
 
 		status->set_status(status_val);
 		status->set_tracker_id(index);
 
-		bridge.sendMessage(message);
+		bridge.sendMessage(status_message);
 
 		fmt::print("Device (Index {}) status: {} ({})\n", index, messages::TrackerStatus_Status_Name(status_val), (int)status_val);
 	}
 
-	void Update(TrackedDeviceIndex_t index, bool just_connected) {
+	static bool HasPose(const TrackedDevicePose_t &pose) {
+		return pose.bPoseIsValid || pose.eTrackingResult == ETrackingResult::TrackingResult_Fallback_RotationOnly;
+	}
+
+	void SendPosition(TrackedDeviceIndex_t index, const HmdVector3_t &new_position, const HmdQuaternion_t &new_rotation, messages::Position_DataSource data_source) {
+		// every field is overwritten, so the message (and its Position) can be reused without clearing it.
+		// cleared batch entries are kept around by protobuf, so adding one is just as cheap.
+		messages::Position *position = pose_features.batch_positions
+			? batch_message.mutable_position_batch()->add_positions()
+			: position_message.mutable_position();
+		position->set_x(new_position.v[0]);
+		position->set_y(new_position.v[1]);
+		position->set_z(new_position.v[2]);
+		position->set_qw(new_rotation.w);
+		position->set_qx(new_rotation.x);
+		position->set_qy(new_rotation.y);
+		position->set_qz(new_rotation.z);
+		position->set_tracker_id(index);
+		position->set_data_source(data_source);
+		if (pose_features.send_velocity) {
+			// already rotated into the universe by Tick, along with the position
+			HmdVector3_t velocity = pose_batch.GetVelocity(pose_slots[index]);
+			HmdVector3_t angular_velocity = pose_batch.GetAngularVelocity(pose_slots[index]);
+			position->set_vx(velocity.v[0]);
+			position->set_vy(velocity.v[1]);
+			position->set_vz(velocity.v[2]);
+			position->set_avx(angular_velocity.v[0]);
+			position->set_avy(angular_velocity.v[1]);
+			position->set_avz(angular_velocity.v[2]);
+		}
+		if (pose_features.send_timestamp) {
+			position->set_timestamp(capture_timestamp_us);
+		}
+
+		if (!pose_features.batch_positions) {
+			bridge.sendMessage(position_message);
+		}
+	}
+
+	// true if the pose differs enough from the last one sent (or it's been long enough) to be worth sending
+	bool ShouldSendPosition(TrackerInfo *info, const HmdVector3_t &position, const HmdQuaternion_t &rotation, messages::Position_DataSource data_source, bool new_frame, bool just_connected) {
+		info->ticks_since_sent += 1;
+
+		if (!filter.enabled() || just_connected || !info->position_sent || info->sent_data_source != data_source) {
+			return true;
+		}
+		if (filter.keepalive_ticks != 0 && info->ticks_since_sent >= filter.keepalive_ticks) {
+			return true;
+		}
+
+		if (filter.skip_repeated_frames && !new_frame) {
+			position_stats.suppressed_repeated_frame += 1;
+			return false;
+		}
+
+		// a threshold left at 0 sends on any change only if the other one is 0 too, otherwise it's ignored.
+		// jitter alone would always count as a change, and make the other threshold useless.
+		bool moved = false;
+		if (filter.min_position_delta > 0.0f || filter.min_rotation_delta == 0.0f) {
+			float dx = position.v[0] - info->sent_position.v[0];
+			float dy = position.v[1] - info->sent_position.v[1];
+			float dz = position.v[2] - info->sent_position.v[2];
+			moved = dx * dx + dy * dy + dz * dz > filter.min_position_delta * filter.min_position_delta;
+		}
+
+		bool turned = false;
+		if (filter.min_rotation_delta > 0.0f || filter.min_position_delta == 0.0f) {
+			// the angle between two rotations is 2 * acos(|dot|), compare the dot product against the threshold instead.
+			double dot = rotation.w * info->sent_rotation.w + rotation.x * info->sent_rotation.x + rotation.y * info->sent_rotation.y + rotation.z * info->sent_rotation.z;
+			turned = std::abs(dot) < min_rotation_dot;
+		}
+
+		if (!moved && !turned) {
+			position_stats.suppressed_unchanged += 1;
+			return false;
+		}
+
+		return true;
+	}
+
+	void Update(TrackedDeviceIndex_t index, bool just_connected, bool new_frame) {
 		if (index >= k_unMaxTrackedDeviceCount) {
 			fmt::print("Update: Got invalid index {}!\n", index);
 			return;
 		}
-		auto pose = poses[index];
+		const TrackedDevicePose_t &pose = poses[index];
 		auto info = tracker_info + index;
 
 		if (info->state != TrackerState::RUNNING) {
@@ -335,64 +618,31 @@ private:
 			return; // don't bother with slimes
 		}
 
-		if (pose.bPoseIsValid || pose.eTrackingResult == ETrackingResult::TrackingResult_Fallback_RotationOnly) {
+		if (HasPose(pose)) {
 			if (pose.eTrackingResult == ETrackingResult::TrackingResult_Fallback_RotationOnly) {
 				SetStatus(index, messages::TrackerStatus_Status_OCCLUDED, just_connected);
 			} else {
 				SetStatus(index, messages::TrackerStatus_Status_OK, just_connected);
 			}
 
-			HmdQuaternion_t new_rotation = GetRotation(pose.mDeviceToAbsoluteTracking);
-			HmdVector3_t new_position = GetPosition(pose.mDeviceToAbsoluteTracking);
-
-			if (current_universe.has_value()) {
-				auto trans = current_universe.value().second;
-				new_position.v[0] += trans.translation.v[0];
-				new_position.v[1] += trans.translation.v[1];
-				new_position.v[2] += trans.translation.v[2];
-
-				// rotate by quaternion w = cos(-trans.yaw / 2), x = 0, y = sin(-trans.yaw / 2), z = 0
-				auto tmp_w = cos(-trans.yaw / 2);
-				auto tmp_y = sin(-trans.yaw / 2);
-				auto new_w = tmp_w * new_rotation.w - tmp_y * new_rotation.y;
-				auto new_x = tmp_w * new_rotation.x + tmp_y * new_rotation.z;
-				auto new_y = tmp_w * new_rotation.y + tmp_y * new_rotation.w;
-				auto new_z = tmp_w * new_rotation.z - tmp_y * new_rotation.x;
-
-				new_rotation.w = new_w;
-				new_rotation.x = new_x;
-				new_rotation.y = new_y;
-				new_rotation.z = new_z;
-
-				// rotate point on the xz plane by -trans.yaw radians
-				// this is equivilant to the quaternion multiplication, after applying the double angle formula.
-				float tmp_sin = sin(-trans.yaw);
-				float tmp_cos = cos(-trans.yaw);
-				auto pos_x = new_position.v[0] * tmp_cos + new_position.v[2] * tmp_sin;
-				auto pos_z = new_position.v[0] * -tmp_sin + new_position.v[2] * tmp_cos;
-
-				new_position.v[0] = pos_x;
-				new_position.v[2] = pos_z;
-			}
+			// already converted and moved into the universe by Tick
+			HmdQuaternion_t new_rotation = pose_batch.GetRotation(pose_slots[index]);
+			HmdVector3_t new_position = pose_batch.GetPosition(pose_slots[index]);
 
-			// send our position message
-			messages::ProtobufMessage message;
-			messages::Position *position = message.mutable_position();
-			position->set_x(new_position.v[0]);
-			position->set_y(new_position.v[1]);
-			position->set_z(new_position.v[2]);
-			position->set_qw(new_rotation.w);
-			position->set_qx(new_rotation.x);
-			position->set_qy(new_rotation.y);
-			position->set_qz(new_rotation.z);
-			position->set_tracker_id(index);
-			position->set_data_source(
-				pose.eTrackingResult == ETrackingResult::TrackingResult_Fallback_RotationOnly
+			auto data_source = pose.eTrackingResult == ETrackingResult::TrackingResult_Fallback_RotationOnly
 				? messages::Position_DataSource_IMU
-				: messages::Position_DataSource_FULL
-			);
+				: messages::Position_DataSource_FULL;
 
-			bridge.sendMessage(message);
+			if (ShouldSendPosition(info, new_position, new_rotation, data_source, new_frame, just_connected)) {
+				info->position_sent = true;
+				info->sent_position = new_position;
+				info->sent_rotation = new_rotation;
+				info->sent_data_source = data_source;
+				info->ticks_since_sent = 0;
+				position_stats.sent += 1;
+
+				SendPosition(index, new_position, new_rotation, data_source);
+			}
 		}
 		
 		// send status update on change, or if we just connected.
@@ -413,6 +663,7 @@ private:
 			return;
 		}
 		auto info = tracker_info + index;
+		const TrackerDescription &description = tracker_descriptions[index];
 
 		info->connection_timeout = 0;
 
@@ -428,7 +679,7 @@ private:
 				if (position == SlimeVRPosition::None) {
 					info->state = TrackerState::WAITING;
 					info->detect_timeout = 0;
-					fmt::print("Waiting for role for \"{}\" with index {}\n", info->name, index);
+					fmt::print("Waiting for role for \"{}\" with index {}\n", description.name, index);
 				} else {
 					should_send = true;
 					info->state = TrackerState::RUNNING;
@@ -458,13 +709,16 @@ private:
 		}
 
 		if (should_send || (send_anyway && info->state == TrackerState::RUNNING)) {
+			// the server treats this as a new tracker, make sure it gets a position straight away.
+			info->position_sent = false;
+
 			messages::ProtobufMessage message;
 			messages::TrackerAdded *added = message.mutable_tracker_added();
 			added->set_tracker_id(index);
 			added->set_tracker_role((int)info->position);
-			added->set_tracker_name(info->name);
-			if (info->serial.has_value()) {
-				added->set_tracker_serial(info->serial.value());
+			added->set_tracker_name(description.name);
+			if (description.serial.has_value()) {
+				added->set_tracker_serial(description.serial.value());
 			}
 
 			bridge.sendMessage(message);
@@ -479,24 +733,26 @@ private:
 			    deviceType: {}\n\
 			    controllerType: {}\n\
 			    inputProfilePath: {}\n\
-			", info->name, positionNames[(int)info->position], (int)info->position, index,
-				info->serial.value(),
-				info->trackingSystem.value(),
-				info->manufacturer.value(),
-				info->modelNumber.value(),
-				info->renderModel.value(),
-				info->deviceType.value(),
-				info->controllerType.value(),
-				info->inputProfilePath.value()
+			", description.name, positionNames[(int)info->position], (int)info->position, index,
+				description.serial.value(),
+				description.trackingSystem.value(),
+				description.manufacturer.value(),
+				description.modelNumber.value(),
+				description.renderModel.value(),
+				description.deviceType.value(),
+				description.controllerType.value(),
+				description.inputProfilePath.value()
 			);
 		}
 	}
 
 public:
-	static std::optional<Trackers> Create(SlimeVRBridge &bridge, ETrackingUniverseOrigin universe);
+	static std::optional<Trackers> Create(SlimeVRBridge &bridge, ETrackingUniverseOrigin universe, const PositionFilter &filter, const PoseOptions &pose_options);
 
-	void Detect(bool just_connected, bool enable_hmd) {
-		current_trackers.clear();
+	// full enumeration of devices and roles, too expensive to run every tick.
+	// returns true while a tracker is waiting for a role or has gone missing, so it should run again next tick.
+	bool Detect(bool just_connected, bool enable_hmd) {
+		current_tracker_mask.reset();
 		uint32_t all_trackers_size = 0;
 		TrackedDeviceIndex_t all_trackers[k_unMaxTrackedDeviceCount];
 
@@ -514,46 +770,43 @@ public:
 
 		for (auto iii = 0; iii < all_trackers_size; ++iii) {
 			auto index = all_trackers[iii];
-			auto driver = this->GetStringProp(index, ETrackedDeviceProperty::Prop_TrackingSystemName_String);
+			const auto &driver = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_TrackingSystemName_String);
 			auto info = tracker_info + index;
+			auto &description = tracker_descriptions[index];
 
 			info->is_slimevr = (driver == "SlimeVR" || driver == "slimevr");
 
 			// only write values once, to avoid overwriting good values later.
-			if (info->name == "") {
-				auto controller_type = this->GetStringProp(index, ETrackedDeviceProperty::Prop_ControllerType_String);
+			if (description.name == "") {
+				const auto &controller_type = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_ControllerType_String);
 				if (controller_type.has_value()) {
-					info->name = controller_type.value();
+					description.name = controller_type.value();
 				} else {
 					// uhhhhhhhhhhhhhhh
-					info->name = fmt::format("Index{}", index);
+					description.name = fmt::format("Index{}", index);
 				}
 			}
 
-			info->serial = this->GetStringProp(index, ETrackedDeviceProperty::Prop_SerialNumber_String);
+			description.serial = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_SerialNumber_String);
 
-			info->trackingSystem = this->GetStringProp(index, ETrackedDeviceProperty::Prop_TrackingSystemName_String);
-			info->manufacturer = this->GetStringProp(index, ETrackedDeviceProperty::Prop_ManufacturerName_String);
-			info->modelNumber = this->GetStringProp(index, ETrackedDeviceProperty::Prop_ModelNumber_String);
-			info->renderModel = this->GetStringProp(index, ETrackedDeviceProperty::Prop_RenderModelName_String);
-			info->deviceType = this->GetStringProp(index, ETrackedDeviceProperty::Prop_RegisteredDeviceType_String);
-			info->controllerType = this->GetStringProp(index, ETrackedDeviceProperty::Prop_ControllerType_String);
-			info->inputProfilePath = this->GetStringProp(index, ETrackedDeviceProperty::Prop_InputProfilePath_String);
+			description.trackingSystem = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_TrackingSystemName_String);
+			description.manufacturer = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_ManufacturerName_String);
+			description.modelNumber = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_ModelNumber_String);
+			description.renderModel = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_RenderModelName_String);
+			description.deviceType = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_RegisteredDeviceType_String);
+			description.controllerType = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_ControllerType_String);
+			description.inputProfilePath = this->GetCachedStringProp(index, ETrackedDeviceProperty::Prop_InputProfilePath_String);
 
-			current_trackers.insert(index);
+			current_tracker_mask.set(index);
 
 			SetPosition(index, SlimeVRPosition::None, just_connected);
 		}
 
 		// detect roles, more specific names
 		auto input = VRInput();
-		EVRInputError input_error = input->UpdateActionState(&actionSet, sizeof(VRActiveActionSet_t), 1);
-		if (input_error != EVRInputError::VRInputError_None) {
-			fmt::print("Error: IVRInput::UpdateActionState: {}\n", (int)input_error);
-			return;
-		}
+		EVRInputError input_error = VRInputError_None;
 
-		for (unsigned int jjj = 0; jjj < (int)BodyPosition::BodyPosition_Count; ++jjj) {
+		for (unsigned int jjj = 0; jjj < (int)BodyPosition::BodyPosition_Count && actions_valid; ++jjj) {
 			if (!enable_hmd && jjj == (int)BodyPosition::Head) {
 				continue; // don't query the head if we aren't reporting it.
 			}
@@ -566,32 +819,25 @@ public:
 			}
 
 			if (pose.bActive) {
-				std::optional<TrackedDeviceIndex_t> trackedDeviceIndex = GetIndex(pose.activeOrigin);
-				if (!trackedDeviceIndex.has_value()) {
+				const RoleBinding &binding = ResolveRoleBinding(jjj, pose.activeOrigin);
+				if (!binding.index.has_value()) {
 					// already printed a message about this in GetIndex, just continue.
 					continue;
 				}
 
-				auto index = trackedDeviceIndex.value();
-
-				// TODO: I feel like this 'only left+right hand' thing is going to bite us in the ass later with things that aren't index/vive trackers.
-				// oh well.
-				auto name = GetLocalizedName(
-					pose.activeOrigin,
-					(jjj == (int)BodyPosition::LeftHand || jjj == (int)BodyPosition::RightHand)
-						? EVRInputStringBits::VRInputString_Hand
-						: (EVRInputStringBits)0
-				);
-				if (name.has_value()) {
-					tracker_info[index].name = name.value();
+				auto index = binding.index.value();
+
+				if (binding.name.has_value()) {
+					tracker_descriptions[index].name = binding.name.value();
 				}
 
-				current_trackers.insert(index);
+				current_tracker_mask.set(index);
 
 				SetPosition(index, positionIDs[jjj], just_connected);
 			}
 		}
 
+		bool settling = false;
 		for (auto iii = 0; iii < k_unMaxTrackedDeviceCount; ++iii) {
 			auto info = tracker_info + iii;
 
@@ -603,19 +849,161 @@ public:
 				fmt::print("Tracker connection timeout.\n");
 				info->state = TrackerState::DISCONNECTED;
 				SetStatus(iii, messages::TrackerStatus_Status_DISCONNECTED, just_connected);
-				info->name = "";
+				tracker_descriptions[iii].name = "";
 				info->connection_timeout = 0;
 			} else {
 				info->connection_timeout += 1;
+				// the timeouts count detections, so keep going every tick until they've run out.
+				settling = settling || info->state == TrackerState::WAITING || !current_tracker_mask.test(iii);
+			}
+		}
+
+		current_trackers_size = 0;
+		for (TrackedDeviceIndex_t index = 0; index < k_unMaxTrackedDeviceCount; ++index) {
+			if (current_tracker_mask.test(index)) {
+				current_trackers[current_trackers_size++] = index;
 			}
 		}
+
+		return settling;
+	}
+
+	// has to run exactly once per tick, before Detect and HandleDigitalActionBool.
+	// running it twice would swallow the changes digital actions report.
+	void UpdateActions() {
+		EVRInputError input_error = VRInput()->UpdateActionState(&actionSet, sizeof(VRActiveActionSet_t), 1);
+		actions_valid = input_error == EVRInputError::VRInputError_None;
+		if (!actions_valid) {
+			fmt::print("Error: IVRInput::UpdateActionState: {}\n", (int)input_error);
+		}
+	}
+
+	// the handshake can finish (or a new connection start) on any tick, so this runs every tick.
+	void UpdatePoseFeatures() {
+		PoseFeatures features;
+		// a batch can't carry CompactPose or QuantizedPose records, those are smaller anyway.
+		features.batch_positions = pose_options.batch_positions
+			&& bridge.serverSupports(messages::PingPong_Feature_POSITION_BATCH)
+			&& bridge.getWireFormat() == WireFormat::Protobuf;
+		features.send_velocity = pose_options.send_velocity && bridge.serverSupports(messages::PingPong_Feature_POSITION_VELOCITY);
+		features.send_timestamp = pose_options.send_timestamp && bridge.serverSupports(messages::PingPong_Feature_POSITION_TIMESTAMP);
+
+		if (features != pose_features) {
+			// the reused message would otherwise keep fields that aren't being set anymore.
+			position_message.Clear();
+			pose_features = features;
+		}
 	}
 
 	void Tick(bool just_connected) {
-		VRSystem()->GetDeviceToAbsoluteTrackingPose(universe, 0, poses, k_unMaxTrackedDeviceCount);
-		for (TrackedDeviceIndex_t index: current_trackers) {
-			Update(index, just_connected);
+		UpdatePoseFeatures();
+
+		float predicted_seconds = pose_options.predicted_seconds;
+		if (pose_options.predict_latency) {
+			// half the round trip is about how long a position takes to reach the server. 0 until it's been measured.
+			predicted_seconds = std::min(predicted_seconds + bridge.getLinkStats().rtt_avg_us / 2'000'000.0f, max_predicted_seconds);
 		}
+		// OpenVR extrapolates from each device's own velocities, which is better than anything we could do with ours.
+		VRSystem()->GetDeviceToAbsoluteTrackingPose(universe, predicted_seconds, poses, k_unMaxTrackedDeviceCount);
+		if (pose_features.send_timestamp) {
+			// predicted poses are for the future, and so is their timestamp.
+			capture_timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()
+				+ (uint64_t)(predicted_seconds * 1'000'000);
+		}
+
+		// if there's no frame counter to go by, assume every tick has new poses.
+		bool new_frame = true;
+		if (filter.skip_repeated_frames) {
+			float seconds_since_vsync;
+			uint64_t frame = 0;
+			if (VRSystem()->GetTimeSinceLastVsync(&seconds_since_vsync, &frame)) {
+				new_frame = frame != last_frame;
+				last_frame = frame;
+			}
+		}
+
+		// convert every pose that's going to be sent in one go, Update picks them up by slot.
+		pose_batch.count = 0;
+		for (uint32_t iii = 0; iii < current_trackers_size; ++iii) {
+			TrackedDeviceIndex_t index = current_trackers[iii];
+			auto info = tracker_info + index;
+			if (info->state == TrackerState::RUNNING && !info->is_slimevr && HasPose(poses[index])) {
+				pose_slots[index] = pose_batch.Add(poses[index]);
+			}
+		}
+		if (current_universe.has_value()) {
+			TransformPoses(pose_batch, current_universe.value().second.transform);
+		} else {
+			TransformPoses(pose_batch);
+		}
+
+		if (pose_features.batch_positions) {
+			batch_message.mutable_position_batch()->clear_positions();
+		}
+
+		for (uint32_t iii = 0; iii < current_trackers_size; ++iii) {
+			Update(current_trackers[iii], just_connected, new_frame);
+		}
+
+		// all sampled by the same GetDeviceToAbsoluteTrackingPose, so they go out together too.
+		if (pose_features.batch_positions && batch_message.position_batch().positions_size() > 0) {
+			bridge.sendMessage(batch_message);
+		}
+	}
+
+	// an origin handle can stay the same while the device or name behind it changes.
+	void InvalidateRoleBindings() {
+		for (auto &binding: role_bindings) {
+			binding.valid = false;
+		}
+	}
+
+	// call for every VREvent_TrackedDeviceActivated/Deactivated/RoleChanged/PropertyChanged and VREvent_Input_BindingsUpdated.
+	// returns true if anything Detect relies on might have changed.
+	bool HandleDeviceEvent(const VREvent_t &event) {
+		switch (event.eventType) {
+		case VREvent_TrackedDeviceActivated:
+		case VREvent_TrackedDeviceDeactivated:
+			property_cache.InvalidateDevice(event.trackedDeviceIndex);
+			InvalidateRoleBindings();
+			return true;
+		case VREvent_TrackedDeviceRoleChanged:
+		case VREvent_Input_BindingsUpdated:
+			InvalidateRoleBindings();
+			return true;
+		case VREvent_PropertyChanged:
+			return property_cache.InvalidateProperty(event.trackedDeviceIndex, event.data.property.prop);
+		default:
+			return false;
+		}
+	}
+
+	// for the detection sweep, costs a serial fetch for every device that has something cached.
+	// returns true if a device turned out to have been replaced.
+	bool VerifyCachedDevices() {
+		bool replaced = false;
+		for (TrackedDeviceIndex_t index = 0; index < k_unMaxTrackedDeviceCount; ++index) {
+			if (property_cache.VerifySerial(index, [&]() { return GetStringProp(index, ETrackedDeviceProperty::Prop_SerialNumber_String); })) {
+				fmt::print("Device (Index {}) was replaced, fetching its properties again.\n", index);
+				replaced = true;
+			}
+		}
+		if (replaced) {
+			InvalidateRoleBindings();
+		}
+		return replaced;
+	}
+
+	const PropertyCache::Stats &GetPropertyStats() const {
+		return property_cache.GetStats();
+	}
+
+	const RoleBindingStats &GetRoleBindingStats() const {
+		return role_binding_stats;
+	}
+
+	const PositionStats &GetPositionStats() const {
+		return position_stats;
 	}
 
 	std::optional<InputDigitalActionData_t> HandleDigitalActionBool(VRActionHandle_t action_handle, std::optional<const char *> server_name = std::nullopt) {
@@ -643,10 +1031,10 @@ public:
 	}
 };
 
-std::optional<Trackers> Trackers::Create(SlimeVRBridge &bridge, ETrackingUniverseOrigin universe){
+std::optional<Trackers> Trackers::Create(SlimeVRBridge &bridge, ETrackingUniverseOrigin universe, const PositionFilter &filter, const PoseOptions &pose_options){
 	VRActionSetHandle_t action_set_handle;
 	EVRInputError input_error;
-	Trackers result(bridge, universe);
+	Trackers result(bridge, universe, filter, pose_options);
 
 	std::string actionsFileName = Path_MakeAbsolute(actions_path, Path_StripFilename(Path_GetExecutablePath()));
 
@@ -696,72 +1084,134 @@ static const std::unordered_map<std::string, std::pair<ETrackingUniverseOrigin,
 // default is static_standing
 static constexpr std::pair<ETrackingUniverseOrigin, bool> universe_default = {ETrackingUniverseOrigin::TrackingUniverseRawAndUncalibrated, true};
 
+static const std::unordered_map<std::string, BridgeTransport> bridge_map {
+	{"socket", BridgeTransport::Socket},
+	{"shm", BridgeTransport::SharedMemory}
+};
+
+static const std::unordered_map<std::string, SocketMode> socket_mode_map {
+	{"stream", SocketMode::Stream},
+	{"seqpacket", SocketMode::SeqPacket}
+};
+
+static const std::unordered_map<std::string, WireFormat> wire_format_map {
+	{"protobuf", WireFormat::Protobuf},
+	{"compact", WireFormat::CompactPose},
+	{"quantized", WireFormat::QuantizedPose}
+};
+
+static const std::unordered_map<std::string, DropPolicy> drop_policy_map {
+	{"newest", DropPolicy::Newest},
+	{"reconnect", DropPolicy::Reconnect}
+};
+
+static const std::unordered_map<std::string, BackpressureMode> backpressure_map {
+	{"queue", BackpressureMode::Queue},
+	{"latest", BackpressureMode::LatestPoseWins}
+};
+
 // TEMP, cba to setup a proper header file.
 void test_lto();
 
-std::optional<UniverseTranslation> search_universe(simdjson::ondemand::parser &json_parser, uint64_t target) {
-	uint32_t length = 0;
-	VRChaperoneSetup()->ExportLiveToBuffer(nullptr, &length);
+// every universe in the chaperone data, parsed once and kept until SteamVR says the data changed.
+class UniverseTable {
+public:
+	// re-exports and re-parses the chaperone data, returns false (keeping nothing) if it couldn't be read.
+	bool Rebuild(simdjson::ondemand::parser &json_parser) {
+		universes.clear();
+
+		uint32_t length = 0;
+		VRChaperoneSetup()->ExportLiveToBuffer(nullptr, &length);
+		if (length == 0) {
+			return false;
+		}
 
-	// compile time check to ensure we're being sane, otherwise this would be a buffer overrun!
-	static_assert(simdjson::SIMDJSON_PADDING >= 1, "simdjson doesn't specify enough padding for a trailing null byte!");
-	// i'd say something about caching a padded string to avoid allocation
-	// but if it's not *exactly* the same size we'd need to allocate anyway
-	// because simdjson doesn't allow modifying the valid length.
-	auto json = simdjson::padded_string(length - 1);
+		// compile time check to ensure we're being sane, otherwise this would be a buffer overrun!
+		static_assert(simdjson::SIMDJSON_PADDING >= 1, "simdjson doesn't specify enough padding for a trailing null byte!");
+		// simdjson doesn't allow changing a padded_string's valid length, so keep our own buffer and
+		// hand it over as a view. it only grows, the chaperone data is about the same size every time.
+		if (buffer.size() < length - 1 + simdjson::SIMDJSON_PADDING) {
+			buffer.resize(length - 1 + simdjson::SIMDJSON_PADDING);
+		}
 
-	if (!VRChaperoneSetup()->ExportLiveToBuffer(json.data(), &length)) {
-		return std::nullopt;
-	}
+		if (!VRChaperoneSetup()->ExportLiveToBuffer(buffer.data(), &length)) {
+			return false;
+		}
 
-	simdjson::ondemand::document doc;
-	try {
-		doc = json_parser.iterate(json);
-
-		for (simdjson::ondemand::object uni: doc["universes"]) {
-			// TODO: universeID comes after the translation, would it be faster to unconditionally parse the translation?
-			auto res = uni.find_field_unordered("universeID");
-			if (res.error()) {
-				static bool missingId = false;
-				if (!missingId) {
-					missingId = true;
-					fmt::print("Warning: 'universes' are present that don't have a universeID, skipping.");
+		simdjson::ondemand::document doc;
+		try {
+			doc = json_parser.iterate(simdjson::padded_string_view(buffer.data(), length - 1, buffer.size()));
+
+			for (simdjson::ondemand::object uni: doc["universes"]) {
+				auto res = uni.find_field_unordered("universeID");
+				if (res.error()) {
+					static bool missingId = false;
+					if (!missingId) {
+						missingId = true;
+						fmt::print("Warning: 'universes' are present that don't have a universeID, skipping.");
+					}
+					continue;
 				}
-				continue;
+				simdjson::ondemand::value elem = res.value_unsafe(); // uni["universeID"];
+
+				uint64_t parsed_universe;
+				auto is_integer = elem.is_integer();
+				if (!is_integer.error() && is_integer.value_unsafe()) {
+					parsed_universe = elem.get_uint64();
+				} else {
+					parsed_universe = elem.get_uint64_in_string();
+				}
+				universes.insert_or_assign(parsed_universe, UniverseTranslation::parse(uni["standing"].get_object().value()));
 			}
-			simdjson::ondemand::value elem = res.value_unsafe(); // uni["universeID"];
-			
-			uint64_t parsed_universe;
-			auto is_integer = elem.is_integer();
-			if (!is_integer.error() && is_integer.value_unsafe()) {
-				parsed_universe = elem.get_uint64();
-			} else {
-				parsed_universe = elem.get_uint64_in_string();
+		} catch (simdjson::simdjson_error& e) {
+			universes.clear();
+
+			std::string_view raw_token_view;
+
+			static bool parse_error = false;
+			if (parse_error) {
+				return false;
 			}
-			if (parsed_universe == target) {
-				return UniverseTranslation::parse(uni["standing"].get_object().value());
+
+			if (!doc.raw_json_token().get(raw_token_view)) {
+				fmt::print("Error while parsing steamvr universes: {}\nraw_token: |{}|\n", e.what(), raw_token_view);
+			} else {
+				fmt::print("Error while parsing steamvr universes: {}\n", e.what());
 			}
+
+			parse_error = true;
+
+			return false;
 		}
-	} catch (simdjson::simdjson_error& e) {
-		std::string_view raw_token_view;
 
-		static bool parse_error = false;
-		if (parse_error) {
+		rebuilds += 1;
+		return true;
+	}
+
+	std::optional<UniverseTranslation> Find(uint64_t universe) const {
+		auto it = universes.find(universe);
+		if (it == universes.end()) {
 			return std::nullopt;
 		}
+		return it->second;
+	}
 
-		if (!doc.raw_json_token().get(raw_token_view)) {
-			fmt::print("Error while parsing steamvr universes: {}\nraw_token: |{}|\n", e.what(), raw_token_view);
-		} else {
-			fmt::print("Error while parsing steamvr universes: {}\n", e.what());
-		}
+	uint64_t GetRebuilds() const {
+		return rebuilds;
+	}
 
-		parse_error = true;
+private:
+	std::unordered_map<uint64_t, UniverseTranslation> universes;
+	std::vector<char> buffer;
+	uint64_t rebuilds = 0;
+};
 
-		return std::nullopt;
+void handle_message(messages::ProtobufMessage &message) {
+	switch (message.message_case()) {
+	// TODO: I don't think there are any messages from the server that we care about at the moment.
+	default:
+		break;
 	}
-
-	return std::nullopt;
 }
 
 int main(int argc, char* argv[]) {
@@ -787,6 +1237,68 @@ int main(int argc, char* argv[]) {
 	);
 	args::ValueFlag<uint32_t> tps(parser, "tps", "Ticks per second. i.e. the number of times per second to send tracking information to slimevr server. Default is 100.", {"tps"}, 100);
 	args::Flag enable_hmd(parser, "hmd", "Enabled sending the HMD position along with controller/tracker information.", {"hmd"});
+	args::ValueFlag<float> min_position_delta(parser, "min-position-delta", "Only send a tracker's position once it has moved more than this many millimetres, or turned more than --min-rotation-delta, since the last one sent. Default is 0, which sends every tick, or only goes by --min-rotation-delta if that is set.", {"min-position-delta"}, 0.0f);
+	args::ValueFlag<float> min_rotation_delta(parser, "min-rotation-delta", "Only send a tracker's position once it has turned more than this many degrees, or moved more than --min-position-delta, since the last one sent. Default is 0, which sends every tick, or only goes by --min-position-delta if that is set.", {"min-rotation-delta"}, 0.0f);
+	args::Flag skip_repeated_frames(parser, "skip-repeated-frames", "Don't resend poses when SteamVR hasn't presented a new frame since the last tick.", {"skip-repeated-frames"});
+	args::ValueFlag<float> predict(parser, "predict", "Milliseconds ahead of now to predict poses, to make up for the time they take to reach and be used by the server. SteamVR won't go beyond 100. Default is 0, which sends the latest poses as they are.", {"predict"}, 0.0f);
+	args::Flag predict_latency(parser, "predict-latency", "Predict poses further ahead by half the measured round trip to the server, on top of --predict. Only once the server answers round trip probes, and never beyond 100 milliseconds in total.", {"predict-latency"});
+	args::Flag position_batch(parser, "position-batch", "Send the positions of all trackers in one message per tick instead of one message each, if the server supports it.", {"position-batch"});
+	args::Flag send_velocity(parser, "send-velocity", "Send each tracker's linear and angular velocity along with its position, if the server supports it, so it can interpolate between positions.", {"send-velocity"});
+	args::Flag send_timestamp(parser, "send-timestamp", "Send when each tracker's pose was sampled along with its position, if the server supports it, so it can tell how old a position is.", {"send-timestamp"});
+	args::ValueFlag<uint32_t> keepalive(parser, "keepalive", "Milliseconds after which a position is sent even if the tracker hasn't moved, so the server doesn't time it out. Default is 1000.", {"keepalive"}, 1000);
+	args::MapFlag<std::string, BridgeTransport> bridge_transport(
+		parser,
+		"bridge",
+		"How to connect to the SlimeVR server. Possible values:\n"
+		"  socket: named pipe on Windows, unix socket on Linux (default)\n"
+		"  shm: shared memory, Linux only, the server has to create the \"/SlimeVRInput\" segment",
+		{"bridge"},
+		bridge_map,
+		BridgeTransport::Socket
+	);
+	args::MapFlag<std::string, SocketMode> socket_mode(
+		parser,
+		"socket-mode",
+		"How messages are delimited on the unix socket (Linux only). Possible values:\n"
+		"  stream: every message is prefixed with its size (default)\n"
+		"  seqpacket: every message is its own packet, falls back to stream if the server doesn't support it",
+		{"socket-mode"},
+		socket_mode_map,
+		SocketMode::Stream
+	);
+	args::MapFlag<std::string, WireFormat> wire_format(
+		parser,
+		"wire-format",
+		"How messages are encoded for the SlimeVR server. Possible values:\n"
+		"  protobuf: everything is a protobuf message (default)\n"
+		"  compact: positions are sent as fixed size binary records\n"
+		"  quantized: like compact, but positions are rounded to the millimetre and rotations packed into 48 bits\n"
+		"Anything but protobuf is only used if the server supports it, and not for positions that carry velocities (--send-velocity).",
+		{"wire-format"},
+		wire_format_map,
+		WireFormat::Protobuf
+	);
+	args::ValueFlag<uint32_t> queue_size(parser, "queue-size", "Size of the bridge send queue in KiB, at least 16. Default is 256.", {"queue-size"}, 256);
+	args::MapFlag<std::string, DropPolicy> drop_policy(
+		parser,
+		"drop-policy",
+		"What to do when the bridge send queue is full. Possible values:\n"
+		"  newest: drop the messages that didn't fit (default)\n"
+		"  reconnect: drop the connection and resend everything once it's back",
+		{"drop-policy"},
+		drop_policy_map,
+		DropPolicy::Newest
+	);
+	args::MapFlag<std::string, BackpressureMode> backpressure(
+		parser,
+		"backpressure",
+		"How to handle a server that can't keep up. Possible values:\n"
+		"  queue: queue every message, subject to the drop policy (default)\n"
+		"  latest: hold messages until there's room, only keeping the newest position for each tracker",
+		{"backpressure"},
+		backpressure_map,
+		BackpressureMode::Queue
+	);
 
 	args::Group setup_group(parser, "Setup options", args::Group::Validators::AtMostOne);
 	args::Flag install(setup_group, "install", "Installs the manifest and enables autostart. Used by the installer.", {"install"});
@@ -841,6 +1353,12 @@ int main(int argc, char* argv[]) {
 		return handle_setup(install);
 	}
 
+	// the biggest message sent is a PositionBatch with every tracker in it, a smaller queue could never take one.
+	if (queue_size.Get() < 16) {
+		std::cerr << "--queue-size has to be at least 16 KiB." << std::endl;
+		return 1;
+	}
+
 	fmt::print("SlimeVR-Feeder-App version {}\n\n", version);
 
 	EVRInitError init_error = VRInitError_None;
@@ -861,10 +1379,33 @@ int main(int argc, char* argv[]) {
 		return EXIT_FAILURE;
 	}
 
-	auto bridge = SlimeVRBridge::factory();
+	BridgeConfig bridge_config;
+	bridge_config.transport = bridge_transport.Get();
+	bridge_config.socket_mode = socket_mode.Get();
+	bridge_config.queue_size = (size_t)queue_size.Get() * 1024;
+	bridge_config.drop_policy = drop_policy.Get();
+	bridge_config.backpressure = backpressure.Get();
+	bridge_config.wire_format = wire_format.Get();
+
+	auto bridge = SlimeVRBridge::factory(bridge_config);
 	auto tracking_universe = universe.Get().first;
 	bool use_vrchaperone = universe.Get().second;
-	std::optional<Trackers> maybe_trackers = Trackers::Create(*bridge, tracking_universe);
+
+	PositionFilter position_filter;
+	position_filter.min_position_delta = min_position_delta.Get() / 1000.0f;
+	position_filter.min_rotation_delta = min_rotation_delta.Get() * 3.14159265f / 180.0f;
+	position_filter.skip_repeated_frames = skip_repeated_frames;
+	position_filter.keepalive_ticks = std::max<uint32_t>((uint64_t)keepalive.Get() * tps.Get() / 1000, 1);
+
+	// a negative prediction would just send older poses.
+	PoseOptions pose_options;
+	pose_options.predicted_seconds = std::clamp(predict.Get() / 1000.0f, 0.0f, max_predicted_seconds);
+	pose_options.predict_latency = predict_latency;
+	pose_options.send_velocity = send_velocity;
+	pose_options.send_timestamp = send_timestamp;
+	pose_options.batch_positions = position_batch;
+
+	std::optional<Trackers> maybe_trackers = Trackers::Create(*bridge, tracking_universe, position_filter, pose_options);
 	if (!maybe_trackers.has_value()) {
 		return EXIT_FAILURE;
 	}
@@ -877,17 +1418,36 @@ int main(int argc, char* argv[]) {
 
 	//trackers.Detect(false);
 
-	auto tick_ns = std::chrono::nanoseconds(1'000'000'000 / tps.Get());
-	auto next_tick = std::chrono::duration_cast<std::chrono::nanoseconds>(
-		std::chrono::high_resolution_clock::now().time_since_epoch()
-	);
+	auto tick_loop = TickLoop::factory(std::chrono::nanoseconds(1'000'000'000 / tps.Get()));
 
 	bool overlay_was_open = false;
 
+	// devices are detected when OpenVR says something changed, with a slow sweep in case an event was missed.
+	bool detect_needed = true;
+	uint32_t ticks_since_detect = 0;
+	const uint32_t detect_sweep_ticks = std::max<uint32_t>(tps.Get() * detect_sweep_ms / 1000, 1);
+
 	auto json_parser = simdjson::ondemand::parser();
+	// the current universe is looked up on startup, then again whenever SteamVR says it (or the chaperone data) changed.
+	UniverseTable universe_table;
+	bool universes_stale = true;
+	bool universe_changed = true;
+	// the universe the runtime is in wasn't in the table last time it was looked up
+	bool universe_missing = true;
+	uint32_t universe_retry_ticks = 0;
 
 	// event loop
 	while (!should_exit) {
+		tick_loop->watch(bridge->getReadDescriptor(), bridge->getConnectionId());
+		const TickLoop::Wake wake = tick_loop->wait();
+
+		if (wake.readable) {
+			bridge->receiveMessages(handle_message);
+		}
+		if (!wake.tick) {
+			continue;
+		}
+
 		bool just_connected = bridge->runFrame();
 
 		VREvent_t event;
@@ -897,50 +1457,89 @@ int main(int argc, char* argv[]) {
 			case VREvent_Quit:
 				return 0;
 
-			// TODO: add more events, or remove some events?
-			// case VREvent_TrackedDeviceActivated:
-			// case VREvent_TrackedDeviceDeactivated:
-			// case VREvent_TrackedDeviceRoleChanged:
-			// case VREvent_TrackedDeviceUpdated:
-			// case VREvent_DashboardDeactivated:
-				// trackers.Detect(just_connected);
-				// break;
+			// anything that can add, remove or rename a tracker, or change its role.
+			case VREvent_TrackedDeviceActivated:
+			case VREvent_TrackedDeviceDeactivated:
+			case VREvent_TrackedDeviceRoleChanged:
+			case VREvent_Input_BindingsUpdated:
+				trackers.HandleDeviceEvent(event);
+				detect_needed = true;
+				break;
+			case VREvent_PropertyChanged:
+				// these come in all the time for things like battery levels, only the ones we cached matter.
+				detect_needed = trackers.HandleDeviceEvent(event) || detect_needed;
+				break;
+			case VREvent_TrackedDeviceUpdated:
+				detect_needed = true;
+				break;
+
+			// the universe table only has to be rebuilt when the chaperone data itself changes.
+			case VREvent_ChaperoneDataHasChanged:
+				universes_stale = true;
+				break;
+			case VREvent_ChaperoneUniverseHasChanged:
+				universe_changed = true;
+				break;
 
 			default:
 				//fmt::print("Unhandled event: {}({})\n", system->GetEventTypeNameFromEnum((EVREventType)event.eventType), event.eventType);
-				// I'm not relying on events to actually trigger anything right now, so don't bother printing anything.
+				// plenty of events don't concern us, so don't bother printing anything.
 				break;
 			}
 		}
 
-		messages::ProtobufMessage recievedMessage;
-		// TODO: I don't think there are any messages from the server that we care about at the moment, but let's make sure to not let the pipe fill up.
-		bridge->getNextMessage(recievedMessage);
+		// drain everything the server sent since last tick, so the pipe never fills up.
+		bridge->receiveMessages(handle_message);
 
-		// TODO: are there events we should be listening to in order to fire this?
-		uint64_t universe = VRSystem()->GetUint64TrackedDeviceProperty(0, Prop_CurrentUniverseId_Uint64);
-		if (use_vrchaperone && (!trackers.current_universe.has_value() || trackers.current_universe.value().first != universe)) {
-			auto res = search_universe(json_parser, universe);
-			if (res.has_value()) {
-				trackers.current_universe.emplace(universe, res.value());
+		if (use_vrchaperone) {
+			// a universe we don't know about yet might just not have been written out, so keep looking now and then.
+			universe_retry_ticks += 1;
+			if (universe_missing && universe_retry_ticks >= detect_sweep_ticks) {
+				universes_stale = true;
+			}
+			if (universes_stale) {
+				universe_table.Rebuild(json_parser);
+				universes_stale = false;
+				universe_changed = true;
+				universe_retry_ticks = 0;
+			}
+			if (universe_changed) {
+				uint64_t universe = VRSystem()->GetUint64TrackedDeviceProperty(0, Prop_CurrentUniverseId_Uint64);
+				auto res = universe_table.Find(universe);
+				if (res.has_value()) {
+					trackers.current_universe.emplace(universe, res.value());
+				}
+				// until it turns up, the previous universe (if any) is the best there is.
+				universe_missing = !res.has_value();
+				universe_changed = false;
 			}
 		}
 
+		// we should still be updating the action state, to get DigitalActions while the dashboard is open.
+		trackers.UpdateActions();
+
 		// TODO: don't do this every loop, we really shouldn't need to.
 		if (VROverlay()->IsDashboardVisible()) {
 			if (!overlay_was_open) {
 				fmt::print("Dashboard open, pausing detection.\n");
 			}
 			overlay_was_open = true;
-
-			// we should still be updating the action state, to get DigitalActions while the dashboard is open.
-			VRInput()->UpdateActionState(&trackers.actionSet, sizeof(VRActiveActionSet_t), 1);
 		} else {
 			if (overlay_was_open) {
 				fmt::print("Dashboard closed, re-enabling tracker detection.\n");
+				detect_needed = true;
 			}
 			overlay_was_open = false;
-			trackers.Detect(just_connected, enable_hmd);
+
+			ticks_since_detect += 1;
+			if (ticks_since_detect >= detect_sweep_ticks && !detect_needed) {
+				// the cache outlives missed events too, a device replaced at the same index would keep the old one's properties.
+				trackers.VerifyCachedDevices();
+			}
+			if (just_connected || detect_needed || ticks_since_detect >= detect_sweep_ticks) {
+				detect_needed = trackers.Detect(just_connected, enable_hmd);
+				ticks_since_detect = 0;
+			}
 		}
 
 		// TODO: rename these actions as appropriate, perhaps log them?
@@ -950,19 +1549,50 @@ int main(int argc, char* argv[]) {
 
 		trackers.Tick(just_connected);
 
-		next_tick += tick_ns;
+		// everything queued this tick goes out in a single write.
+		bridge->flush();
+	}
 
-		auto wait_ns = next_tick - std::chrono::duration_cast<std::chrono::nanoseconds>(
-			std::chrono::high_resolution_clock::now().time_since_epoch()
-		);
+	const PropertyCache::Stats &property_stats = trackers.GetPropertyStats();
+	fmt::print("Device properties: {} cached, {} fetched, {} devices replaced\n", property_stats.hits, property_stats.misses, property_stats.replaced);
+	if (use_vrchaperone) {
+		fmt::print("Universes: table rebuilt {} times\n", universe_table.GetRebuilds());
+	}
+	const RoleBindingStats &role_binding_stats = trackers.GetRoleBindingStats();
+	fmt::print("Role bindings: {} lookups, {} rebuilt\n", role_binding_stats.lookups, role_binding_stats.rebuilds);
+
+	const PositionStats &position_stats = trackers.GetPositionStats();
+	if (position_filter.enabled()) {
+		fmt::print("Positions: {} sent, {} suppressed ({} unchanged, {} repeated frame)\n",
+			position_stats.sent, position_stats.suppressed_unchanged + position_stats.suppressed_repeated_frame,
+			position_stats.suppressed_unchanged, position_stats.suppressed_repeated_frame);
+	}
 
-		if (wait_ns.count() > 0) {
-			std::this_thread::sleep_for(wait_ns);
-		} else {
-			// I don't care if you want more TPS than the feeder can provide, I'm yielding to the OS anyway.
-			// if this is really an issue for someone, they can open an issue.
-			std::this_thread::yield();
-		}
+	const BatchStats &batch_stats = bridge->getBatchStats();
+	fmt::print("Bridge batches: {} flushes, {:.1f} messages/flush (max {}), {:.1f} bytes/flush (max {})\n",
+		batch_stats.flushes, batch_stats.messagesPerFlush(), batch_stats.max_messages, batch_stats.bytesPerFlush(), batch_stats.max_bytes);
+	const QueueStats queue_stats = bridge->getQueueStats();
+	if (queue_stats.capacity > 0) {
+		fmt::print("Bridge queue: high water {}/{} bytes, {} writes dropped ({} bytes)\n",
+			queue_stats.high_water, queue_stats.capacity, queue_stats.dropped_writes, queue_stats.dropped_bytes);
+	}
+	if (bridge_config.backpressure == BackpressureMode::LatestPoseWins) {
+		fmt::print("Bridge backpressure: {} stale positions replaced, at most {} messages pending\n",
+			batch_stats.coalesced_positions, batch_stats.max_pending);
+	}
+	const LinkStats &link_stats = bridge->getLinkStats();
+	if (link_stats.pongs_received > 0) {
+		fmt::print("Bridge round trip: {}/{} pings answered, min {:.2f}ms, avg {:.2f}ms, p99 {:.2f}ms\n",
+			link_stats.pongs_received, link_stats.pings_sent,
+			link_stats.rtt_min_us / 1000.0, link_stats.rtt_avg_us / 1000.0, link_stats.rtt_p99_us / 1000.0);
+	}
+	if (link_stats.max_send_queue_bytes >= 0) {
+		fmt::print("Bridge socket: at most {}/{} bytes unread by the server\n",
+			link_stats.max_send_queue_bytes, link_stats.send_buffer_bytes);
+	}
+
+	if (tick_loop->getMissedTicks() > 0) {
+		fmt::print("Missed {} ticks\n", tick_loop->getMissedTicks());
 	}
 
 	fmt::print("Exiting cleanly!\n");
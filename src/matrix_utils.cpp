@@ -1,6 +1,20 @@
 #include "matrix_utils.h"
 
 #include <cmath>
+#include "pose_kernel.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define POSE_KERNEL_X86
+#endif
+
+#if defined(POSE_KERNEL_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define POSE_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(POSE_KERNEL_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
 using namespace vr;
 
@@ -25,4 +39,80 @@ HmdVector3_t GetPosition(HmdMatrix34_t matrix) {
 	vector.v[2] = matrix.m[2][3];
 
 	return vector;
-}
\ No newline at end of file
+}
+
+// matrix_utils_avx.cpp, false if it wasn't built with AVX
+bool TransformPosesAvx(PoseBatch &batch, const RigidTransform &transform);
+
+namespace {
+
+#if defined(POSE_KERNEL_SSE2)
+struct Sse2Lanes {
+	using V = __m128;
+	static constexpr size_t Width = 4;
+	static V Load(const float *p) { return _mm_load_ps(p); }
+	static void Store(float *p, V v) { _mm_store_ps(p, v); }
+	static V Set(float f) { return _mm_set1_ps(f); }
+	static V Add(V a, V b) { return _mm_add_ps(a, b); }
+	static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+	static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+	static V Max(V a, V b) { return _mm_max_ps(a, b); }
+	static V Sqrt(V a) { return _mm_sqrt_ps(a); }
+	static V CopySign(V magnitude, V sign) {
+		const V mask = _mm_set1_ps(-0.0f);
+		return _mm_or_ps(_mm_andnot_ps(mask, magnitude), _mm_and_ps(mask, sign));
+	}
+};
+#endif
+
+bool CpuHasAvx() {
+#if defined(POSE_KERNEL_X86) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	// the OS also has to save the AVX registers on context switches
+	return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#elif defined(POSE_KERNEL_X86) && (defined(__GNUC__) || defined(__clang__))
+	return __builtin_cpu_supports("avx");
+#else
+	return false;
+#endif
+}
+
+}
+
+RigidTransform RigidTransform::FromUniverse(const HmdVector3_t &translation, float yaw) {
+	RigidTransform res;
+
+	// quaternion w = cos(-yaw / 2), x = 0, y = sin(-yaw / 2), z = 0
+	res.qw = (float)cos(-yaw / 2.0);
+	res.qy = (float)sin(-yaw / 2.0);
+
+	// the same rotation on the xz plane as a matrix
+	const double c = cos(-yaw);
+	const double s = sin(-yaw);
+	res.r[0][0] = (float)c;
+	res.r[0][2] = (float)s;
+	res.r[2][0] = (float)-s;
+	res.r[2][2] = (float)c;
+
+	// the translation comes first, so rotate it too: R * (p + t) = R * p + R * t
+	res.t[0] = (float)(c * translation.v[0] + s * translation.v[2]);
+	res.t[1] = translation.v[1];
+	res.t[2] = (float)(-s * translation.v[0] + c * translation.v[2]);
+
+	return res;
+}
+
+void TransformPoses(PoseBatch &batch, const RigidTransform &transform) {
+	static const bool use_avx = CpuHasAvx();
+	if (use_avx && TransformPosesAvx(batch, transform)) {
+		return;
+	}
+#if defined(POSE_KERNEL_SSE2)
+	TransformPosesWith<Sse2Lanes>(batch, transform);
+#else
+	TransformPosesWith<ScalarLanes>(batch, transform);
+#endif
+}
@@ -16,4 +16,86 @@ vr::HmdQuaternion_t GetRotation(vr::HmdMatrix34_t matrix);
 //-----------------------------------------------------------------------------
 vr::HmdVector3_t GetPosition(vr::HmdMatrix34_t matrix);
 
-#endif // MATRIX_UTILS
\ No newline at end of file
+//-----------------------------------------------------------------------------
+// Purpose: Poses of many devices in structure of arrays form, so they can be
+// converted to position + quaternion several at a time with SIMD.
+//-----------------------------------------------------------------------------
+struct PoseBatch {
+	static constexpr uint32_t Capacity = vr::k_unMaxTrackedDeviceCount;
+	static_assert(Capacity % 8 == 0, "kernels process whole vectors, Capacity must be a multiple of the widest one");
+
+	uint32_t count = 0;
+
+	// input: element [row][col] of pose i is at m[row * 4 + col][i]
+	alignas(32) float m[12][Capacity] = {};
+
+	// velocities, rotated like the positions in place (they aren't translated)
+	alignas(32) float v[3][Capacity] = {};
+	alignas(32) float av[3][Capacity] = {};
+
+	// output
+	alignas(32) float x[Capacity] = {};
+	alignas(32) float y[Capacity] = {};
+	alignas(32) float z[Capacity] = {};
+	alignas(32) float qw[Capacity] = {};
+	alignas(32) float qx[Capacity] = {};
+	alignas(32) float qy[Capacity] = {};
+	alignas(32) float qz[Capacity] = {};
+
+	// append a pose, returns its slot
+	uint32_t Add(const vr::HmdMatrix34_t &matrix) {
+		const uint32_t slot = count++;
+		for (int row = 0; row < 3; ++row) {
+			for (int col = 0; col < 4; ++col) {
+				m[row * 4 + col][slot] = matrix.m[row][col];
+			}
+		}
+		return slot;
+	}
+	uint32_t Add(const vr::TrackedDevicePose_t &pose) {
+		const uint32_t slot = Add(pose.mDeviceToAbsoluteTracking);
+		for (int axis = 0; axis < 3; ++axis) {
+			v[axis][slot] = pose.vVelocity.v[axis];
+			av[axis][slot] = pose.vAngularVelocity.v[axis];
+		}
+		return slot;
+	}
+
+	vr::HmdVector3_t GetPosition(uint32_t slot) const {
+		return {{x[slot], y[slot], z[slot]}};
+	}
+	vr::HmdQuaternion_t GetRotation(uint32_t slot) const {
+		return {qw[slot], qx[slot], qy[slot], qz[slot]};
+	}
+	vr::HmdVector3_t GetVelocity(uint32_t slot) const {
+		return {{v[0][slot], v[1][slot], v[2][slot]}};
+	}
+	vr::HmdVector3_t GetAngularVelocity(uint32_t slot) const {
+		return {{av[0][slot], av[1][slot], av[2][slot]}};
+	}
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Rotation followed by translation, precomputed so applying it is
+// only multiplies and adds.
+//-----------------------------------------------------------------------------
+struct RigidTransform {
+	// the rotation as a quaternion, for orientations
+	float qw = 1.0f, qx = 0.0f, qy = 0.0f, qz = 0.0f;
+	// and as a matrix, for positions
+	float r[3][3] = {{1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}};
+	// added after rotating
+	float t[3] = {0.0f, 0.0f, 0.0f};
+
+	// what a chaperone universe does: add translation, then turn by -yaw radians around the vertical axis
+	static RigidTransform FromUniverse(const vr::HmdVector3_t &translation, float yaw);
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Converts every pose in the batch like GetRotation and GetPosition,
+// then applies transform to it, and its rotation to the velocities. Uses AVX
+// or SSE2 when the CPU has them.
+//-----------------------------------------------------------------------------
+void TransformPoses(PoseBatch &batch, const RigidTransform &transform = RigidTransform());
+
+#endif // MATRIX_UTILS
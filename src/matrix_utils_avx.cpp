@@ -0,0 +1,40 @@
+// the AVX pose kernel, built with AVX enabled for just this file (see CMakeLists.txt).
+// only called once TransformPoses has checked the CPU supports it.
+#include "pose_kernel.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+
+namespace {
+
+struct AvxLanes {
+	using V = __m256;
+	static constexpr size_t Width = 8;
+	static V Load(const float *p) { return _mm256_load_ps(p); }
+	static void Store(float *p, V v) { _mm256_store_ps(p, v); }
+	static V Set(float f) { return _mm256_set1_ps(f); }
+	static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+	static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+	static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+	static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+	static V Sqrt(V a) { return _mm256_sqrt_ps(a); }
+	static V CopySign(V magnitude, V sign) {
+		const V mask = _mm256_set1_ps(-0.0f);
+		return _mm256_or_ps(_mm256_andnot_ps(mask, magnitude), _mm256_and_ps(mask, sign));
+	}
+};
+
+}
+
+bool TransformPosesAvx(PoseBatch &batch, const RigidTransform &transform) {
+	TransformPosesWith<AvxLanes>(batch, transform);
+	return true;
+}
+
+#else
+
+bool TransformPosesAvx(PoseBatch &batch, const RigidTransform &transform) {
+	return false;
+}
+
+#endif
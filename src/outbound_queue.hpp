@@ -0,0 +1,228 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+
+#include "unix_sockets.hpp"
+#include "spsc_ring.hpp"
+#include "bridge.hpp"
+
+/// hands outbound bytes from the main thread to a dedicated I/O thread that owns all sends on a socket,
+/// so a slow or stalled reader never blocks the producer
+class OutboundQueue {
+public:
+    OutboundQueue(size_t capacity, DropPolicy policy)
+        : mRing(capacity), mPolicy(policy), mWakeFd(SysCall(::eventfd, 0, EFD_NONBLOCK | EFD_CLOEXEC).Unwrap()) {}
+    ~OutboundQueue() {
+        Stop();
+        (void)SysCall(::close, mWakeFd);
+    }
+    OutboundQueue(const OutboundQueue&) = delete;
+    OutboundQueue& operator=(const OutboundQueue&) = delete;
+
+    /// start draining into socket, the queue keeps its own duplicate of the descriptor
+    /// so the owner closing the socket can never race the I/O thread.
+    /// on a SeqPacket socket the size prefix is stripped and every frame is sent as its own message.
+    void Start(Descriptor socket, LocalSocketType type = LocalSocketType::Stream) {
+        Stop();
+        mSocket = SysCall(::fcntl, socket, F_DUPFD_CLOEXEC, 0).Unwrap();
+        mType = type;
+        mFailed = false;
+        mRunning = true;
+        mThread = std::thread(&OutboundQueue::Run, this);
+    }
+    /// join the I/O thread and discard anything still queued
+    void Stop() {
+        if (!mThread.joinable()) return;
+        mRunning = false;
+        Wake();
+        mThread.join();
+        mRing.Clear();
+        (void)SysCall(::close, mSocket);
+        mSocket = -1;
+    }
+
+    /// producer: queue a buffer of whole frames, all or nothing
+    /// @return false if the buffer was dropped
+    bool Push(const uint8_t* data, size_t size) {
+        if (!mRing.TryWrite(data, size)) {
+            mDroppedWrites.fetch_add(1, std::memory_order_relaxed);
+            mDroppedBytes.fetch_add(size, std::memory_order_relaxed);
+            if (mPolicy == DropPolicy::Reconnect) mFailed = true;
+            return false;
+        }
+        const size_t used = mRing.GetUsed();
+        if (used > mHighWater.load(std::memory_order_relaxed)) mHighWater.store(used, std::memory_order_relaxed);
+        // only pay for the syscall if the I/O thread is actually waiting on it.
+        // the ring write is a release store and mSleeping a different variable, so without the fence the load
+        // could be ordered before the write. paired with the fence in Run: either the I/O thread's recheck sees
+        // the new bytes, or this load sees it asleep, never neither.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mSleeping.load(std::memory_order_relaxed)) Wake();
+        return true;
+    }
+
+    /// producer: bytes that can be pushed right now without dropping
+    size_t GetWritable() const { return mRing.GetCapacity() - mRing.GetUsed(); }
+    /// everything pushed so far has been handed to the socket
+    bool IsEmpty() const { return mRing.IsEmpty(); }
+
+    /// the I/O thread stopped because the socket errored or closed, or the queue overflowed with DropPolicy::Reconnect
+    bool IsFailed() const { return mFailed; }
+
+    QueueStats GetStats() const {
+        QueueStats stats;
+        stats.capacity = mRing.GetCapacity();
+        stats.high_water = mHighWater.load(std::memory_order_relaxed);
+        stats.dropped_writes = mDroppedWrites.load(std::memory_order_relaxed);
+        stats.dropped_bytes = mDroppedBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    void Wake() {
+        const uint64_t one = 1;
+        (void)SysCall(::write, mWakeFd, &one, sizeof(one));
+    }
+    /// block until woken, or until the socket is writable if waitWritable
+    void Wait(bool waitWritable) {
+        std::array<pollfd_t, 2> fds = {{ {mWakeFd, POLLIN, 0}, {mSocket, POLLOUT, 0} }};
+        const auto res = SysCall(::poll, fds.data(), waitWritable ? 2 : 1, -1);
+        if (res.IsError() && res.GetCode() != std::errc::interrupted) {
+            mFailed = true;
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            uint64_t count = 0;
+            (void)SysCall(::read, mWakeFd, &count, sizeof(count));
+        }
+        if (waitWritable && (fds[1].revents & (POLLERR | POLLHUP | POLLNVAL))) {
+            mFailed = true;
+        }
+    }
+
+    void Run() {
+        while (mRunning && !mFailed) {
+            const auto regions = mRing.Peek();
+            if (regions[0].size == 0) {
+                mSleeping.store(true, std::memory_order_relaxed);
+                // recheck after announcing we're asleep, a push may have raced us.
+                // the fence keeps the recheck after the store, see Push for the other half
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (mRing.IsEmpty() && mRunning) Wait(false);
+                mSleeping.store(false, std::memory_order_relaxed);
+                continue;
+            }
+
+            const std::optional<size_t> bytesSent = mType == LocalSocketType::SeqPacket ? SendPackets(regions) : SendStream(regions);
+            if (!bytesSent) {
+                Wait(true);
+            } else {
+                mRing.Consume(*bytesSent);
+            }
+        }
+    }
+
+    /// @return bytes of the ring that were sent, or nullopt if the socket would block
+    std::optional<size_t> SendStream(const std::array<SpscRingView::Region, 2>& regions) {
+        std::array<iovec, 2> iov = {{
+            {const_cast<uint8_t*>(regions[0].data), regions[0].size},
+            {const_cast<uint8_t*>(regions[1].data), regions[1].size}
+        }};
+        msghdr msg{};
+        msg.msg_iov = iov.data();
+        msg.msg_iovlen = regions[1].size ? 2 : 1;
+        // a closed peer should be an error, not a SIGPIPE
+        const std::optional<SysReturn> bytesSent = SysCallBlocking(::sendmsg, mSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (!bytesSent) return std::nullopt;
+        if (bytesSent->IsError() || bytesSent->Unwrap() <= 0) {
+            mFailed = true;
+            return 0;
+        }
+        return static_cast<size_t>(bytesSent->Unwrap());
+    }
+
+    /// send each queued frame without its size prefix as one message, as many as possible per syscall
+    /// @return bytes of the ring taken up by the frames that were sent, or nullopt if the socket would block
+    std::optional<size_t> SendPackets(const std::array<SpscRingView::Region, 2>& regions) {
+        const size_t used = regions[0].size + regions[1].size;
+        std::array<mmsghdr, sMaxPackets> msgs{};
+        std::array<iovec, 2 * sMaxPackets> iovs;
+        std::array<size_t, sMaxPackets> frameSizes;
+
+        // the producer only ever pushes whole frames, so a frame never ends past the readable bytes
+        size_t offset = 0;
+        unsigned int count = 0;
+        while (count < sMaxPackets && used - offset >= FrameDecoder::HEADER_SIZE) {
+            uint8_t header[FrameDecoder::HEADER_SIZE];
+            Slice(regions, offset, sizeof(header), header);
+            const size_t frameSize = static_cast<size_t>(header[0]) | static_cast<size_t>(header[1]) << 8U
+                | static_cast<size_t>(header[2]) << 16U | static_cast<size_t>(header[3]) << 24U;
+            if (frameSize < FrameDecoder::HEADER_SIZE || frameSize > used - offset) {
+                mFailed = true;
+                return 0;
+            }
+            msgs[count].msg_hdr.msg_iov = &iovs[2 * count];
+            msgs[count].msg_hdr.msg_iovlen = Slice(regions, offset + FrameDecoder::HEADER_SIZE, frameSize - FrameDecoder::HEADER_SIZE, &iovs[2 * count]);
+            frameSizes[count] = frameSize;
+            offset += frameSize;
+            count += 1;
+        }
+
+        const std::optional<SysReturn> packetsSent = SysCallBlocking(::sendmmsg, mSocket, msgs.data(), count, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (!packetsSent) return std::nullopt;
+        if (packetsSent->IsError() || packetsSent->Unwrap() <= 0) {
+            mFailed = true;
+            return 0;
+        }
+        size_t bytesSent = 0;
+        for (int i = 0; i < packetsSent->Unwrap(); ++i) bytesSent += frameSizes[i];
+        return bytesSent;
+    }
+
+    /// describe size bytes at offset into the readable regions with up to 2 iovecs
+    /// @return number of iovecs used
+    static size_t Slice(const std::array<SpscRingView::Region, 2>& regions, size_t offset, size_t size, iovec* out) {
+        size_t count = 0;
+        for (const SpscRingView::Region& region : regions) {
+            if (size == 0) break;
+            if (offset >= region.size) {
+                offset -= region.size;
+                continue;
+            }
+            const size_t part = std::min(size, region.size - offset);
+            out[count++] = {const_cast<uint8_t*>(region.data + offset), part};
+            size -= part;
+            offset = 0;
+        }
+        return count;
+    }
+    /// copy size bytes at offset into the readable regions into out
+    static void Slice(const std::array<SpscRingView::Region, 2>& regions, size_t offset, size_t size, uint8_t* out) {
+        std::array<iovec, 2> parts;
+        const size_t count = Slice(regions, offset, size, parts.data());
+        for (size_t i = 0; i < count; ++i) {
+            std::memcpy(out, parts[i].iov_base, parts[i].iov_len);
+            out += parts[i].iov_len;
+        }
+    }
+
+    /// most messages handed to a single sendmmsg
+    static constexpr unsigned int sMaxPackets = 64;
+
+    SpscRing mRing;
+    const DropPolicy mPolicy;
+    LocalSocketType mType = LocalSocketType::Stream;
+    const Descriptor mWakeFd;
+    Descriptor mSocket = -1;
+    std::thread mThread;
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mSleeping{false};
+    std::atomic<bool> mFailed{false};
+    std::atomic<size_t> mHighWater{0};
+    std::atomic<uint64_t> mDroppedWrites{0};
+    std::atomic<uint64_t> mDroppedBytes{0};
+};
@@ -0,0 +1,72 @@
+#pragma once
+// the SoA pose kernel, shared by matrix_utils.cpp and matrix_utils_avx.cpp.
+// the code is in an anonymous namespace, so each translation unit keeps its own copy
+// compiled for its own instruction set.
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include "matrix_utils.h"
+
+namespace {
+
+struct ScalarLanes {
+	using V = float;
+	static constexpr size_t Width = 1;
+	static V Load(const float *p) { return *p; }
+	static void Store(float *p, V v) { *p = v; }
+	static V Set(float f) { return f; }
+	static V Add(V a, V b) { return a + b; }
+	static V Sub(V a, V b) { return a - b; }
+	static V Mul(V a, V b) { return a * b; }
+	static V Max(V a, V b) { return a > b ? a : b; }
+	static V Sqrt(V a) { return std::sqrt(a); }
+	static V CopySign(V magnitude, V sign) { return std::copysign(magnitude, sign); }
+};
+
+// every pose is independent, so any padding past count is converted too and ignored
+template <typename L>
+void TransformPosesWith(PoseBatch &batch, const RigidTransform &transform) {
+	using V = typename L::V;
+	const V zero = L::Set(0.0f), one = L::Set(1.0f), half = L::Set(0.5f);
+	const V rw = L::Set(transform.qw), rx = L::Set(transform.qx), ry = L::Set(transform.qy), rz = L::Set(transform.qz);
+	const V r00 = L::Set(transform.r[0][0]), r01 = L::Set(transform.r[0][1]), r02 = L::Set(transform.r[0][2]);
+	const V r10 = L::Set(transform.r[1][0]), r11 = L::Set(transform.r[1][1]), r12 = L::Set(transform.r[1][2]);
+	const V r20 = L::Set(transform.r[2][0]), r21 = L::Set(transform.r[2][1]), r22 = L::Set(transform.r[2][2]);
+	const V tx = L::Set(transform.t[0]), ty = L::Set(transform.t[1]), tz = L::Set(transform.t[2]);
+
+	for (size_t i = 0; i < batch.count; i += L::Width) {
+		const V m00 = L::Load(&batch.m[0][i]), m01 = L::Load(&batch.m[1][i]), m02 = L::Load(&batch.m[2][i]), m03 = L::Load(&batch.m[3][i]);
+		const V m10 = L::Load(&batch.m[4][i]), m11 = L::Load(&batch.m[5][i]), m12 = L::Load(&batch.m[6][i]), m13 = L::Load(&batch.m[7][i]);
+		const V m20 = L::Load(&batch.m[8][i]), m21 = L::Load(&batch.m[9][i]), m22 = L::Load(&batch.m[10][i]), m23 = L::Load(&batch.m[11][i]);
+
+		// same as GetRotation, a NaN turns into 0 like it does with fmax
+		const V w = L::Mul(L::Sqrt(L::Max(L::Add(L::Add(L::Add(one, m00), m11), m22), zero)), half);
+		V x = L::Mul(L::Sqrt(L::Max(L::Sub(L::Sub(L::Add(one, m00), m11), m22), zero)), half);
+		V y = L::Mul(L::Sqrt(L::Max(L::Sub(L::Add(L::Sub(one, m00), m11), m22), zero)), half);
+		V z = L::Mul(L::Sqrt(L::Max(L::Add(L::Sub(L::Sub(one, m00), m11), m22), zero)), half);
+		x = L::CopySign(x, L::Sub(m21, m12));
+		y = L::CopySign(y, L::Sub(m02, m20));
+		z = L::CopySign(z, L::Sub(m10, m01));
+
+		// transform rotation * pose rotation
+		L::Store(&batch.qw[i], L::Sub(L::Sub(L::Mul(rw, w), L::Mul(rx, x)), L::Add(L::Mul(ry, y), L::Mul(rz, z))));
+		L::Store(&batch.qx[i], L::Add(L::Add(L::Mul(rw, x), L::Mul(rx, w)), L::Sub(L::Mul(ry, z), L::Mul(rz, y))));
+		L::Store(&batch.qy[i], L::Add(L::Sub(L::Mul(rw, y), L::Mul(rx, z)), L::Add(L::Mul(ry, w), L::Mul(rz, x))));
+		L::Store(&batch.qz[i], L::Add(L::Add(L::Mul(rw, z), L::Mul(rx, y)), L::Sub(L::Mul(rz, w), L::Mul(ry, x))));
+
+		// transform matrix * pose position + translation
+		L::Store(&batch.x[i], L::Add(L::Add(L::Mul(r00, m03), L::Mul(r01, m13)), L::Add(L::Mul(r02, m23), tx)));
+		L::Store(&batch.y[i], L::Add(L::Add(L::Mul(r10, m03), L::Mul(r11, m13)), L::Add(L::Mul(r12, m23), ty)));
+		L::Store(&batch.z[i], L::Add(L::Add(L::Mul(r20, m03), L::Mul(r21, m13)), L::Add(L::Mul(r22, m23), tz)));
+
+		// transform matrix * velocities, in place
+		for (auto velocity: {batch.v, batch.av}) {
+			const V vx = L::Load(&velocity[0][i]), vy = L::Load(&velocity[1][i]), vz = L::Load(&velocity[2][i]);
+			L::Store(&velocity[0][i], L::Add(L::Add(L::Mul(r00, vx), L::Mul(r01, vy)), L::Mul(r02, vz)));
+			L::Store(&velocity[1][i], L::Add(L::Add(L::Mul(r10, vx), L::Mul(r11, vy)), L::Mul(r12, vz)));
+			L::Store(&velocity[2][i], L::Add(L::Add(L::Mul(r20, vx), L::Mul(r21, vy)), L::Mul(r22, vz)));
+		}
+	}
+}
+
+}
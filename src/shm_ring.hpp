@@ -0,0 +1,231 @@
+#pragma once
+#include <atomic>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <climits>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <signal.h>
+
+#include "unix_sockets.hpp"
+#include "spsc_ring.hpp"
+
+/// one direction of a shared memory connection
+struct ShmRingControl {
+    SpscRingState ring;
+    /// bumped by the producer after every write, the consumer sleeps on it with a futex
+    alignas(64) std::atomic<uint32_t> wake_seq{0};
+    /// set by the consumer before it sleeps, so the producer only makes the wake syscall when needed
+    std::atomic<uint32_t> consumer_waiting{0};
+};
+
+/// layout at the start of the shared segment, followed by the to_server ring data then the to_feeder ring data.
+/// both rings carry the same frames as the socket: a little endian uint32 size (including itself) then a ProtobufMessage.
+struct ShmSegmentHeader {
+    static constexpr uint32_t MAGIC = 0x53525653; // "SVRS"
+    static constexpr uint32_t VERSION = 2;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t ring_capacity; /// bytes of data per direction
+    std::atomic<int32_t> server_pid; /// 0 once the server has shut down
+    /// the feeder currently attached, 0 if none
+    std::atomic<int32_t> feeder_pid;
+    /// to_server position where the attached feeder's frames start, anything before it is from an earlier feeder
+    std::atomic<uint64_t> feeder_start;
+    /// bumped by a feeder once it has set feeder_start, before it writes anything
+    std::atomic<uint32_t> feeder_generation;
+    ShmRingControl to_server;
+    ShmRingControl to_feeder;
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<int32_t>::is_always_lock_free
+    && std::atomic<uint64_t>::is_always_lock_free, "shared atomics must be lock-free");
+
+/// an endpoint of the shared memory connection, the server creates the segment and the feeder opens it.
+/// the server side doubles as the reference reader for the feeder's output.
+class ShmEndpoint {
+public:
+    enum class Side {
+        Server,
+        Feeder
+    };
+
+    /// server: create (or replace) the named segment, name is as for shm_open e.g. "/SlimeVRInput"
+    static ShmEndpoint Create(std::string_view name, size_t ringCapacity) {
+        const std::string path(name);
+        (void)SysCall(::shm_unlink, path.c_str());
+        const Descriptor fd = SysCall(::shm_open, path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600).Unwrap();
+        const size_t size = sizeof(ShmSegmentHeader) + 2 * ringCapacity;
+        const SysReturn truncated = SysCall(::ftruncate, fd, static_cast<off_t>(size));
+        if (truncated.IsError()) {
+            (void)SysCall(::close, fd);
+            truncated.ThrowCode();
+        }
+        ShmEndpoint endpoint(Side::Server, fd, size);
+        endpoint.mName = path;
+        ShmSegmentHeader* header = new (endpoint.mMapping) ShmSegmentHeader();
+        header->ring_capacity = ringCapacity;
+        header->server_pid = ::getpid();
+        header->feeder_pid = 0;
+        header->feeder_start = 0;
+        header->feeder_generation = 0;
+        header->version = ShmSegmentHeader::VERSION;
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = ShmSegmentHeader::MAGIC; // written last, marks the segment as ready
+        return endpoint;
+    }
+
+    /// feeder: attach to a segment created by a server, fails if another live feeder holds it
+    /// @return nullopt if there is no usable segment
+    static std::optional<ShmEndpoint> Open(std::string_view name) {
+        const std::string path(name);
+        const std::optional<SysReturn> fd = SysCallBlocking(::shm_open, path.c_str(), O_RDWR | O_CLOEXEC, 0);
+        if (!fd || fd->IsError()) return std::nullopt;
+
+        struct stat info;
+        if (SysCall(::fstat, fd->Unwrap(), &info).IsError() || static_cast<size_t>(info.st_size) < sizeof(ShmSegmentHeader)) {
+            (void)SysCall(::close, fd->Unwrap());
+            return std::nullopt;
+        }
+        ShmEndpoint endpoint(Side::Feeder, fd->Unwrap(), static_cast<size_t>(info.st_size));
+        ShmSegmentHeader* header = endpoint.GetHeader();
+        if (header->magic != ShmSegmentHeader::MAGIC || header->version != ShmSegmentHeader::VERSION
+            || sizeof(ShmSegmentHeader) + 2 * header->ring_capacity > endpoint.mSize
+            || !endpoint.IsPeerAlive()) {
+            return std::nullopt;
+        }
+
+        // take over from a feeder that died without detaching
+        int32_t previous = header->feeder_pid.load();
+        if (previous != 0 && IsProcessAlive(previous)) return std::nullopt;
+        if (!header->feeder_pid.compare_exchange_strong(previous, ::getpid())) return std::nullopt;
+        endpoint.Inbound().Clear();
+        // to_server can't be cleared from this side, so the server is told where this feeder's frames start.
+        // nothing else writes to it now, the previous feeder is gone.
+        header->feeder_start.store(header->to_server.ring.head.load(std::memory_order_acquire), std::memory_order_release);
+        header->feeder_generation.fetch_add(1, std::memory_order_release);
+        return endpoint;
+    }
+
+    ~ShmEndpoint() {
+        if (mMapping == nullptr) return;
+        ShmSegmentHeader* header = GetHeader();
+        if (mSide == Side::Feeder) {
+            int32_t self = ::getpid();
+            header->feeder_pid.compare_exchange_strong(self, 0);
+        } else {
+            header->server_pid = 0;
+            (void)SysCall(::shm_unlink, mName.c_str());
+        }
+        ::munmap(mMapping, mSize);
+        (void)SysCall(::close, mDescriptor);
+    }
+    ShmEndpoint(ShmEndpoint&& other) noexcept
+        : mSide(other.mSide), mName(std::move(other.mName)), mDescriptor(other.mDescriptor), mSize(other.mSize), mMapping(other.mMapping),
+        mFeederGeneration(other.mFeederGeneration) {
+        other.mMapping = nullptr;
+    }
+    ShmEndpoint(const ShmEndpoint&) = delete;
+    ShmEndpoint& operator=(const ShmEndpoint&) = delete;
+    ShmEndpoint& operator=(ShmEndpoint&&) = delete;
+
+    /// ring this side writes to
+    SpscRingView Outbound() { return RingFor(mSide == Side::Feeder); }
+    /// ring this side reads from
+    SpscRingView Inbound() { return RingFor(mSide == Side::Server); }
+
+    /// producer: write a buffer of whole frames, all or nothing, and wake the reader if it's asleep
+    bool Write(const uint8_t* data, size_t size) {
+        if (!Outbound().TryWrite(data, size)) return false;
+        ShmRingControl& control = OutboundControl();
+        control.wake_seq.fetch_add(1);
+        if (control.consumer_waiting.load()) {
+            (void)Futex(control.wake_seq, FUTEX_WAKE, INT_MAX, nullptr);
+        }
+        return true;
+    }
+    /// consumer: block until the inbound ring has data or timeoutMs passes (-1 forever)
+    /// @return true if there is data to read
+    bool WaitReadable(int timeoutMs) {
+        ShmRingControl& control = InboundControl();
+        const uint32_t seq = control.wake_seq.load();
+        if (!Inbound().IsEmpty()) return true;
+
+        timespec timeout{timeoutMs / 1000, (timeoutMs % 1000) * 1'000'000L};
+        control.consumer_waiting = 1;
+        // only sleeps if nothing was written since seq was read
+        if (Inbound().IsEmpty()) (void)Futex(control.wake_seq, FUTEX_WAIT, seq, timeoutMs < 0 ? nullptr : &timeout);
+        control.consumer_waiting = 0;
+        return !Inbound().IsEmpty();
+    }
+
+    /// the process on the other side is still attached and running
+    bool IsPeerAlive() const {
+        const int32_t pid = mSide == Side::Feeder ? GetHeader()->server_pid.load() : GetHeader()->feeder_pid.load();
+        return pid != 0 && IsProcessAlive(pid);
+    }
+    /// server: the feeder that's attached, 0 if none
+    int32_t GetFeederPid() const { return GetHeader()->feeder_pid.load(); }
+    /// server: readable bytes in to_server, use instead of Inbound().Peek().
+    /// whatever an earlier feeder left unread is consumed first, the attached one may already have sent its hello and trackers.
+    std::array<SpscRingView::Region, 2> PeekFeeder() {
+        ShmSegmentHeader* header = GetHeader();
+        for (;;) {
+            const uint32_t generation = header->feeder_generation.load(std::memory_order_acquire);
+            if (generation != mFeederGeneration) {
+                mFeederGeneration = generation;
+                SpscRingState& ring = header->to_server.ring;
+                const uint64_t start = header->feeder_start.load(std::memory_order_acquire);
+                if (ring.tail.load(std::memory_order_relaxed) < start) ring.tail.store(start, std::memory_order_release);
+            }
+            const auto regions = Inbound().Peek();
+            // a feeder bumps the generation before it writes, so if a new one attached in the meantime it shows here
+            if (header->feeder_generation.load(std::memory_order_acquire) == generation) return regions;
+        }
+    }
+
+private:
+    ShmEndpoint(Side side, Descriptor fd, size_t size) : mSide(side), mDescriptor(fd), mSize(size) {
+        void* mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const auto code = std::errc(errno);
+            (void)SysCall(::close, fd);
+            throw std::system_error(std::make_error_code(code));
+        }
+        mMapping = static_cast<uint8_t*>(mapping);
+    }
+
+    static bool IsProcessAlive(int32_t pid) {
+        // EPERM still means it exists, it's just not ours
+        const SysReturn res = SysCall(::kill, pid, 0);
+        return !res.IsError() || res.GetCode() == std::errc::operation_not_permitted;
+    }
+    static long Futex(std::atomic<uint32_t>& word, int op, uint32_t value, const timespec* timeout) {
+        // not FUTEX_PRIVATE_FLAG, the word is shared with another process
+        return ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), op, value, timeout, nullptr, 0);
+    }
+
+    ShmSegmentHeader* GetHeader() { return reinterpret_cast<ShmSegmentHeader*>(mMapping); }
+    const ShmSegmentHeader* GetHeader() const { return reinterpret_cast<const ShmSegmentHeader*>(mMapping); }
+    ShmRingControl& OutboundControl() { return mSide == Side::Feeder ? GetHeader()->to_server : GetHeader()->to_feeder; }
+    ShmRingControl& InboundControl() { return mSide == Side::Feeder ? GetHeader()->to_feeder : GetHeader()->to_server; }
+    SpscRingView RingFor(bool toServer) {
+        ShmSegmentHeader* header = GetHeader();
+        const size_t capacity = static_cast<size_t>(header->ring_capacity);
+        uint8_t* data = mMapping + sizeof(ShmSegmentHeader) + (toServer ? 0 : capacity);
+        return SpscRingView(toServer ? header->to_server.ring : header->to_feeder.ring, data, capacity);
+    }
+
+    Side mSide;
+    std::string mName; /// only kept by the server, which unlinks the segment when it's done
+    Descriptor mDescriptor;
+    size_t mSize;
+    uint8_t* mMapping = nullptr;
+    uint32_t mFeederGeneration = 0; /// server: the last generation PeekFeeder saw
+};
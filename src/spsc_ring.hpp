@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// read/write positions of a ring, only ever increase, the offset into the buffer is position % capacity
+/// plain atomics with no pointers, so it can also live in memory shared between processes
+struct SpscRingState {
+    alignas(64) std::atomic<uint64_t> head{0}; /// written by producer
+    alignas(64) std::atomic<uint64_t> tail{0}; /// written by consumer
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring positions must be lock-free to be shared between processes");
+
+/// lock-free byte ring for exactly one producer and one consumer, over storage owned by someone else
+/// the producer writes whole frames, the consumer may consume any number of bytes at a time
+class SpscRingView {
+public:
+    /// contiguous region of readable bytes
+    struct Region {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+    SpscRingView(SpscRingState& state, uint8_t* data, size_t capacity) : mState(&state), mData(data), mCapacity(capacity) {}
+
+    size_t GetCapacity() const { return mCapacity; }
+    /// bytes written but not yet consumed, safe to call from either side
+    size_t GetUsed() const { return static_cast<size_t>(mState->head.load(std::memory_order_acquire) - mState->tail.load(std::memory_order_acquire)); }
+    bool IsEmpty() const { return GetUsed() == 0; }
+
+    /// producer: copy the whole buffer into the ring, or nothing at all if it doesn't fit
+    bool TryWrite(const uint8_t* data, size_t size) {
+        const uint64_t head = mState->head.load(std::memory_order_relaxed);
+        const uint64_t tail = mState->tail.load(std::memory_order_acquire);
+        if (mCapacity - static_cast<size_t>(head - tail) < size) return false;
+
+        const size_t offset = static_cast<size_t>(head % mCapacity);
+        const size_t first = std::min(size, mCapacity - offset);
+        std::memcpy(&mData[offset], data, first);
+        std::memcpy(&mData[0], data + first, size - first);
+        mState->head.store(head + size, std::memory_order_release);
+        return true;
+    }
+
+    /// consumer: readable bytes, split in two when they wrap around the end of the ring
+    std::array<Region, 2> Peek() const {
+        const uint64_t tail = mState->tail.load(std::memory_order_relaxed);
+        const uint64_t head = mState->head.load(std::memory_order_acquire);
+        const size_t used = static_cast<size_t>(head - tail);
+        const size_t offset = static_cast<size_t>(tail % mCapacity);
+        const size_t first = std::min(used, mCapacity - offset);
+        return {{ {&mData[offset], first}, {&mData[0], used - first} }};
+    }
+    /// consumer: release bytes returned by Peek
+    void Consume(size_t size) {
+        mState->tail.store(mState->tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+    }
+    /// consumer: release everything currently readable
+    void Clear() {
+        mState->tail.store(mState->head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    SpscRingState* mState;
+    uint8_t* mData;
+    size_t mCapacity;
+};
+
+/// SpscRingView that owns its storage, for use between threads of one process
+class SpscRing : public SpscRingView {
+public:
+    explicit SpscRing(size_t capacity) : SpscRing(std::make_unique<SpscRingState>(), std::make_unique<uint8_t[]>(capacity), capacity) {}
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+private:
+    SpscRing(std::unique_ptr<SpscRingState> state, std::unique_ptr<uint8_t[]> data, size_t capacity)
+        : SpscRingView(*state, data.get(), capacity), mOwnedState(std::move(state)), mOwnedData(std::move(data)) {}
+
+    std::unique_ptr<SpscRingState> mOwnedState;
+    std::unique_ptr<uint8_t[]> mOwnedData;
+};
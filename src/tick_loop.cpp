@@ -0,0 +1,104 @@
+#include <thread>
+#include "tick_loop.hpp"
+
+#if defined(__linux__)
+#include <sys/timerfd.h>
+#include "unix_sockets.hpp"
+
+// a timerfd with absolute deadlines and the bridge socket in one epoll set,
+// so server messages are handled when they arrive and ticks don't drift or oversleep.
+class EpollTickLoop final : public TickLoop {
+    private:
+        event::Epoll epoll;
+        Descriptor timer;
+        Descriptor watched = -1;
+        uint32_t watched_id = 0;
+
+    public:
+        explicit EpollTickLoop(std::chrono::nanoseconds period) : timer(SysCall(::timerfd_create, CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC).Unwrap()) {
+            timespec now;
+            SysCall(::clock_gettime, CLOCK_MONOTONIC, &now).Unwrap();
+
+            itimerspec spec{};
+            spec.it_interval.tv_sec = period.count() / 1'000'000'000;
+            spec.it_interval.tv_nsec = period.count() % 1'000'000'000;
+            spec.it_value = now; // already due, the first tick runs immediately
+            SysCall(::timerfd_settime, timer, TFD_TIMER_ABSTIME, &spec, nullptr).Unwrap();
+
+            epoll.Add(timer, event::Readable);
+        }
+        ~EpollTickLoop() {
+            (void)SysCall(::close, timer);
+        }
+
+        void watch(int descriptor, uint32_t connection_id) final override {
+            if (descriptor == watched && connection_id == watched_id) {
+                return;
+            }
+            if (watched != -1) {
+                // fails harmlessly if closing the descriptor already removed it
+                epoll.Remove(watched);
+            }
+            watched = descriptor;
+            watched_id = connection_id;
+            if (watched != -1) {
+                epoll.Add(watched, event::Readable);
+            }
+        }
+
+        Wake wait() final override {
+            Wake wake;
+            epoll.Wait(-1, [&](Descriptor descriptor, event::Result res) {
+                if (descriptor == timer) {
+                    uint64_t expirations = 0;
+                    if (!SysCall(::read, timer, &expirations, sizeof(expirations)).IsError() && expirations > 0) {
+                        missed_ticks += expirations - 1;
+                        wake.tick = true;
+                    }
+                } else if (descriptor == watched) {
+                    wake.readable = res.IsReadable() || res.IsClosed() || res.IsErrored();
+                }
+            });
+            return wake;
+        }
+};
+
+#else
+
+// sleeps until the next deadline, messages from the server are only picked up on ticks.
+class SleepTickLoop final : public TickLoop {
+    private:
+        const std::chrono::nanoseconds period;
+        std::chrono::steady_clock::time_point next_tick = std::chrono::steady_clock::now();
+
+    public:
+        explicit SleepTickLoop(std::chrono::nanoseconds period) : period(period) {}
+
+        void watch(int descriptor, uint32_t connection_id) final override {}
+
+        Wake wait() final override {
+            const auto now = std::chrono::steady_clock::now();
+            if (next_tick > now) {
+                std::this_thread::sleep_until(next_tick);
+            } else {
+                // I don't care if you want more TPS than the feeder can provide, I'm yielding to the OS anyway.
+                // if this is really an issue for someone, they can open an issue.
+                std::this_thread::yield();
+            }
+            next_tick += period;
+
+            Wake wake;
+            wake.tick = true;
+            return wake;
+        }
+};
+
+#endif
+
+std::unique_ptr<TickLoop> TickLoop::factory(std::chrono::nanoseconds period) {
+#if defined(__linux__)
+    return std::make_unique<EpollTickLoop>(period);
+#else
+    return std::make_unique<SleepTickLoop>(period);
+#endif
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+// paces the main loop, waking for the next tick or as soon as the bridge has something to read
+class TickLoop {
+    public:
+        struct Wake {
+            bool tick = false; // the next tick is due
+            bool readable = false; // the watched descriptor has data waiting
+        };
+
+        virtual ~TickLoop() {};
+
+        // descriptor to wake up for besides the tick, -1 for none.
+        // connection_id tells a new connection apart from a closed one that reused the same descriptor.
+        virtual void watch(int descriptor, uint32_t connection_id) = 0;
+        // blocks until the next tick or the watched descriptor is readable, a signal ends the wait with neither set
+        virtual Wake wait() = 0;
+
+        // ticks that were skipped because a tick ran past the next deadline
+        uint64_t getMissedTicks() const { return missed_ticks; }
+
+        static std::unique_ptr<TickLoop> factory(std::chrono::nanoseconds period);
+
+    protected:
+        uint64_t missed_ticks = 0;
+};
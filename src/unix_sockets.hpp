@@ -1,3 +1,4 @@
+#pragma once
 #include <system_error>
 #include <stdexcept>
 #include <array>
@@ -18,7 +19,12 @@
 #include <sys/types.h>
 #include <sys/un.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
+#if defined(__linux__)
+#include <linux/sockios.h>
+#endif
 
 /// AF_UNIX / local socket specific address
 using sockaddr_un_t = struct sockaddr_un;
@@ -73,60 +79,65 @@ enum class SockMode {
 };
 
 /// bitmask for which events to return
-using Mask = short;
-inline constexpr Mask Readable = POLLIN; /// enable Readable events
-inline constexpr Mask Priority = POLLPRI; /// enable Priority events
-inline constexpr Mask Writable = POLLOUT; /// enable Writable events
+using Mask = uint32_t;
+inline constexpr Mask Readable = EPOLLIN; /// enable Readable events
+inline constexpr Mask Priority = EPOLLPRI; /// enable Priority events
+inline constexpr Mask Writable = EPOLLOUT; /// enable Writable events
 
 class Result {
 public:
-    explicit Result(short events) : v(events) {}
-    bool IsReadable() const { return (v & POLLIN) != 0; } /// without blocking, connector can call read or acceptor can call accept
-    bool IsPriority() const { return (v & POLLPRI) != 0; } /// some exceptional condition, for tcp this is OOB data
-    bool IsWritable() const { return (v & POLLOUT) != 0; } /// can call write without blocking
-    bool IsErrored() const { return (v & POLLERR) != 0; } /// error to be checked with Socket::GetError(), or write pipe's target read pipe was closed
-    bool IsClosed() const { return (v & POLLHUP) != 0; } /// socket closed, however for connector, subsequent reads must be called until returns 0
-    bool IsInvalid() const { return (v & POLLNVAL) != 0; } /// not an open descriptor and shouldn't be polled
+    explicit Result(uint32_t events) : v(events) {}
+    bool IsReadable() const { return (v & EPOLLIN) != 0; } /// without blocking, connector can call read or acceptor can call accept
+    bool IsPriority() const { return (v & EPOLLPRI) != 0; } /// some exceptional condition, for tcp this is OOB data
+    bool IsWritable() const { return (v & EPOLLOUT) != 0; } /// can call write without blocking
+    bool IsErrored() const { return (v & EPOLLERR) != 0; } /// error to be checked with Socket::GetError(), or write pipe's target read pipe was closed
+    bool IsClosed() const { return (v & EPOLLHUP) != 0; } /// socket closed, however for connector, subsequent reads must be called until returns 0
+    bool IsInvalid() const { return false; } /// epoll drops closed descriptors by itself, kept for parity with poll()
 private:
-    short v;
+    uint32_t v;
 };
-/// poll an acceptor and its connections
-class Poller {
-    static constexpr Mask mConnectorMask = Readable | Writable;
-    static constexpr Mask mAcceptorMask = Readable; 
+/// level triggered epoll instance, any descriptor can be added (sockets, timerfd, eventfd, ...)
+class Epoll {
+    static constexpr Descriptor sInvalid = -1;
+    static constexpr int sMaxEvents = 8;
 public:
-    void Poll(int timeoutMs) {
-        SysCall(::poll, mPollList.data(), mPollList.size(), timeoutMs).Unwrap();
+    Epoll() : mDescriptor(SysCall(::epoll_create1, EPOLL_CLOEXEC).Unwrap()) {}
+    ~Epoll() {
+        if (mDescriptor != sInvalid) (void)SysCall(::close, mDescriptor);
     }
-    /// @tparam TPred (Descriptor, event::Result, event::SockMode) -> void
-    template <typename TPred>
-    void Poll(int timeoutMs, TPred&& pred) {
-        Poll(timeoutMs);
-        for (const pollfd_t& elem : mPollList) {
-            SockMode mode = (elem.events == mAcceptorMask) ? SockMode::Acceptor : SockMode::Connector;
-            pred(elem.fd, Result(elem.revents), mode);
-        }
-    }
-    void AddConnector(Descriptor descriptor) {
-        mPollList.push_back({descriptor, mConnectorMask, 0});
-    }
-    void AddAcceptor(Descriptor descriptor) {
-        mPollList.push_back({descriptor, mAcceptorMask, 0});
-    }
-    Result At(int idx) const {
-        return Result(mPollList.at(idx).revents);
+    Epoll(const Epoll&) = delete;
+    Epoll& operator=(const Epoll&) = delete;
+
+    void Add(Descriptor descriptor, Mask mask) {
+        epoll_event ev{};
+        ev.events = mask;
+        ev.data.fd = descriptor;
+        SysCall(::epoll_ctl, mDescriptor, EPOLL_CTL_ADD, descriptor, &ev).Unwrap();
     }
+    /// @return false if the descriptor wasn't registered, closing a descriptor removes it automatically
     bool Remove(Descriptor descriptor) {
-        auto it = std::find_if(mPollList.begin(), mPollList.end(), 
-            [&](const pollfd_t& elem){ return elem.fd == descriptor; });
-        if (it == mPollList.end()) return false;
-        mPollList.erase(it);
-        return true;
+        epoll_event ev{}; // ignored, but pre 2.6.9 kernels require non null
+        return !SysCall(::epoll_ctl, mDescriptor, EPOLL_CTL_DEL, descriptor, &ev).IsError();
+    }
+    /// wait up to timeoutMs (-1 forever, 0 returns immediately), a signal ends the wait early with no events
+    /// @tparam TPred (Descriptor, event::Result) -> void
+    /// @return number of events
+    template <typename TPred>
+    int Wait(int timeoutMs, TPred&& pred) {
+        std::array<epoll_event, sMaxEvents> events;
+        const SysReturn res = SysCall(::epoll_wait, mDescriptor, events.data(), sMaxEvents, timeoutMs);
+        if (res.IsError()) {
+            if (res.GetCode() == std::errc::interrupted) return 0;
+            res.ThrowCode();
+        }
+        const int count = res.Unwrap();
+        for (int i = 0; i < count; ++i) {
+            pred(events[i].data.fd, Result(events[i].events));
+        }
+        return count;
     }
-    void Clear() { mPollList.clear(); }
-    int GetSize() const { return static_cast<int>(mPollList.size()); }
 private:
-    std::vector<pollfd_t> mPollList{};
+    Descriptor mDescriptor;
 };
 
 }
@@ -172,6 +183,20 @@ public:
     std::errc GetError() const {
         return static_cast<std::errc>(GetSockOpt<int>(SOL_SOCKET, SO_ERROR).first);
     }
+    /// kernel send buffer size, the kernel doubles the value for bookkeeping and enforces a minimum
+    void SetSendBufferSize(int bytes) { SetSockOpt<int>(SOL_SOCKET, SO_SNDBUF, bytes); }
+    /// kernel send buffer size, as doubled by the kernel
+    int GetSendBufferSize() const { return GetSockOpt<int>(SOL_SOCKET, SO_SNDBUF).first; }
+    /// bytes written but not yet read by the peer, nullopt if the platform can't tell
+    std::optional<int> GetSendQueueSize() const {
+#if defined(__linux__)
+        return GetQueueSize(SIOCOUTQ);
+#else
+        return std::nullopt;
+#endif
+    }
+    /// bytes received but not yet read
+    std::optional<int> GetRecvQueueSize() const { return GetQueueSize(FIONREAD); }
     void SetBlocking() { mIsNonBlocking = false; SetStatusFlags(GetStatusFlags() & ~(O_NONBLOCK)); }
     void SetNonBlocking() { mIsNonBlocking = true; SetStatusFlags(GetStatusFlags() | O_NONBLOCK); }
     // only applies to non blocking, and set from Update (poll), always return true if blocking
@@ -198,6 +223,11 @@ public:
 private:
     int GetStatusFlags() const { return SysCall(::fcntl, mDescriptor, F_GETFL, 0).Unwrap(); }
     void SetStatusFlags(int flags) { SysCall(::fcntl, mDescriptor, F_SETFL, flags).Unwrap(); }
+    std::optional<int> GetQueueSize(unsigned long request) const {
+        int bytes = 0;
+        if (SysCall(::ioctl, mDescriptor, request, &bytes).IsError()) return std::nullopt;
+        return bytes;
+    }
 
     /// get or set socket option, most are ints, non default length is only for strings
     template <typename T>
@@ -209,7 +239,7 @@ private:
     }
     template <typename T>
     void SetSockOpt(int level, int optname, const T& inputValue, socklen_t inputSize = sizeof(T)) {
-        SysCall(::setsockopt, level, optname, &inputValue, inputSize).Unwrap();
+        SysCall(::setsockopt, mDescriptor, level, optname, &inputValue, inputSize).Unwrap();
     }
 
     Descriptor mDescriptor;
@@ -265,12 +295,21 @@ private:
     sockaddr_un_t mAddress{};
 };
 
+/// how a local socket delimits messages
+enum class LocalSocketType {
+    Stream,   /// connection oriented, no message boundaries
+    SeqPacket /// connection oriented, every send is received as exactly one message
+};
+
 class LocalSocket : public Socket {
     static constexpr int sDomain = AF_UNIX, // unix domain socket
-                         sType = SOCK_STREAM, // connection oriented, no message boundaries
                          sProtocol = 0; // auto selected
+    static constexpr int ToSockType(LocalSocketType type) {
+        return type == LocalSocketType::SeqPacket ? SOCK_SEQPACKET : SOCK_STREAM;
+    }
 public:
-    explicit LocalSocket(std::string_view path) : Socket(sDomain, sType, sProtocol), mAddress(path) {}
+    explicit LocalSocket(std::string_view path, LocalSocketType type = LocalSocketType::Stream)
+        : Socket(sDomain, ToSockType(type), sProtocol), mAddress(path) {}
     LocalSocket(Descriptor descriptor, LocalAddress address) : Socket(descriptor), mAddress(address) {
         if (!mAddress.IsValid()) throw std::invalid_argument("invalid local socket address");
     }
@@ -288,8 +327,8 @@ private:
 /// connector manages a connection, can send/recv with
 class LocalConnectorSocket : public LocalSocket {
 public:
-    /// open as outbound connector to path
-    explicit LocalConnectorSocket(std::string_view path) : LocalSocket(path) {
+    /// open as outbound connector to path, fails with std::errc::wrong_protocol_type if the acceptor is of another type
+    explicit LocalConnectorSocket(std::string_view path, LocalSocketType type = LocalSocketType::Stream) : LocalSocket(path, type) {
         Connect();
     }
     /// open as inbound connector from accept
@@ -318,13 +357,35 @@ public:
         }
         return std::nullopt;
     }
+    /// receive whatever is waiting without polling first
+    /// @tparam TBufIt iterator to contiguous memory
+    /// @return number of bytes written to buffer (0 if the peer closed) or nullopt if blocking
+    template <typename TBufIt>
+    std::optional<int> RecvAvailable(TBufIt bufBegin, int bufSize) {
+        constexpr int flags = MSG_DONTWAIT;
+        if (auto bytesRecv = SysCallBlocking(::recv, GetDescriptor(), &(*bufBegin), bufSize, flags)) {
+            return (*bytesRecv).Unwrap();
+        }
+        return std::nullopt;
+    }
+    /// receive exactly one message from a SeqPacket socket without polling first
+    /// @tparam TBufIt iterator to contiguous memory
+    /// @return the full size of the message (more than bufSize if it was truncated, 0 if the peer closed) or nullopt if blocking
+    template <typename TBufIt>
+    std::optional<int> RecvMessage(TBufIt bufBegin, int bufSize) {
+        constexpr int flags = MSG_DONTWAIT | MSG_TRUNC;
+        if (auto bytesRecv = SysCallBlocking(::recv, GetDescriptor(), &(*bufBegin), bufSize, flags)) {
+            return (*bytesRecv).Unwrap();
+        }
+        return std::nullopt;
+    }
 };
 
 /// aka listener/passive socket, accepts connectors
 class LocalAcceptorSocket : public LocalSocket {
 public:
     /// open as acceptor on path, backlog is accept queue size
-    LocalAcceptorSocket(std::string_view path, int backlog) : LocalSocket(path) {
+    LocalAcceptorSocket(std::string_view path, int backlog, LocalSocketType type = LocalSocketType::Stream) : LocalSocket(path, type) {
         UnlinkAddress();
         Bind();
         Listen(backlog);
@@ -342,24 +403,27 @@ public:
 
 /// manage a single outbound connector
 class BasicLocalClient {
+    static constexpr event::Mask sConnectorMask = event::Readable | event::Writable;
 public:
-    void Open(std::string_view path) {
+    void Open(std::string_view path, LocalSocketType type = LocalSocketType::Stream) {
         if (IsOpen()) throw std::runtime_error("connection already open");
-        mConnector = LocalConnectorSocket(path);
-        mPoller.AddConnector(mConnector->GetDescriptor());
-        assert(mPoller.GetSize() == 1);
+        mConnector = LocalConnectorSocket(path, type);
+        mType = type;
+        mEpoll.Add(mConnector->GetDescriptor(), sConnectorMask);
     }
     void Close() {
+        if (IsOpen()) mEpoll.Remove(mConnector->GetDescriptor());
         mConnector.reset();
-        mPoller.Clear();
     }
 
     /// default timeout returns immediately
     void UpdateOnce(int timeoutMs = 0) {
         if (!IsOpen()) throw std::runtime_error("connection not open");
-        mPoller.Poll(timeoutMs);
-
-        if (!mConnector->Update(mPoller.At(0))) {
+        bool keepOpen = true;
+        mEpoll.Wait(timeoutMs, [&](Descriptor, event::Result res) {
+            keepOpen = mConnector->Update(res);
+        });
+        if (!keepOpen) {
             Close();
         }
     }
@@ -409,6 +473,24 @@ public:
         return bytesRecv.value_or(0);
     }
 
+    /// receive whatever is waiting, never blocks or polls
+    /// @tparam TBufIt iterator to contiguous memory
+    /// @return number of bytes written to buffer, 0 if the peer closed (the connector is left open), or nullopt if nothing is waiting
+    template <typename TBufIt>
+    std::optional<int> RecvAvailable(TBufIt bufBegin, int bufSize) {
+        if (!IsOpen()) return 0;
+        return mConnector->RecvAvailable(bufBegin, bufSize);
+    }
+
+    /// receive exactly one message from a SeqPacket connection, never blocks or polls
+    /// @tparam TBufIt iterator to contiguous memory
+    /// @return full size of the message (more than bufSize if it was truncated), 0 if the peer closed, or nullopt if nothing is waiting
+    template <typename TBufIt>
+    std::optional<int> RecvMessage(TBufIt bufBegin, int bufSize) {
+        if (!IsOpen()) return 0;
+        return mConnector->RecvMessage(bufBegin, bufSize);
+    }
+
     /// receive into byte buffer, continously updates until all bytes are read
     /// @tparam TBufIt iterator to contiguous memory
     /// @return true if bytesToRead bytes were written to buffer
@@ -439,8 +521,34 @@ public:
     }
 
     bool IsOpen() const { return mConnector.has_value(); }
+    /// type the open connector was opened with
+    LocalSocketType GetType() const { return mType; }
+    void SetSendBufferSize(int bytes) {
+        if (!IsOpen()) throw std::runtime_error("connection not open");
+        mConnector->SetSendBufferSize(bytes);
+    }
+    int GetSendBufferSize() const {
+        if (!IsOpen()) throw std::runtime_error("connection not open");
+        return mConnector->GetSendBufferSize();
+    }
+    /// bytes the server hasn't read yet, nullopt if closed or the platform can't tell
+    std::optional<int> GetSendQueueSize() const {
+        if (!IsOpen()) return std::nullopt;
+        return mConnector->GetSendQueueSize();
+    }
+    /// bytes the server sent that haven't been read yet, nullopt if closed
+    std::optional<int> GetRecvQueueSize() const {
+        if (!IsOpen()) return std::nullopt;
+        return mConnector->GetRecvQueueSize();
+    }
+    /// descriptor of the open connector, for handing to other threads or pollers
+    Descriptor GetDescriptor() const {
+        if (!IsOpen()) throw std::runtime_error("connection not open");
+        return mConnector->GetDescriptor();
+    }
 
 private:
     std::optional<LocalConnectorSocket> mConnector{};
-    event::Poller mPoller{}; // index 0 is connector if open
+    LocalSocketType mType = LocalSocketType::Stream;
+    event::Epoll mEpoll{}; // only ever holds the connector
 };
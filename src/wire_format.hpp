@@ -0,0 +1,425 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <google/protobuf/descriptor.h>
+#include <ProtobufMessages.pb.h>
+
+/// how messages are encoded inside each size prefixed frame
+enum class WireFormat {
+    Protobuf,     /// every message is a ProtobufMessage
+    CompactPose,  /// positions are sent as CompactPose records, everything else is still a ProtobufMessage
+    QuantizedPose /// positions are sent as QuantizedPose records, everything else is still a ProtobufMessage
+};
+
+/// true if a position has velocities, which neither pose record carries. the bridge sends those as a ProtobufMessage whatever the format.
+inline bool HasVelocity(const messages::Position& position) {
+    return position.has_vx() || position.has_vy() || position.has_vz() || position.has_avx() || position.has_avy() || position.has_avz();
+}
+
+/// byte order helpers shared by the encoders below
+struct LittleEndian {
+    static void WriteU32(uint8_t* out, uint32_t value) {
+        out[0] = value & 0xFF;
+        out[1] = (value >> 8U) & 0xFF;
+        out[2] = (value >> 16U) & 0xFF;
+        out[3] = (value >> 24U) & 0xFF;
+    }
+    static void WriteFloat(uint8_t* out, float value) {
+        LittleEndian::WriteU32(out, FloatBits(value));
+    }
+    static uint32_t ReadU32(const uint8_t* it) {
+        return static_cast<uint32_t>(it[0])
+            | static_cast<uint32_t>(it[1]) << 8U
+            | static_cast<uint32_t>(it[2]) << 16U
+            | static_cast<uint32_t>(it[3]) << 24U;
+    }
+    static float ReadFloat(const uint8_t* it) {
+        const uint32_t bits = ReadU32(it);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    static uint32_t FloatBits(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+    /// the low `bytes` bytes of value
+    static void WriteBytes(uint8_t* out, uint64_t value, size_t bytes) {
+        for (size_t i = 0; i < bytes; ++i) out[i] = (value >> (8U * i)) & 0xFF;
+    }
+    static uint64_t ReadBytes(const uint8_t* it, size_t bytes) {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i) value |= static_cast<uint64_t>(it[i]) << (8U * i);
+        return value;
+    }
+};
+
+/// fixed size little endian pose record, used in place of a Position message.
+/// the body starts with a 0 byte, which can never start a ProtobufMessage (field number 0 is invalid),
+/// so a reader can tell the two apart frame by frame.
+///
+///   offset  size  field
+///        0     1  tag, always 0
+///        1     1  data source, as messages::Position::DataSource
+///        2     2  reserved, 0
+///        4     4  int32 tracker id
+///        8    12  float x, y, z
+///       20    16  float qw, qx, qy, qz
+///       36     8  uint64 timestamp, microseconds on the system's monotonic clock
+///
+/// velocities aren't carried (see HasVelocity), the timestamp is the Position's own if it has one and the send time otherwise.
+class CompactPose {
+public:
+    static constexpr uint8_t TAG = 0x00;
+    static constexpr size_t BODY_SIZE = 44;
+
+    /// true if a frame body holds a CompactPose rather than a ProtobufMessage
+    static bool Is(const uint8_t* body, size_t size) {
+        return size > 0 && body[0] == TAG;
+    }
+
+    static void Encode(const messages::Position& position, uint64_t timestampUs, uint8_t* out) {
+        out[0] = TAG;
+        out[1] = static_cast<uint8_t>(position.data_source());
+        out[2] = 0;
+        out[3] = 0;
+        LittleEndian::WriteU32(out + 4, static_cast<uint32_t>(position.tracker_id()));
+        LittleEndian::WriteFloat(out + 8, position.x());
+        LittleEndian::WriteFloat(out + 12, position.y());
+        LittleEndian::WriteFloat(out + 16, position.z());
+        LittleEndian::WriteFloat(out + 20, position.qw());
+        LittleEndian::WriteFloat(out + 24, position.qx());
+        LittleEndian::WriteFloat(out + 28, position.qy());
+        LittleEndian::WriteFloat(out + 32, position.qz());
+        LittleEndian::WriteU32(out + 36, static_cast<uint32_t>(timestampUs));
+        LittleEndian::WriteU32(out + 40, static_cast<uint32_t>(timestampUs >> 32U));
+    }
+
+    /// @return false if the body isn't a well formed CompactPose
+    static bool Decode(const uint8_t* body, size_t size, messages::Position& position, uint64_t& timestampUs) {
+        if (size != BODY_SIZE || body[0] != TAG || !messages::Position_DataSource_IsValid(body[1])) return false;
+        position.Clear();
+        position.set_data_source(static_cast<messages::Position_DataSource>(body[1]));
+        position.set_tracker_id(static_cast<int32_t>(LittleEndian::ReadU32(body + 4)));
+        position.set_x(LittleEndian::ReadFloat(body + 8));
+        position.set_y(LittleEndian::ReadFloat(body + 12));
+        position.set_z(LittleEndian::ReadFloat(body + 16));
+        position.set_qw(LittleEndian::ReadFloat(body + 20));
+        position.set_qx(LittleEndian::ReadFloat(body + 24));
+        position.set_qy(LittleEndian::ReadFloat(body + 28));
+        position.set_qz(LittleEndian::ReadFloat(body + 32));
+        timestampUs = static_cast<uint64_t>(LittleEndian::ReadU32(body + 36)) | static_cast<uint64_t>(LittleEndian::ReadU32(body + 40)) << 32U;
+        return true;
+    }
+};
+
+/// a smaller fixed size pose record, for when bandwidth matters more than the last bits of precision.
+/// positions are rounded to the millimetre, rotations are sent as the three smallest quaternion components.
+/// starts with a 1 byte, which like CompactPose's 0 can never start a ProtobufMessage.
+///
+///   offset  size  field
+///        0     1  tag, always 1
+///        1     1  data source, as messages::Position::DataSource
+///        2     4  int32 tracker id
+///        6     9  int24 x, y, z in millimetres, clamped to about +-8 km
+///       15     6  rotation: bits 45-46 index (w, x, y, z) of the largest component, which is left out and made positive,
+///                 bits 30-44, 15-29 and 0-14 the other three in order, each mapped from [-1/sqrt(2), 1/sqrt(2)] to 0..32766
+///       21     8  uint64 timestamp, microseconds on the system's monotonic clock
+///
+/// the rotation is off by less than 0.01 degrees, the position by about half a millimetre.
+/// velocities aren't carried either.
+class QuantizedPose {
+public:
+    static constexpr uint8_t TAG = 0x01;
+    static constexpr size_t BODY_SIZE = 29;
+
+    /// true if a frame body holds a QuantizedPose rather than a ProtobufMessage
+    static bool Is(const uint8_t* body, size_t size) {
+        return size > 0 && body[0] == TAG;
+    }
+
+    static void Encode(const messages::Position& position, uint64_t timestampUs, uint8_t* out) {
+        out[0] = TAG;
+        out[1] = static_cast<uint8_t>(position.data_source());
+        LittleEndian::WriteU32(out + 2, static_cast<uint32_t>(position.tracker_id()));
+        LittleEndian::WriteBytes(out + 6, static_cast<uint32_t>(ToMillimetres(position.x())), 3);
+        LittleEndian::WriteBytes(out + 9, static_cast<uint32_t>(ToMillimetres(position.y())), 3);
+        LittleEndian::WriteBytes(out + 12, static_cast<uint32_t>(ToMillimetres(position.z())), 3);
+        LittleEndian::WriteBytes(out + 15, PackRotation(position.qw(), position.qx(), position.qy(), position.qz()), 6);
+        LittleEndian::WriteBytes(out + 21, timestampUs, 8);
+    }
+
+    /// @return false if the body isn't a well formed QuantizedPose
+    static bool Decode(const uint8_t* body, size_t size, messages::Position& position, uint64_t& timestampUs) {
+        if (size != BODY_SIZE || body[0] != TAG || !messages::Position_DataSource_IsValid(body[1])) return false;
+        position.Clear();
+        position.set_data_source(static_cast<messages::Position_DataSource>(body[1]));
+        position.set_tracker_id(static_cast<int32_t>(LittleEndian::ReadU32(body + 2)));
+        position.set_x(FromMillimetres(LittleEndian::ReadBytes(body + 6, 3)));
+        position.set_y(FromMillimetres(LittleEndian::ReadBytes(body + 9, 3)));
+        position.set_z(FromMillimetres(LittleEndian::ReadBytes(body + 12, 3)));
+        float q[4];
+        UnpackRotation(LittleEndian::ReadBytes(body + 15, 6), q);
+        position.set_qw(q[0]);
+        position.set_qx(q[1]);
+        position.set_qy(q[2]);
+        position.set_qz(q[3]);
+        timestampUs = LittleEndian::ReadBytes(body + 21, 8);
+        return true;
+    }
+
+private:
+    static constexpr int32_t MAX_MILLIMETRES = (1 << 23) - 1;
+    static constexpr uint32_t COMPONENT_HALF = (1U << 14U) - 1; // so 0 is exact
+    static constexpr uint64_t COMPONENT_MASK = (1U << 15U) - 1;
+    static constexpr float COMPONENT_RANGE = 0.70710678f; // 1/sqrt(2), no smaller component can be outside +-this
+
+    /// to the nearest integer, for values already clamped to fit. std::lround is a library call.
+    static int32_t Round(float value) {
+        return static_cast<int32_t>(value + (value < 0.0f ? -0.5f : 0.5f));
+    }
+    static int32_t ToMillimetres(float metres) {
+        if (!std::isfinite(metres)) return 0;
+        const float millimetres = std::clamp(metres * 1000.0f, static_cast<float>(-MAX_MILLIMETRES), static_cast<float>(MAX_MILLIMETRES));
+        return Round(millimetres);
+    }
+    static float FromMillimetres(uint64_t bits) {
+        // sign extend from 24 bits
+        const auto millimetres = static_cast<int32_t>(static_cast<uint32_t>(bits) << 8U) >> 8;
+        return static_cast<float>(millimetres) / 1000.0f;
+    }
+
+    static uint64_t PackRotation(float qw, float qx, float qy, float qz) {
+        float q[4] = {qw, qx, qy, qz};
+        float norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        if (!(norm > 0.0f) || !std::isfinite(norm)) {
+            // nothing sensible to send, the identity at least decodes to something valid
+            q[0] = 1.0f;
+            q[1] = q[2] = q[3] = 0.0f;
+            norm = 1.0f;
+        }
+
+        uint64_t largest = 0;
+        for (uint64_t i = 1; i < 4; ++i) {
+            if (std::abs(q[i]) > std::abs(q[largest])) largest = i;
+        }
+        // q and -q are the same rotation, so flip it to make the dropped component positive
+        const float scale = (q[largest] < 0.0f ? -1.0f : 1.0f) / norm;
+
+        uint64_t packed = largest;
+        for (uint64_t i = 0; i < 4; ++i) {
+            if (i == largest) continue;
+            const float unit = std::clamp(q[i] * scale / COMPONENT_RANGE, -1.0f, 1.0f);
+            const auto component = static_cast<uint64_t>(Round(unit * COMPONENT_HALF) + static_cast<int32_t>(COMPONENT_HALF));
+            packed = (packed << 15U) | component;
+        }
+        return packed;
+    }
+    static void UnpackRotation(uint64_t packed, float q[4]) {
+        const uint64_t largest = (packed >> 45U) & 3U;
+        float sum = 0.0f;
+        int shift = 30;
+        for (uint64_t i = 0; i < 4; ++i) {
+            if (i == largest) continue;
+            const auto component = static_cast<int32_t>((packed >> shift) & COMPONENT_MASK) - static_cast<int32_t>(COMPONENT_HALF);
+            q[i] = static_cast<float>(component) / COMPONENT_HALF * COMPONENT_RANGE;
+            sum += q[i] * q[i];
+            shift -= 15;
+        }
+        q[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+    }
+};
+
+/// encodes the messages sent every tick (Position, PositionBatch and TrackerStatus) without going through the generated code.
+/// the output is byte for byte what ProtobufMessage::SerializeToArray produces: fields in number order,
+/// implicit presence fields skipped when zero (floats by their bits, so -0 is still sent), optional ones when unset.
+/// anything else is left to libprotobuf. unknown fields are ignored, the feeder only sends messages it built itself.
+class HotMessageEncoder {
+public:
+    /// the largest Position or TrackerStatus Encode can produce, batches grow with the number of positions
+    static constexpr size_t MAX_SIZE = 2 + 11 + 3 * 5 + 4 * 5 + 11 + 6 * 5 + 12;
+
+    static bool Handles(const messages::ProtobufMessage& msg) {
+        if (!MatchesSchema()) {
+            return false;
+        }
+        switch (msg.message_case()) {
+            case messages::ProtobufMessage::kPosition:
+            case messages::ProtobufMessage::kPositionBatch:
+                return true;
+            case messages::ProtobufMessage::kTrackerStatus:
+                return msg.tracker_status().extra_size() == 0;
+            default:
+                return false;
+        }
+    }
+
+    /// @return the encoded size, only valid if Handles(msg)
+    static size_t Size(const messages::ProtobufMessage& msg) {
+        switch (msg.message_case()) {
+            case messages::ProtobufMessage::kPosition:
+                return 2 + PositionSize(msg.position());
+            case messages::ProtobufMessage::kPositionBatch: {
+                const size_t size = BatchSize(msg.position_batch());
+                return 2 + VarintSize(static_cast<uint64_t>(size)) + size;
+            }
+            default:
+                return 2 + StatusSize(msg.tracker_status());
+        }
+    }
+
+    /// writes Size(msg) bytes to out, only valid if Handles(msg)
+    /// @return the number of bytes written
+    static size_t Encode(const messages::ProtobufMessage& msg, uint8_t* out) {
+        uint8_t* it = out;
+        switch (msg.message_case()) {
+            case messages::ProtobufMessage::kPosition:
+                *it++ = POSITION_TAG;
+                it = WritePosition(it, msg.position());
+                break;
+            case messages::ProtobufMessage::kPositionBatch: {
+                const messages::PositionBatch& batch = msg.position_batch();
+                // field 100 takes two bytes
+                *it++ = static_cast<uint8_t>(POSITION_BATCH_TAG | 0x80);
+                *it++ = static_cast<uint8_t>(POSITION_BATCH_TAG >> 7U);
+                it = WriteVarint(it, BatchSize(batch));
+                for (const messages::Position& position: batch.positions()) {
+                    *it++ = BATCH_POSITIONS_TAG;
+                    it = WritePosition(it, position);
+                }
+                break;
+            }
+            default: {
+                const messages::TrackerStatus& status = msg.tracker_status();
+                *it++ = TRACKER_STATUS_TAG;
+                *it++ = static_cast<uint8_t>(StatusSize(status));
+                if (status.tracker_id() != 0) it = WriteVarintField(it, 1, status.tracker_id());
+                if (status.status() != 0) it = WriteVarintField(it, 2, status.status());
+                if (status.has_confidence()) it = WriteVarintField(it, 4, status.confidence());
+                break;
+            }
+        }
+        return it - out;
+    }
+
+    /// false if the generated messages have fields the encoder doesn't know about, which it would silently drop.
+    /// everything is left to libprotobuf then, until the encoder is taught the new fields.
+    static bool MatchesSchema() {
+        static const bool matches = [] {
+            const google::protobuf::Descriptor* message = messages::ProtobufMessage::descriptor();
+            return message->field_count() == message->oneof_decl(0)->field_count()
+                && messages::Position::descriptor()->field_count() == 16
+                && messages::PositionBatch::descriptor()->field_count() == 1
+                && messages::TrackerStatus::descriptor()->field_count() == 4;
+        }();
+        return matches;
+    }
+
+private:
+    // (field number << 3) | wire type, for ProtobufMessage's length delimited fields
+    static constexpr uint8_t POSITION_TAG = (1 << 3) | 2;
+    static constexpr uint8_t TRACKER_STATUS_TAG = (4 << 3) | 2;
+    static constexpr uint16_t POSITION_BATCH_TAG = (100 << 3) | 2;
+    // and PositionBatch's
+    static constexpr uint8_t BATCH_POSITIONS_TAG = (1 << 3) | 2;
+    static constexpr uint8_t VARINT = 0;
+    static constexpr uint8_t FIXED32 = 5;
+
+    // Position and TrackerStatus bodies are always shorter than 128 bytes, so their length is a single byte
+
+    static size_t PositionSize(const messages::Position& position) {
+        size_t size = 0;
+        if (position.tracker_id() != 0) size += 1 + VarintSize(position.tracker_id());
+        size += (position.has_x() + position.has_y() + position.has_z()) * 5;
+        size += (LittleEndian::FloatBits(position.qx()) != 0) * 5;
+        size += (LittleEndian::FloatBits(position.qy()) != 0) * 5;
+        size += (LittleEndian::FloatBits(position.qz()) != 0) * 5;
+        size += (LittleEndian::FloatBits(position.qw()) != 0) * 5;
+        if (position.has_data_source()) size += 1 + VarintSize(position.data_source());
+        size += (position.has_vx() + position.has_vy() + position.has_vz()) * 5;
+        size += (position.has_avx() + position.has_avy() + position.has_avz()) * 5;
+        if (position.has_timestamp()) size += 2 + VarintSize(position.timestamp());
+        return size;
+    }
+
+    static size_t BatchSize(const messages::PositionBatch& batch) {
+        size_t size = 0;
+        for (const messages::Position& position: batch.positions()) size += 2 + PositionSize(position);
+        return size;
+    }
+
+    static size_t StatusSize(const messages::TrackerStatus& status) {
+        size_t size = 0;
+        if (status.tracker_id() != 0) size += 1 + VarintSize(status.tracker_id());
+        if (status.status() != 0) size += 1 + VarintSize(status.status());
+        if (status.has_confidence()) size += 1 + VarintSize(status.confidence());
+        return size;
+    }
+
+    /// length prefixed, the tag is up to the caller
+    static uint8_t* WritePosition(uint8_t* it, const messages::Position& position) {
+        // the length is always one byte, so it can be filled in afterwards instead of working it out first
+        uint8_t* length = it++;
+        if (position.tracker_id() != 0) it = WriteVarintField(it, 1, position.tracker_id());
+        if (position.has_x()) it = WriteFloatField(it, 2, position.x());
+        if (position.has_y()) it = WriteFloatField(it, 3, position.y());
+        if (position.has_z()) it = WriteFloatField(it, 4, position.z());
+        it = WriteImplicitFloatField(it, 5, position.qx());
+        it = WriteImplicitFloatField(it, 6, position.qy());
+        it = WriteImplicitFloatField(it, 7, position.qz());
+        it = WriteImplicitFloatField(it, 8, position.qw());
+        if (position.has_data_source()) it = WriteVarintField(it, 9, position.data_source());
+        if (position.has_vx()) it = WriteFloatField(it, 10, position.vx());
+        if (position.has_vy()) it = WriteFloatField(it, 11, position.vy());
+        if (position.has_vz()) it = WriteFloatField(it, 12, position.vz());
+        if (position.has_avx()) it = WriteFloatField(it, 13, position.avx());
+        if (position.has_avy()) it = WriteFloatField(it, 14, position.avy());
+        if (position.has_avz()) it = WriteFloatField(it, 15, position.avz());
+        if (position.has_timestamp()) {
+            // field 16 no longer fits in a one byte tag
+            *it++ = 0x80;
+            *it++ = 0x01;
+            it = WriteVarint(it, position.timestamp());
+        }
+        *length = static_cast<uint8_t>(it - length - 1);
+        return it;
+    }
+
+    /// int32 and enum values are sign extended to 64 bits, so negative ones always take 10 bytes
+    static size_t VarintSize(int32_t value) {
+        return VarintSize(static_cast<uint64_t>(static_cast<int64_t>(value)));
+    }
+    static size_t VarintSize(uint64_t value) {
+        size_t size = 1;
+        for (uint64_t rest = value >> 7U; rest != 0; rest >>= 7U) size += 1;
+        return size;
+    }
+
+    static uint8_t* WriteVarint(uint8_t* it, uint64_t value) {
+        while (value >= 0x80) {
+            *it++ = static_cast<uint8_t>(value | 0x80);
+            value >>= 7U;
+        }
+        *it++ = static_cast<uint8_t>(value);
+        return it;
+    }
+
+    static uint8_t* WriteVarintField(uint8_t* it, uint8_t field, int32_t value) {
+        *it++ = static_cast<uint8_t>(field << 3U) | VARINT;
+        return WriteVarint(it, static_cast<uint64_t>(static_cast<int64_t>(value)));
+    }
+
+    static uint8_t* WriteFloatField(uint8_t* it, uint8_t field, float value) {
+        *it++ = static_cast<uint8_t>(field << 3U) | FIXED32;
+        LittleEndian::WriteFloat(it, value);
+        return it + 4;
+    }
+
+    static uint8_t* WriteImplicitFloatField(uint8_t* it, uint8_t field, float value) {
+        return LittleEndian::FloatBits(value) != 0 ? WriteFloatField(it, field, value) : it;
+    }
+};
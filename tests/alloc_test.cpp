@@ -0,0 +1,99 @@
+// once trackers are detected and the server is connected, a tick doesn't touch the heap.
+// operator new is replaced to count allocations, only the ones made while the feeder runs are counted.
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "run_feeder.hpp"
+#include "fake_server.hpp"
+
+static std::atomic<bool> counting = false;
+static std::atomic<uint64_t> allocations = 0;
+
+static void *counted_alloc(size_t size) {
+    if (counting) allocations += 1;
+    if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+static void *counted_alloc(size_t size, const std::nothrow_t &) noexcept {
+    if (counting) allocations += 1;
+    return std::malloc(size ? size : 1);
+}
+
+// simdjson asks for its buffers with nothrow
+void *operator new(size_t size) { return counted_alloc(size); }
+void *operator new[](size_t size) { return counted_alloc(size); }
+void *operator new(size_t size, const std::nothrow_t &tag) noexcept { return counted_alloc(size, tag); }
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept { return counted_alloc(size, tag); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { std::free(ptr); }
+
+// long enough for the handshake and the first detection to be over
+static constexpr uint64_t SETTLE_TICKS = 50;
+// two sweeps, so detection and the universe lookup are counted too
+static constexpr uint64_t COUNTED_TICKS = 2 * SWEEP_TICKS;
+
+// two moving trackers, one of which loses tracking now and then, against a server that reads everything.
+// under LatestPoseWins every message goes through the pending slots, so they keep changing between
+// positions and statuses.
+static void test_steady_ticks(const char *backpressure) {
+    fake_openvr::Reset();
+    auto &runtime = fake_openvr::GetRuntime();
+    runtime.AddDevice(1, TrackedDeviceClass_GenericTracker);
+    runtime.AddDevice(2, TrackedDeviceClass_GenericTracker);
+    runtime.pose_bindings["/actions/main/in/waist"] = 1;
+    runtime.pose_bindings["/actions/main/in/left_foot"] = 2;
+
+    FakeServer server;
+    std::vector<messages::ProtobufMessage> received;
+    uint64_t counted = 0;
+    // what the server got while allocations were counted, so there's no passing by sending nothing
+    uint64_t positions = 0;
+    uint64_t statuses = 0;
+    runtime.on_tick = [&](uint64_t tick) {
+        counting = false;
+        if (tick == SETTLE_TICKS) {
+            allocations = 0;
+        }
+        if (tick == SETTLE_TICKS + COUNTED_TICKS) {
+            counted = allocations;
+            runtime.Quit();
+        }
+
+        runtime.devices[1].pose.mDeviceToAbsoluteTracking.m[1][3] = 1.0f + 0.001f * (float)(tick % 100);
+        runtime.devices[2].pose.mDeviceToAbsoluteTracking.m[1][3] = 1.0f + 0.001f * (float)(tick % 100);
+        runtime.devices[2].pose.bPoseIsValid = tick % 20 >= 5;
+        if (server.TryAccept()) {
+            received.clear();
+            server.Receive(received);
+            for (const auto &msg: received) {
+                if (tick <= SETTLE_TICKS) continue;
+                if (msg.has_position()) positions += 1;
+                if (msg.has_tracker_status()) statuses += 1;
+            }
+        }
+        counting = tick >= SETTLE_TICKS;
+    };
+
+    char name[] = "feeder";
+    char flag[] = "--backpressure";
+    std::string mode = backpressure;
+    char *argv[] = {name, flag, mode.data(), nullptr};
+    const int result = feeder_main(3, argv);
+    counting = false;
+
+    CHECK(result == 0);
+    CHECK(server.TryAccept());
+    CHECK(positions > COUNTED_TICKS);
+    CHECK(statuses > 0);
+    CHECK(counted == 0);
+    fmt::print("{}: {} allocations in {} ticks, {} positions and {} statuses sent\n", backpressure, counted, COUNTED_TICKS, positions, statuses);
+}
+
+int main() {
+    test_steady_ticks("queue");
+    test_steady_ticks("latest");
+    return test_result();
+}
@@ -0,0 +1,284 @@
+// BackpressureMode::LatestPoseWins against a server that stops reading for a while, then catches up slowly.
+// trackers and status changes have to arrive complete and in order, positions only have to be recent.
+#include <initializer_list>
+#include <map>
+#include <vector>
+#include "fake_server.hpp"
+#include "test_util.hpp"
+
+static constexpr int TRACKERS = 8;
+
+static messages::ProtobufMessage tracker_added(int32_t id) {
+    messages::ProtobufMessage msg;
+    msg.mutable_tracker_added()->set_tracker_id(id);
+    msg.mutable_tracker_added()->set_tracker_name(fmt::format("tracker {}", id));
+    return msg;
+}
+
+static messages::ProtobufMessage tracker_status(int32_t id, messages::TrackerStatus_Status status) {
+    messages::ProtobufMessage msg;
+    msg.mutable_tracker_status()->set_tracker_id(id);
+    msg.mutable_tracker_status()->set_status(status);
+    return msg;
+}
+
+// the tick a position was sent on goes in x, so the server can tell how stale it is
+static messages::ProtobufMessage position(int32_t id, int tick) {
+    messages::ProtobufMessage msg;
+    msg.mutable_position()->set_tracker_id(id);
+    msg.mutable_position()->set_x(static_cast<float>(tick));
+    msg.mutable_position()->set_y(1.0f);
+    msg.mutable_position()->set_z(1.0f);
+    msg.mutable_position()->set_qw(1.0f);
+    return msg;
+}
+
+// the handshake the bridge starts on every connection isn't what these tests are about
+static std::vector<messages::ProtobufMessage> without_ping_pong(const std::vector<messages::ProtobufMessage> &received) {
+    std::vector<messages::ProtobufMessage> result;
+    for (const auto &msg: received) {
+        if (!msg.has_ping_pong()) result.push_back(msg);
+    }
+    return result;
+}
+
+static std::unique_ptr<SlimeVRBridge> latest_pose_wins(size_t queue_size) {
+    BridgeConfig config;
+    config.backpressure = BackpressureMode::LatestPoseWins;
+    config.queue_size = queue_size;
+    return SlimeVRBridge::factory(config);
+}
+
+// everything but positions has to arrive exactly once, in the order it was sent, and no tracker's position can
+// come before the TrackerAdded for it. positions for a tracker only ever get newer.
+static void check_order(const std::vector<messages::ProtobufMessage> &sent_control, const std::vector<messages::ProtobufMessage> &received) {
+    std::vector<std::string> expected;
+    for (const auto &msg: sent_control) {
+        expected.push_back(msg.SerializeAsString());
+    }
+    std::vector<std::string> control;
+    std::map<int32_t, bool> added;
+    std::map<int32_t, float> last_x;
+    for (const auto &msg: received) {
+        if (msg.has_tracker_added()) {
+            added[msg.tracker_added().tracker_id()] = true;
+        }
+        if (msg.has_position()) {
+            const int32_t id = msg.position().tracker_id();
+            CHECK(added[id]);
+            CHECK(last_x.count(id) == 0 || last_x[id] < msg.position().x());
+            last_x[id] = msg.position().x();
+        } else if (msg.has_position_batch()) {
+            for (const auto &position: msg.position_batch().positions()) {
+                CHECK(added[position.tracker_id()]);
+                CHECK(last_x.count(position.tracker_id()) == 0 || last_x[position.tracker_id()] < position.x());
+                last_x[position.tracker_id()] = position.x();
+            }
+        } else if (!msg.has_ping_pong()) {
+            control.push_back(msg.SerializeAsString());
+        }
+    }
+    CHECK(control == expected);
+}
+
+static void test_slow_server() {
+    FakeServer server;
+    auto bridge = latest_pose_wins(16 * 1024);
+    CHECK(server.Accept(*bridge));
+
+    std::vector<messages::ProtobufMessage> sent_control;
+    std::vector<messages::ProtobufMessage> received;
+    for (int32_t id = 0; id < TRACKERS; ++id) {
+        sent_control.push_back(tracker_added(id));
+        bridge->sendMessage(sent_control.back());
+    }
+
+    // the server doesn't read anything for 500 ticks, then reads 512 bytes a tick
+    constexpr int STALLED_TICKS = 500;
+    constexpr int TICKS = 2000;
+    int statuses = 0;
+    size_t max_pending_while_stalled = 0;
+    int last_tick = 0;
+    for (int tick = 1; tick <= TICKS; ++tick) {
+        bridge->runFrame();
+        if (tick % 100 == 0) {
+            sent_control.push_back(tracker_status(tick / 100 % TRACKERS, tick % 200 ? messages::TrackerStatus_Status_OCCLUDED : messages::TrackerStatus_Status_OK));
+            bridge->sendMessage(sent_control.back());
+            statuses += 1;
+        }
+        for (int32_t id = 0; id < TRACKERS; ++id) {
+            messages::ProtobufMessage msg = position(id, tick);
+            bridge->sendMessage(msg);
+        }
+        bridge->flush();
+        last_tick = tick;
+
+        if (tick <= STALLED_TICKS) {
+            max_pending_while_stalled = bridge->getBatchStats().max_pending;
+        } else {
+            server.Receive(received, 512);
+        }
+    }
+    server.Drain(*bridge, received);
+
+    const BatchStats &stats = bridge->getBatchStats();
+    // bounded memory: at most one position per tracker waits, plus the messages that can't be dropped
+    CHECK(max_pending_while_stalled <= 2 * TRACKERS + STALLED_TICKS / 100);
+    CHECK(stats.max_pending <= 2 * TRACKERS + TICKS / 100);
+    CHECK(stats.coalesced_positions > 0);
+    CHECK(bridge->getQueueStats().dropped_writes == 0);
+    fmt::print("slow server: at most {} messages pending, {} positions replaced\n", stats.max_pending, stats.coalesced_positions);
+
+    check_order(sent_control, received);
+
+    // bounded staleness: once the server catches up, the last position of every tracker is the newest one sent
+    std::map<int32_t, float> latest;
+    size_t positions = 0;
+    for (const auto &msg: received) {
+        if (msg.has_position()) {
+            latest[msg.position().tracker_id()] = msg.position().x();
+            positions += 1;
+        }
+    }
+    for (int32_t id = 0; id < TRACKERS; ++id) {
+        CHECK(latest[id] == static_cast<float>(last_tick));
+    }
+    CHECK(positions < static_cast<size_t>(TICKS * TRACKERS));
+    CHECK(statuses > 0);
+}
+
+// a message bigger than MAX_BATCH_SIZE can't be batched with anything, it has to go on its own
+static void test_oversized_message() {
+    FakeServer server;
+    auto bridge = latest_pose_wins(256 * 1024);
+    CHECK(server.Accept(*bridge));
+
+    messages::ProtobufMessage big;
+    for (int32_t id = 0; id < 5000; ++id) {
+        *big.mutable_position_batch()->add_positions() = position(id, 1).position();
+    }
+    CHECK(big.ByteSizeLong() > 64 * 1024);
+
+    std::vector<messages::ProtobufMessage> sent_control = {tracker_added(1), tracker_added(2)};
+    bridge->sendMessage(sent_control[0]);
+    bridge->sendMessage(big);
+    bridge->sendMessage(sent_control[1]);
+    bridge->flush();
+
+    std::vector<messages::ProtobufMessage> all;
+    server.Drain(*bridge, all);
+    const auto received = without_ping_pong(all);
+    CHECK(received.size() == 3);
+    CHECK(received.size() == 3 && received[1].position_batch().positions_size() == 5000);
+    CHECK(received.size() == 3 && received[2].has_tracker_added());
+}
+
+// one that doesn't fit in the send queue at all is dropped, instead of holding up everything after it forever
+static void test_message_bigger_than_queue() {
+    FakeServer server;
+    auto bridge = latest_pose_wins(16 * 1024);
+    CHECK(server.Accept(*bridge));
+
+    messages::ProtobufMessage big;
+    for (int32_t id = 0; id < 1000; ++id) {
+        *big.mutable_position_batch()->add_positions() = position(id, 1).position();
+    }
+    CHECK(big.ByteSizeLong() > 16 * 1024);
+
+    messages::ProtobufMessage added = tracker_added(1);
+    bridge->sendMessage(big);
+    bridge->sendMessage(added);
+    bridge->flush();
+
+    std::vector<messages::ProtobufMessage> all;
+    server.Drain(*bridge, all);
+    const auto received = without_ping_pong(all);
+    CHECK(received.size() == 1);
+    CHECK(received.size() == 1 && received[0].has_tracker_added());
+}
+
+// a pending batch can't take the positions of trackers added after it was queued, they'd arrive before their TrackerAdded
+static void test_batch_after_tracker_added() {
+    FakeServer server;
+    auto bridge = latest_pose_wins(16 * 1024);
+    CHECK(server.Accept(*bridge));
+
+    // nothing is flushed until the end, so each batch finds the last one still pending, with a TrackerAdded after it
+    constexpr int TICKS = 4;
+    std::vector<messages::ProtobufMessage> sent_control;
+    for (int tick = 1; tick <= TICKS; ++tick) {
+        sent_control.push_back(tracker_added(tick));
+        bridge->sendMessage(sent_control.back());
+        messages::ProtobufMessage batch;
+        for (int32_t id = 1; id <= tick; ++id) {
+            *batch.mutable_position_batch()->add_positions() = position(id, tick).position();
+        }
+        bridge->sendMessage(batch);
+    }
+    bridge->flush();
+
+    std::vector<messages::ProtobufMessage> received;
+    server.Drain(*bridge, received);
+    check_order(sent_control, received);
+
+    // and every tracker's newest position still gets there
+    std::map<int32_t, float> latest;
+    for (const auto &msg: received) {
+        for (const auto &position: msg.position_batch().positions()) {
+            latest[position.tracker_id()] = position.x();
+        }
+    }
+    CHECK(latest.size() == TICKS);
+    for (const auto &[id, x]: latest) {
+        CHECK(x == static_cast<float>(TICKS));
+    }
+}
+
+static messages::ProtobufMessage batch_of(std::initializer_list<std::pair<int32_t, int>> positions) {
+    messages::ProtobufMessage msg;
+    for (const auto &[id, tick]: positions) {
+        *msg.mutable_position_batch()->add_positions() = position(id, tick).position();
+    }
+    return msg;
+}
+
+// the exact frames for the case above: the new tracker's position isn't merged into the batch queued before its
+// TrackerAdded, it goes in a batch of its own after it. the next tick's batch merges into that one, the last queued,
+// old tracker and all.
+static void test_new_tracker_gets_later_batch() {
+    FakeServer server;
+    auto bridge = latest_pose_wins(16 * 1024);
+    CHECK(server.Accept(*bridge));
+
+    std::vector<messages::ProtobufMessage> sent = {
+        tracker_added(1), batch_of({{1, 1}}),
+        tracker_added(2), batch_of({{1, 2}, {2, 2}}),
+        batch_of({{1, 3}, {2, 3}}),
+    };
+    for (auto &msg: sent) {
+        bridge->sendMessage(msg);
+    }
+    bridge->flush();
+
+    std::vector<messages::ProtobufMessage> received;
+    server.Drain(*bridge, received);
+    received = without_ping_pong(received);
+
+    const std::vector<messages::ProtobufMessage> expected = {
+        tracker_added(1), batch_of({{1, 2}}),
+        tracker_added(2), batch_of({{2, 3}, {1, 3}}),
+    };
+    CHECK(received.size() == expected.size());
+    for (size_t i = 0; i < std::min(received.size(), expected.size()); ++i) {
+        CHECK(received[i].SerializeAsString() == expected[i].SerializeAsString());
+    }
+}
+
+int main() {
+    test_slow_server();
+    test_oversized_message();
+    test_message_bigger_than_queue();
+    test_batch_after_tracker_added();
+    test_new_tracker_gets_later_batch();
+    return test_result();
+}
@@ -0,0 +1,135 @@
+// devices are only re-detected when OpenVR says something changed, and on a slow sweep.
+// the feeder's main loop runs against the fake OpenVR runtime, which counts what it was asked for.
+#include "run_feeder.hpp"
+
+// string properties main.cpp caches for each device, each fetch asks for the size first
+static constexpr uint64_t FETCHES_PER_DEVICE = 8 * 2;
+// the sweep checks every device's serial against the cached one
+static constexpr uint64_t SWEEP_FETCHES_PER_DEVICE = 2;
+
+// two trackers with roles, so detection settles straight away
+static void two_trackers() {
+    fake_openvr::Reset();
+    auto &runtime = fake_openvr::GetRuntime();
+    runtime.AddDevice(1, TrackedDeviceClass_GenericTracker);
+    runtime.AddDevice(2, TrackedDeviceClass_GenericTracker);
+    runtime.pose_bindings["/actions/main/in/waist"] = 1;
+    runtime.pose_bindings["/actions/main/in/left_foot"] = 2;
+}
+
+static void test_steady_ticks() {
+    two_trackers();
+    fake_openvr::Calls settled;
+    fake_openvr::Calls last;
+    uint64_t fetches_1 = 0;
+    uint64_t fetches_2 = 0;
+    constexpr uint64_t START = 10;
+    constexpr uint64_t TICKS = SWEEP_TICKS + 50;
+    run_feeder(TICKS, [&](fake_openvr::Runtime &runtime, uint64_t tick) {
+        if (tick == START) {
+            settled = runtime.calls;
+            fetches_1 = runtime.devices[1].string_fetches;
+            fetches_2 = runtime.devices[2].string_fetches;
+        }
+        if (tick == TICKS) last = runtime.calls;
+    });
+
+    // the first detection found both trackers
+    CHECK(fetches_1 == FETCHES_PER_DEVICE);
+    CHECK(fetches_2 == FETCHES_PER_DEVICE);
+
+    // after that only the sweep enumerates devices, and their properties come from the cache but for the serial
+    const uint64_t sweeps = (TICKS - START) / SWEEP_TICKS + 1;
+    CHECK(last.device_poses - settled.device_poses == TICKS - START);
+    CHECK(last.sorted_device_indices - settled.sorted_device_indices <= 2 * sweeps);
+    CHECK(last.pose_actions - settled.pose_actions <= 12 * sweeps);
+    CHECK(last.string_properties - settled.string_properties <= 2 * SWEEP_FETCHES_PER_DEVICE * sweeps);
+}
+
+// a new device is picked up on the tick its event arrives, without fetching anything for the others again
+static void test_activated_device() {
+    two_trackers();
+    fake_openvr::Calls before;
+    uint64_t fetches_1 = 0;
+    run_feeder(50, [&](fake_openvr::Runtime &runtime, uint64_t tick) {
+        if (tick == 20) {
+            before = runtime.calls;
+            fetches_1 = runtime.devices[1].string_fetches;
+            runtime.AddDevice(3, TrackedDeviceClass_GenericTracker);
+            runtime.pose_bindings["/actions/main/in/right_foot"] = 3;
+            runtime.PushEvent(VREvent_TrackedDeviceActivated, 3);
+        }
+        if (tick == 21) {
+            CHECK(runtime.calls.sorted_device_indices - before.sorted_device_indices == 2);
+            CHECK(runtime.devices[3].string_fetches == FETCHES_PER_DEVICE);
+            CHECK(runtime.devices[1].string_fetches == fetches_1);
+        }
+
+        // the same index can be a different device once it's activated again, nothing cached for it is kept
+        if (tick == 30) {
+            fetches_1 = runtime.devices[1].string_fetches;
+            runtime.PushEvent(VREvent_TrackedDeviceActivated, 1);
+        }
+        if (tick == 31) {
+            CHECK(runtime.devices[1].string_fetches - fetches_1 == FETCHES_PER_DEVICE);
+        }
+    });
+}
+
+// a device replaced at the same index without any event for it, the sweep finds the new serial and fetches the rest again
+static void test_replaced_without_event() {
+    two_trackers();
+    uint64_t fetches_1 = 0;
+    uint64_t fetches_2 = 0;
+    constexpr uint64_t TICKS = 25 + SWEEP_TICKS;
+    run_feeder(TICKS, [&](fake_openvr::Runtime &runtime, uint64_t tick) {
+        if (tick == 20) {
+            fetches_1 = runtime.devices[1].string_fetches;
+            fetches_2 = runtime.devices[2].string_fetches;
+            runtime.devices[1].strings[Prop_SerialNumber_String] = "FAKE-REPLACEMENT";
+        }
+        if (tick == 21) {
+            CHECK(runtime.devices[1].string_fetches == fetches_1);
+        }
+    });
+
+    // one sweep since tick 20
+    auto &runtime = fake_openvr::GetRuntime();
+    CHECK(runtime.devices[1].string_fetches - fetches_1 == SWEEP_FETCHES_PER_DEVICE + FETCHES_PER_DEVICE);
+    CHECK(runtime.devices[2].string_fetches - fetches_2 == SWEEP_FETCHES_PER_DEVICE);
+}
+
+// property changes only matter for the properties that were cached
+static void test_property_changed() {
+    two_trackers();
+    fake_openvr::Calls before;
+    uint64_t fetches_1 = 0;
+    run_feeder(50, [&](fake_openvr::Runtime &runtime, uint64_t tick) {
+        if (tick == 20) {
+            before = runtime.calls;
+            runtime.PushEvent(VREvent_PropertyChanged, 1, Prop_DeviceBatteryPercentage_Float);
+        }
+        if (tick == 21) {
+            CHECK(runtime.calls.sorted_device_indices == before.sorted_device_indices);
+            CHECK(runtime.calls.string_properties == before.string_properties);
+        }
+
+        if (tick == 30) {
+            before = runtime.calls;
+            fetches_1 = runtime.devices[1].string_fetches;
+            runtime.PushEvent(VREvent_PropertyChanged, 1, Prop_RenderModelName_String);
+        }
+        if (tick == 31) {
+            CHECK(runtime.calls.sorted_device_indices - before.sorted_device_indices == 2);
+            CHECK(runtime.devices[1].string_fetches - fetches_1 == 2);
+        }
+    });
+}
+
+int main() {
+    test_steady_ticks();
+    test_activated_device();
+    test_replaced_without_event();
+    test_property_changed();
+    return test_result();
+}
@@ -0,0 +1,288 @@
+#include "fake_openvr.hpp"
+#include <cstring>
+
+namespace fake_openvr {
+
+static Runtime runtime;
+// true while main.cpp is polling this tick's events
+static bool polling = false;
+
+Runtime &GetRuntime() {
+    return runtime;
+}
+
+void Reset() {
+    runtime = Runtime();
+    polling = false;
+}
+
+Device &Runtime::AddDevice(vr::TrackedDeviceIndex_t index, vr::ETrackedDeviceClass device_class) {
+    Device &device = devices[index];
+    device = Device();
+    device.device_class = device_class;
+
+    const std::string serial = "FAKE-" + std::to_string(index);
+    device.strings[vr::Prop_TrackingSystemName_String] = "fake";
+    device.strings[vr::Prop_ModelNumber_String] = "Fake Tracker";
+    device.strings[vr::Prop_SerialNumber_String] = serial;
+    device.strings[vr::Prop_RenderModelName_String] = "fake_tracker";
+    device.strings[vr::Prop_ManufacturerName_String] = "Fake";
+    device.strings[vr::Prop_RegisteredDeviceType_String] = "fake/" + serial;
+    device.strings[vr::Prop_InputProfilePath_String] = "{fake}/input/fake_tracker_profile.json";
+    device.strings[vr::Prop_ControllerType_String] = "fake_tracker";
+
+    // identity rotation, a metre above the floor and index metres to the side
+    vr::HmdMatrix34_t &m = device.pose.mDeviceToAbsoluteTracking;
+    m = {{{1.0f, 0.0f, 0.0f, (float)index}, {0.0f, 1.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 1.0f, 0.0f}}};
+    device.pose.eTrackingResult = vr::TrackingResult_Running_OK;
+    device.pose.bPoseIsValid = true;
+    device.pose.bDeviceIsConnected = true;
+    return device;
+}
+
+void Runtime::PushEvent(uint32_t event_type, vr::TrackedDeviceIndex_t index, vr::ETrackedDeviceProperty prop) {
+    vr::VREvent_t event = {};
+    event.eventType = event_type;
+    event.trackedDeviceIndex = index;
+    event.data.property.prop = prop;
+    events.push_back(event);
+}
+
+// action handles are handed out in the order they're asked for, origins are the device index + 1
+static std::map<std::string, vr::VRActionHandle_t> action_handles;
+static std::map<vr::VRActionHandle_t, std::string> action_names;
+
+static bool IsDevice(vr::TrackedDeviceIndex_t index) {
+    return index < vr::k_unMaxTrackedDeviceCount && runtime.devices[index].device_class != vr::TrackedDeviceClass_Invalid;
+}
+
+class FakeSystem : public vr::IVRSystem {
+public:
+    void GetDeviceToAbsoluteTrackingPose(vr::ETrackingUniverseOrigin, float predicted_seconds, vr::TrackedDevicePose_t *poses, uint32_t count) override {
+        runtime.calls.device_poses += 1;
+        runtime.frame += 1;
+        runtime.predicted_seconds = predicted_seconds;
+        for (uint32_t index = 0; index < count && index < vr::k_unMaxTrackedDeviceCount; ++index) {
+            poses[index] = IsDevice(index) ? runtime.devices[index].pose : vr::TrackedDevicePose_t{};
+            // like SteamVR, a predicted pose carries on along the device's velocity
+            for (int axis = 0; axis < 3; ++axis) {
+                poses[index].mDeviceToAbsoluteTracking.m[axis][3] += poses[index].vVelocity.v[axis] * predicted_seconds;
+            }
+        }
+    }
+
+    uint32_t GetSortedTrackedDeviceIndicesOfClass(vr::ETrackedDeviceClass device_class, vr::TrackedDeviceIndex_t *indices, uint32_t capacity, vr::TrackedDeviceIndex_t) override {
+        runtime.calls.sorted_device_indices += 1;
+        uint32_t count = 0;
+        for (vr::TrackedDeviceIndex_t index = 0; index < vr::k_unMaxTrackedDeviceCount; ++index) {
+            if (runtime.devices[index].device_class == device_class) {
+                if (count < capacity) indices[count] = index;
+                count += 1;
+            }
+        }
+        return count;
+    }
+
+    vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t index) override {
+        return index < vr::k_unMaxTrackedDeviceCount ? runtime.devices[index].device_class : vr::TrackedDeviceClass_Invalid;
+    }
+
+    uint64_t GetUint64TrackedDeviceProperty(vr::TrackedDeviceIndex_t index, vr::ETrackedDeviceProperty prop, vr::ETrackedPropertyError *error) override {
+        if (prop == vr::Prop_CurrentUniverseId_Uint64 && index == 0) {
+            runtime.calls.universe_ids += 1;
+            if (error) *error = vr::TrackedProp_Success;
+            return runtime.universe_id;
+        }
+        if (error) *error = vr::TrackedProp_UnknownProperty;
+        return 0;
+    }
+
+    // like the real one, the returned size includes the null terminator, and is returned even if the buffer is too small
+    uint32_t GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t index, vr::ETrackedDeviceProperty prop, char *value, uint32_t size, vr::ETrackedPropertyError *error) override {
+        runtime.calls.string_properties += 1;
+        if (!IsDevice(index)) {
+            if (error) *error = vr::TrackedProp_InvalidDevice;
+            return 0;
+        }
+        Device &device = runtime.devices[index];
+        device.string_fetches += 1;
+        auto it = device.strings.find(prop);
+        if (it == device.strings.end()) {
+            if (error) *error = vr::TrackedProp_UnknownProperty;
+            return 0;
+        }
+        const uint32_t needed = (uint32_t)it->second.size() + 1;
+        if (size < needed) {
+            if (error) *error = vr::TrackedProp_BufferTooSmall;
+            return needed;
+        }
+        std::memcpy(value, it->second.c_str(), needed);
+        if (error) *error = vr::TrackedProp_Success;
+        return needed;
+    }
+
+    const char *GetPropErrorNameFromEnum(vr::ETrackedPropertyError error) override {
+        switch (error) {
+        case vr::TrackedProp_Success: return "TrackedProp_Success";
+        case vr::TrackedProp_BufferTooSmall: return "TrackedProp_BufferTooSmall";
+        case vr::TrackedProp_UnknownProperty: return "TrackedProp_UnknownProperty";
+        case vr::TrackedProp_InvalidDevice: return "TrackedProp_InvalidDevice";
+        default: return "TrackedProp_Unknown";
+        }
+    }
+
+    bool PollNextEvent(vr::VREvent_t *event, uint32_t) override {
+        // main.cpp polls until there's nothing left once per tick, so the first poll after that starts a tick
+        if (!polling) {
+            polling = true;
+            if (runtime.on_tick) runtime.on_tick(runtime.calls.device_poses);
+        }
+        if (runtime.events.empty()) {
+            polling = false;
+            return false;
+        }
+        *event = runtime.events.front();
+        runtime.events.pop_front();
+        return true;
+    }
+
+    const char *GetEventTypeNameFromEnum(vr::EVREventType) override {
+        return "VREvent_Fake";
+    }
+
+    bool GetTimeSinceLastVsync(float *seconds, uint64_t *frame) override {
+        *seconds = 0.0f;
+        *frame = runtime.frame / runtime.ticks_per_frame;
+        return true;
+    }
+};
+
+class FakeInput : public vr::IVRInput {
+public:
+    vr::EVRInputError SetActionManifestPath(const char *) override {
+        return vr::VRInputError_None;
+    }
+
+    vr::EVRInputError GetActionSetHandle(const char *, vr::VRActionSetHandle_t *handle) override {
+        *handle = 1;
+        return vr::VRInputError_None;
+    }
+
+    vr::EVRInputError GetActionHandle(const char *name, vr::VRActionHandle_t *handle) override {
+        auto it = action_handles.find(name);
+        if (it == action_handles.end()) {
+            it = action_handles.emplace(name, action_handles.size() + 1).first;
+            action_names[it->second] = name;
+        }
+        *handle = it->second;
+        return vr::VRInputError_None;
+    }
+
+    vr::EVRInputError UpdateActionState(vr::VRActiveActionSet_t *, uint32_t, uint32_t) override {
+        return vr::VRInputError_None;
+    }
+
+    vr::EVRInputError GetDigitalActionData(vr::VRActionHandle_t, vr::InputDigitalActionData_t *data, uint32_t, vr::VRInputValueHandle_t) override {
+        *data = {};
+        return vr::VRInputError_None;
+    }
+
+    vr::EVRInputError GetPoseActionDataRelativeToNow(vr::VRActionHandle_t action, vr::ETrackingUniverseOrigin, float, vr::InputPoseActionData_t *data, uint32_t, vr::VRInputValueHandle_t) override {
+        runtime.calls.pose_actions += 1;
+        *data = {};
+        auto name = action_names.find(action);
+        if (name == action_names.end()) {
+            return vr::VRInputError_InvalidHandle;
+        }
+        auto binding = runtime.pose_bindings.find(name->second);
+        if (binding != runtime.pose_bindings.end() && IsDevice(binding->second)) {
+            data->bActive = true;
+            data->activeOrigin = binding->second + 1;
+            data->pose = runtime.devices[binding->second].pose;
+        }
+        return vr::VRInputError_None;
+    }
+
+    vr::EVRInputError GetOriginLocalizedName(vr::VRInputValueHandle_t origin, char *name, uint32_t size, int32_t) override {
+        const std::string value = "Fake Tracker " + std::to_string(origin - 1);
+        if (size < value.size() + 1) {
+            return vr::VRInputError_BufferTooSmall;
+        }
+        std::memcpy(name, value.c_str(), value.size() + 1);
+        return vr::VRInputError_None;
+    }
+
+    vr::EVRInputError GetOriginTrackedDeviceInfo(vr::VRInputValueHandle_t origin, vr::InputOriginInfo_t *info, uint32_t) override {
+        runtime.calls.origin_infos += 1;
+        *info = {};
+        if (origin == vr::k_ulInvalidInputValueHandle || !IsDevice((vr::TrackedDeviceIndex_t)(origin - 1))) {
+            return vr::VRInputError_InvalidHandle;
+        }
+        info->devicePath = origin;
+        info->trackedDeviceIndex = (vr::TrackedDeviceIndex_t)(origin - 1);
+        return vr::VRInputError_None;
+    }
+};
+
+class FakeChaperoneSetup : public vr::IVRChaperoneSetup {
+public:
+    bool ExportLiveToBuffer(char *buffer, uint32_t *length) override {
+        runtime.calls.chaperone_exports += 1;
+        const uint32_t needed = (uint32_t)runtime.chaperone_json.size() + 1;
+        if (!buffer || *length < needed) {
+            *length = needed;
+            return false;
+        }
+        std::memcpy(buffer, runtime.chaperone_json.c_str(), needed);
+        *length = needed;
+        return true;
+    }
+};
+
+class FakeOverlay : public vr::IVROverlay {
+public:
+    bool IsDashboardVisible() override {
+        return runtime.dashboard_visible;
+    }
+};
+
+class FakeApplications : public vr::IVRApplications {
+public:
+    bool IsApplicationInstalled(const char *) override { return false; }
+    vr::EVRApplicationError AddApplicationManifest(const char *, bool) override { return vr::VRApplicationError_None; }
+    vr::EVRApplicationError RemoveApplicationManifest(const char *) override { return vr::VRApplicationError_None; }
+    vr::EVRApplicationError SetApplicationAutoLaunch(const char *, bool) override { return vr::VRApplicationError_None; }
+    bool GetApplicationAutoLaunch(const char *) override { return false; }
+    const char *GetApplicationsErrorNameFromEnum(vr::EVRApplicationError) override { return "VRApplicationError_Fake"; }
+};
+
+static FakeSystem fake_system;
+static FakeInput fake_input;
+static FakeChaperoneSetup fake_chaperone_setup;
+static FakeOverlay fake_overlay;
+static vr::IVRCompositor fake_compositor;
+static FakeApplications fake_applications;
+
+} // namespace fake_openvr
+
+namespace vr {
+
+IVRSystem *VRSystem() { return &fake_openvr::fake_system; }
+IVRInput *VRInput() { return &fake_openvr::fake_input; }
+IVRChaperoneSetup *VRChaperoneSetup() { return &fake_openvr::fake_chaperone_setup; }
+IVROverlay *VROverlay() { return &fake_openvr::fake_overlay; }
+IVRCompositor *VRCompositor() { return &fake_openvr::fake_compositor; }
+IVRApplications *VRApplications() { return &fake_openvr::fake_applications; }
+
+IVRSystem *VR_Init(EVRInitError *error, EVRApplicationType, const char *) {
+    *error = VRInitError_None;
+    return VRSystem();
+}
+
+void VR_Shutdown() {}
+
+const char *VR_GetVRInitErrorAsEnglishDescription(EVRInitError error) {
+    return error == VRInitError_None ? "No Error (0)" : "Fake Error";
+}
+
+} // namespace vr
@@ -0,0 +1,63 @@
+#pragma once
+// what the fake OpenVR runtime reports, and how often it was asked.
+// everything is read and written from the thread main.cpp runs on, so there's no locking.
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <openvr.h>
+
+namespace fake_openvr {
+
+struct Device {
+    vr::ETrackedDeviceClass device_class = vr::TrackedDeviceClass_Invalid;
+    std::map<vr::ETrackedDeviceProperty, std::string> strings;
+    vr::TrackedDevicePose_t pose = {};
+    // GetStringTrackedDeviceProperty calls for this device, including the ones only asking for the size
+    uint64_t string_fetches = 0;
+};
+
+// OpenVR calls that go over IPC to vrserver, the ones worth counting
+struct Calls {
+    uint64_t sorted_device_indices = 0;
+    uint64_t string_properties = 0;
+    uint64_t device_poses = 0; // once per tick, ticks are counted by it
+    uint64_t pose_actions = 0;
+    uint64_t origin_infos = 0;
+    uint64_t chaperone_exports = 0;
+    uint64_t universe_ids = 0;
+};
+
+struct Runtime {
+    Device devices[vr::k_unMaxTrackedDeviceCount];
+    // pose action name -> device it's bound to
+    std::map<std::string, vr::TrackedDeviceIndex_t> pose_bindings;
+    std::deque<vr::VREvent_t> events;
+    uint64_t universe_id = 0;
+    // what ExportLiveToBuffer hands out
+    std::string chaperone_json = R"({"jsonid": "chaperone_info", "universes": [], "version": 5})";
+    bool dashboard_visible = false;
+    uint64_t frame = 0;
+    // ticks each compositor frame lasts, GetTimeSinceLastVsync reports the same frame for all of them
+    uint64_t ticks_per_frame = 1;
+    // how far ahead the last GetDeviceToAbsoluteTrackingPose asked for
+    float predicted_seconds = 0.0f;
+    Calls calls;
+
+    // called before each tick's events are polled, with the number of ticks run so far
+    std::function<void(uint64_t)> on_tick;
+
+    // makes a tracker of class device_class with every string property main.cpp looks at filled in, and a valid pose
+    Device &AddDevice(vr::TrackedDeviceIndex_t index, vr::ETrackedDeviceClass device_class);
+    void PushEvent(uint32_t event_type, vr::TrackedDeviceIndex_t index = vr::k_unTrackedDeviceIndexInvalid, vr::ETrackedDeviceProperty prop = vr::Prop_Invalid);
+    // main.cpp returns once it sees this
+    void Quit() { PushEvent(vr::VREvent_Quit); }
+};
+
+// the one runtime VRSystem() and friends answer from
+Runtime &GetRuntime();
+// forget every device, binding, event and counter
+void Reset();
+
+} // namespace fake_openvr
@@ -0,0 +1,247 @@
+#pragma once
+// stands in for the real openvr.h in tests, so main.cpp can run without SteamVR.
+// only the part of the API the feeder uses is here, with the same names and values as the real thing.
+// fake_openvr.hpp has the knobs to control what it reports.
+#include <cstddef>
+#include <cstdint>
+
+namespace vr {
+
+typedef uint32_t TrackedDeviceIndex_t;
+typedef uint64_t VRActionHandle_t;
+typedef uint64_t VRActionSetHandle_t;
+typedef uint64_t VRInputValueHandle_t;
+
+static const uint32_t k_unMaxTrackedDeviceCount = 64;
+static const uint32_t k_unTrackedDeviceIndexInvalid = 0xFFFFFFFF;
+static const uint64_t k_ulInvalidInputValueHandle = 0;
+static const uint64_t k_ulInvalidActionSetHandle = 0;
+static const uint64_t k_ulInvalidActionHandle = 0;
+
+struct HmdMatrix34_t {
+    float m[3][4];
+};
+
+struct HmdQuaternion_t {
+    double w, x, y, z;
+};
+
+struct HmdQuaternionf_t {
+    float w, x, y, z;
+};
+
+struct HmdVector3_t {
+    float v[3];
+};
+
+enum ETrackingResult {
+    TrackingResult_Uninitialized = 1,
+    TrackingResult_Calibrating_InProgress = 100,
+    TrackingResult_Calibrating_OutOfRange = 101,
+    TrackingResult_Running_OK = 200,
+    TrackingResult_Running_OutOfRange = 201,
+    TrackingResult_Fallback_RotationOnly = 300,
+};
+
+struct TrackedDevicePose_t {
+    HmdMatrix34_t mDeviceToAbsoluteTracking;
+    HmdVector3_t vVelocity;
+    HmdVector3_t vAngularVelocity;
+    ETrackingResult eTrackingResult;
+    bool bPoseIsValid;
+    bool bDeviceIsConnected;
+};
+
+enum ETrackingUniverseOrigin {
+    TrackingUniverseSeated = 0,
+    TrackingUniverseStanding = 1,
+    TrackingUniverseRawAndUncalibrated = 2,
+};
+
+enum ETrackedDeviceClass {
+    TrackedDeviceClass_Invalid = 0,
+    TrackedDeviceClass_HMD = 1,
+    TrackedDeviceClass_Controller = 2,
+    TrackedDeviceClass_GenericTracker = 3,
+    TrackedDeviceClass_TrackingReference = 4,
+    TrackedDeviceClass_DisplayRedirect = 5,
+};
+
+enum ETrackedDeviceProperty {
+    Prop_Invalid = 0,
+    Prop_TrackingSystemName_String = 1000,
+    Prop_ModelNumber_String = 1001,
+    Prop_SerialNumber_String = 1002,
+    Prop_RenderModelName_String = 1003,
+    Prop_ManufacturerName_String = 1005,
+    Prop_DeviceBatteryPercentage_Float = 1012,
+    Prop_RegisteredDeviceType_String = 1036,
+    Prop_InputProfilePath_String = 1037,
+    Prop_CurrentUniverseId_Uint64 = 2004,
+    Prop_ControllerType_String = 7000,
+};
+
+enum ETrackedPropertyError {
+    TrackedProp_Success = 0,
+    TrackedProp_WrongDataType = 1,
+    TrackedProp_WrongDeviceClass = 2,
+    TrackedProp_BufferTooSmall = 3,
+    TrackedProp_UnknownProperty = 4,
+    TrackedProp_InvalidDevice = 5,
+};
+
+enum EVRInputError {
+    VRInputError_None = 0,
+    VRInputError_NameNotFound = 1,
+    VRInputError_InvalidHandle = 3,
+    VRInputError_NoData = 13,
+    VRInputError_BufferTooSmall = 14,
+};
+
+enum EVRInputStringBits {
+    VRInputString_Hand = 0x01,
+    VRInputString_ControllerType = 0x02,
+    VRInputString_InputSource = 0x04,
+    VRInputString_All = -1,
+};
+
+enum EVRInitError {
+    VRInitError_None = 0,
+    VRInitError_Init_HmdNotFound = 108,
+};
+
+enum EVRApplicationError {
+    VRApplicationError_None = 0,
+    VRApplicationError_UnknownApplication = 101,
+};
+
+enum EVRApplicationType {
+    VRApplication_Overlay = 2,
+    VRApplication_Utility = 4,
+};
+
+enum EVREventType {
+    VREvent_None = 0,
+    VREvent_TrackedDeviceActivated = 100,
+    VREvent_TrackedDeviceDeactivated = 101,
+    VREvent_TrackedDeviceUpdated = 102,
+    VREvent_TrackedDeviceRoleChanged = 108,
+    VREvent_PropertyChanged = 111,
+    VREvent_DashboardDeactivated = 504,
+    VREvent_Quit = 700,
+    VREvent_ChaperoneDataHasChanged = 800,
+    VREvent_ChaperoneUniverseHasChanged = 801,
+    VREvent_Input_BindingLoadSuccessful = 1705,
+    VREvent_Input_ActionManifestReloaded = 1708,
+    VREvent_Input_BindingsUpdated = 1713,
+};
+
+typedef uint64_t PropertyContainerHandle_t;
+
+struct VREvent_Property_t {
+    PropertyContainerHandle_t container;
+    ETrackedDeviceProperty prop;
+};
+
+union VREvent_Data_t {
+    VREvent_Property_t property;
+    char padding[48];
+};
+
+struct VREvent_t {
+    uint32_t eventType;
+    TrackedDeviceIndex_t trackedDeviceIndex;
+    float eventAgeSeconds;
+    VREvent_Data_t data;
+};
+
+struct VRActiveActionSet_t {
+    VRActionSetHandle_t ulActionSet;
+    VRInputValueHandle_t ulRestrictedToDevice;
+    VRActionSetHandle_t ulSecondaryActionSet;
+    uint32_t unPadding;
+    int32_t nPriority;
+};
+
+struct InputPoseActionData_t {
+    bool bActive;
+    VRInputValueHandle_t activeOrigin;
+    TrackedDevicePose_t pose;
+};
+
+struct InputDigitalActionData_t {
+    bool bActive;
+    VRInputValueHandle_t activeOrigin;
+    bool bState;
+    bool bChanged;
+    float fUpdateTime;
+};
+
+struct InputOriginInfo_t {
+    VRInputValueHandle_t devicePath;
+    TrackedDeviceIndex_t trackedDeviceIndex;
+    char rchRenderModelComponentName[128];
+};
+
+class IVRSystem {
+public:
+    virtual void GetDeviceToAbsoluteTrackingPose(ETrackingUniverseOrigin eOrigin, float fPredictedSecondsToPhotonsFromNow, TrackedDevicePose_t *pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) = 0;
+    virtual uint32_t GetSortedTrackedDeviceIndicesOfClass(ETrackedDeviceClass eTrackedDeviceClass, TrackedDeviceIndex_t *punTrackedDeviceIndexArray, uint32_t unTrackedDeviceIndexArrayCount, TrackedDeviceIndex_t unRelativeToTrackedDeviceIndex = 0) = 0;
+    virtual ETrackedDeviceClass GetTrackedDeviceClass(TrackedDeviceIndex_t unDeviceIndex) = 0;
+    virtual uint64_t GetUint64TrackedDeviceProperty(TrackedDeviceIndex_t unDeviceIndex, ETrackedDeviceProperty prop, ETrackedPropertyError *pError = nullptr) = 0;
+    virtual uint32_t GetStringTrackedDeviceProperty(TrackedDeviceIndex_t unDeviceIndex, ETrackedDeviceProperty prop, char *pchValue, uint32_t unBufferSize, ETrackedPropertyError *pError = nullptr) = 0;
+    virtual const char *GetPropErrorNameFromEnum(ETrackedPropertyError error) = 0;
+    virtual bool PollNextEvent(VREvent_t *pEvent, uint32_t uncbVREvent) = 0;
+    virtual const char *GetEventTypeNameFromEnum(EVREventType eType) = 0;
+    virtual bool GetTimeSinceLastVsync(float *pfSecondsSinceLastVsync, uint64_t *pulFrameCounter) = 0;
+};
+
+class IVRInput {
+public:
+    virtual EVRInputError SetActionManifestPath(const char *pchActionManifestPath) = 0;
+    virtual EVRInputError GetActionSetHandle(const char *pchActionSetName, VRActionSetHandle_t *pHandle) = 0;
+    virtual EVRInputError GetActionHandle(const char *pchActionName, VRActionHandle_t *pHandle) = 0;
+    virtual EVRInputError UpdateActionState(VRActiveActionSet_t *pSets, uint32_t unSizeOfVRSelectedActionSet_t, uint32_t unSetCount) = 0;
+    virtual EVRInputError GetDigitalActionData(VRActionHandle_t action, InputDigitalActionData_t *pActionData, uint32_t unActionDataSize, VRInputValueHandle_t ulRestrictToDevice) = 0;
+    virtual EVRInputError GetPoseActionDataRelativeToNow(VRActionHandle_t action, ETrackingUniverseOrigin eOrigin, float fPredictedSecondsFromNow, InputPoseActionData_t *pActionData, uint32_t unActionDataSize, VRInputValueHandle_t ulRestrictToDevice) = 0;
+    virtual EVRInputError GetOriginLocalizedName(VRInputValueHandle_t origin, char *pchNameArray, uint32_t unNameArraySize, int32_t unStringSectionsToInclude) = 0;
+    virtual EVRInputError GetOriginTrackedDeviceInfo(VRInputValueHandle_t origin, InputOriginInfo_t *pOriginInfo, uint32_t unOriginInfoSize) = 0;
+};
+
+class IVRChaperoneSetup {
+public:
+    virtual bool ExportLiveToBuffer(char *pBuffer, uint32_t *pnBufferLength) = 0;
+};
+
+class IVROverlay {
+public:
+    virtual bool IsDashboardVisible() = 0;
+};
+
+class IVRCompositor {
+public:
+    virtual ~IVRCompositor() = default;
+};
+
+class IVRApplications {
+public:
+    virtual bool IsApplicationInstalled(const char *pchAppKey) = 0;
+    virtual EVRApplicationError AddApplicationManifest(const char *pchApplicationManifestFullPath, bool bTemporary = false) = 0;
+    virtual EVRApplicationError RemoveApplicationManifest(const char *pchApplicationManifestFullPath) = 0;
+    virtual EVRApplicationError SetApplicationAutoLaunch(const char *pchAppKey, bool bAutoLaunch) = 0;
+    virtual bool GetApplicationAutoLaunch(const char *pchAppKey) = 0;
+    virtual const char *GetApplicationsErrorNameFromEnum(EVRApplicationError error) = 0;
+};
+
+IVRSystem *VRSystem();
+IVRInput *VRInput();
+IVRChaperoneSetup *VRChaperoneSetup();
+IVROverlay *VROverlay();
+IVRCompositor *VRCompositor();
+IVRApplications *VRApplications();
+
+IVRSystem *VR_Init(EVRInitError *peError, EVRApplicationType eApplicationType, const char *pStartupInfo = nullptr);
+void VR_Shutdown();
+const char *VR_GetVRInitErrorAsEnglishDescription(EVRInitError error);
+
+} // namespace vr
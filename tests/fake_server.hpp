@@ -0,0 +1,168 @@
+#pragma once
+#include <chrono>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <vector>
+#include <ProtobufMessages.pb.h>
+#include "bridge.hpp"
+#include "frame_decoder.hpp"
+#include "unix_sockets.hpp"
+#include "wire_format.hpp"
+
+// stands in for the SlimeVR server on a unix socket, in a directory of its own that the bridge finds through XDG_RUNTIME_DIR.
+// create it before the bridge, the bridge only looks up the socket paths once.
+class FakeServer {
+public:
+    explicit FakeServer(LocalSocketType type = LocalSocketType::Stream) : type(type) {
+        char dir_template[] = "/tmp/slimevr-test-XXXXXX";
+        if (!mkdtemp(dir_template)) throw std::runtime_error("can't create a directory for the socket");
+        dir = dir_template;
+        setenv("XDG_RUNTIME_DIR", dir.c_str(), 1);
+        acceptor.emplace(dir + "/SlimeVRInput", 1, type);
+    }
+    ~FakeServer() {
+        connection.reset();
+        acceptor.reset();
+        ::unlink((dir + "/SlimeVRInput").c_str());
+        ::rmdir(dir.c_str());
+    }
+    FakeServer(const FakeServer&) = delete;
+    FakeServer& operator=(const FakeServer&) = delete;
+
+    // runs the bridge until it has connected and been accepted, false if that takes too long
+    bool Accept(SlimeVRBridge &bridge) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (std::chrono::steady_clock::now() < deadline) {
+            bridge.runFrame();
+            bridge.flush();
+            if (TryAccept(10)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // accepts the bridge if it has connected within timeout_ms, for when something else is running the bridge
+    bool TryAccept(int timeout_ms = 0) {
+        if (connection) {
+            return true;
+        }
+        pollfd_t fd = {acceptor->GetDescriptor(), POLLIN, 0};
+        if (::poll(&fd, 1, timeout_ms) != 1) {
+            return false;
+        }
+        // the acceptor is non blocking, and only accepts once it's been told it's readable
+        acceptor->Update(event::Result(fd.revents));
+        connection = acceptor->Accept();
+        return connection.has_value();
+    }
+
+    // drop the connection, the bridge sees the server going away
+    void Disconnect() {
+        connection.reset();
+        decoder.Clear();
+    }
+
+    // the server stopping: the connection is dropped and the socket deleted, until Restart creates it again at the same path
+    void Stop() {
+        Disconnect();
+        acceptor.reset();
+        ::unlink((dir + "/SlimeVRInput").c_str());
+    }
+    void Restart() {
+        acceptor.emplace(dir + "/SlimeVRInput", 1, type);
+    }
+
+    void Send(const messages::ProtobufMessage &msg) {
+        std::string body = msg.SerializeAsString();
+        if (type == LocalSocketType::SeqPacket) {
+            // the packet is the frame, there's no size prefix
+            (void)SysCall(::send, connection->GetDescriptor(), body.data(), body.size(), MSG_NOSIGNAL);
+            return;
+        }
+        std::vector<uint8_t> frame(FrameDecoder::HEADER_SIZE + body.size());
+        LittleEndian::WriteU32(frame.data(), static_cast<uint32_t>(frame.size()));
+        std::memcpy(frame.data() + FrameDecoder::HEADER_SIZE, body.data(), body.size());
+        (void)SysCall(::send, connection->GetDescriptor(), frame.data(), frame.size(), MSG_NOSIGNAL);
+    }
+
+    // reads at most max_bytes of whatever the bridge sent, and appends every message that's complete
+    // @return bytes read
+    size_t Receive(std::vector<messages::ProtobufMessage> &out, size_t max_bytes = SIZE_MAX) {
+        if (type == LocalSocketType::SeqPacket) {
+            return ReceivePackets(out, max_bytes);
+        }
+        size_t total = 0;
+        while (total < max_bytes) {
+            const size_t wanted = std::min<size_t>(max_bytes - total, 64 * 1024);
+            const std::optional<int> bytes = connection->RecvAvailable(decoder.PrepareWrite(wanted), static_cast<int>(wanted));
+            if (!bytes || *bytes <= 0) break;
+            decoder.CommitWrite(static_cast<size_t>(*bytes));
+            total += static_cast<size_t>(*bytes);
+        }
+
+        const uint8_t *body = nullptr;
+        size_t body_size = 0;
+        while (decoder.Next(body, body_size) == FrameDecoder::Result::Frame) {
+            Decode(body, body_size, out.emplace_back());
+        }
+        return total;
+    }
+
+    // keeps ticking the bridge and reading until nothing has arrived for quiet_ms
+    void Drain(SlimeVRBridge &bridge, std::vector<messages::ProtobufMessage> &out, int quiet_ms = 50) {
+        auto quiet_since = std::chrono::steady_clock::now();
+        while (std::chrono::steady_clock::now() - quiet_since < std::chrono::milliseconds(quiet_ms)) {
+            bridge.runFrame();
+            bridge.flush();
+            if (Receive(out) > 0) {
+                quiet_since = std::chrono::steady_clock::now();
+            }
+            pollfd_t fd = {connection->GetDescriptor(), POLLIN, 0};
+            (void)::poll(&fd, 1, 1);
+        }
+    }
+
+    Descriptor GetDescriptor() const { return connection->GetDescriptor(); }
+
+    // positions that arrived as fixed size records rather than ProtobufMessages
+    size_t compact_poses = 0;
+    size_t quantized_poses = 0;
+    // SeqPacket only: the size of every packet received, in order
+    std::vector<size_t> packet_sizes;
+
+private:
+    void Decode(const uint8_t *body, size_t body_size, messages::ProtobufMessage &msg) {
+        uint64_t timestamp_us;
+        if (CompactPose::Is(body, body_size)) {
+            CompactPose::Decode(body, body_size, *msg.mutable_position(), timestamp_us);
+            compact_poses += 1;
+        } else if (QuantizedPose::Is(body, body_size)) {
+            QuantizedPose::Decode(body, body_size, *msg.mutable_position(), timestamp_us);
+            quantized_poses += 1;
+        } else if (!msg.ParseFromArray(body, static_cast<int>(body_size))) {
+            throw std::runtime_error("the bridge sent a frame that doesn't parse");
+        }
+    }
+
+    // every packet has to be exactly one message
+    size_t ReceivePackets(std::vector<messages::ProtobufMessage> &out, size_t max_bytes) {
+        size_t total = 0;
+        std::vector<uint8_t> packet(64 * 1024);
+        while (total < max_bytes) {
+            const std::optional<int> bytes = connection->RecvMessage(packet.data(), static_cast<int>(packet.size()));
+            if (!bytes || *bytes <= 0) break;
+            packet_sizes.push_back(static_cast<size_t>(*bytes));
+            Decode(packet.data(), static_cast<size_t>(*bytes), out.emplace_back());
+            total += static_cast<size_t>(*bytes);
+        }
+        return total;
+    }
+
+    LocalSocketType type;
+    std::string dir;
+    std::optional<LocalAcceptorSocket> acceptor;
+    std::optional<LocalConnectorSocket> connection;
+    FrameDecoder decoder;
+};
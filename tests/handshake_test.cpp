@@ -0,0 +1,366 @@
+// the PingPong handshake on every connection: what the bridge offers, what it picks from the server's answer,
+// and that a server which never answers still gets the basic protocol.
+#include <algorithm>
+#include <atomic>
+#include <initializer_list>
+#include <thread>
+#include "fake_server.hpp"
+#include "test_util.hpp"
+
+static messages::ProtobufMessage server_hello(std::initializer_list<messages::PingPong_Feature> features) {
+    messages::ProtobufMessage msg;
+    msg.mutable_ping_pong()->set_protocol_version(1);
+    for (auto feature: features) {
+        msg.mutable_ping_pong()->add_features(feature);
+    }
+    return msg;
+}
+
+static messages::ProtobufMessage position(int32_t id) {
+    messages::ProtobufMessage msg;
+    msg.mutable_position()->set_tracker_id(id);
+    msg.mutable_position()->set_x(1.0f);
+    msg.mutable_position()->set_qw(1.0f);
+    return msg;
+}
+
+static std::unique_ptr<SlimeVRBridge> bridge_with(WireFormat wire_format) {
+    BridgeConfig config;
+    config.wire_format = wire_format;
+    return SlimeVRBridge::factory(config);
+}
+
+// ticks the bridge, reading whatever the server sent, until done() or ms have gone by
+template <typename F>
+static bool run_until(SlimeVRBridge &bridge, int ms, F &&done) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+    while (std::chrono::steady_clock::now() < deadline) {
+        bridge.runFrame();
+        bridge.receiveMessages([](messages::ProtobufMessage &) {});
+        bridge.flush();
+        if (done()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+// the hello the bridge sent, if it's arrived
+static const messages::PingPong *find_hello(const std::vector<messages::ProtobufMessage> &received) {
+    for (const auto &msg: received) {
+        if (msg.has_ping_pong() && msg.ping_pong().protocol_version() != 0) {
+            return &msg.ping_pong();
+        }
+    }
+    return nullptr;
+}
+
+// sends one position and reads it back, the server's counters tell how it was encoded
+static bool position_arrives(FakeServer &server, SlimeVRBridge &bridge) {
+    messages::ProtobufMessage msg = position(7);
+    bridge.sendMessage(msg);
+    std::vector<messages::ProtobufMessage> received;
+    server.Drain(bridge, received);
+    return std::count_if(received.begin(), received.end(), [](const messages::ProtobufMessage &msg) {
+        return msg.has_position() && msg.position().tracker_id() == 7;
+    }) == 1;
+}
+
+static void test_hello() {
+    FakeServer server;
+    auto bridge = bridge_with(WireFormat::Protobuf);
+    CHECK(server.Accept(*bridge));
+
+    std::vector<messages::ProtobufMessage> received;
+    server.Drain(*bridge, received);
+    const messages::PingPong *hello = find_hello(received);
+    CHECK(hello != nullptr);
+    if (hello) {
+        CHECK(hello->protocol_version() == 1);
+        for (auto feature: {messages::PingPong_Feature_POSITION_BATCH, messages::PingPong_Feature_COMPACT_POSE, messages::PingPong_Feature_QUANTIZED_POSE,
+                messages::PingPong_Feature_POSITION_TIMESTAMP, messages::PingPong_Feature_POSITION_VELOCITY, messages::PingPong_Feature_ROUND_TRIP}) {
+            CHECK(std::find(hello->features().begin(), hello->features().end(), feature) != hello->features().end());
+        }
+    }
+    // nothing is used before the server has answered
+    CHECK(bridge->getHandshakeState() == HandshakeState::Pending);
+    CHECK(!bridge->serverSupports(messages::PingPong_Feature_POSITION_BATCH));
+    CHECK(bridge->getWireFormat() == WireFormat::Protobuf);
+}
+
+// only what both sides listed is used, features the bridge doesn't know about are ignored
+static void test_negotiated() {
+    FakeServer server;
+    auto bridge = bridge_with(WireFormat::CompactPose);
+    CHECK(server.Accept(*bridge));
+
+    messages::ProtobufMessage hello = server_hello({messages::PingPong_Feature_POSITION_BATCH, messages::PingPong_Feature_COMPACT_POSE});
+    hello.mutable_ping_pong()->add_features(static_cast<messages::PingPong_Feature>(40));
+    server.Send(hello);
+    CHECK(run_until(*bridge, 1000, [&]() { return bridge->getHandshakeState() == HandshakeState::Complete; }));
+
+    CHECK(bridge->serverSupports(messages::PingPong_Feature_POSITION_BATCH));
+    CHECK(bridge->serverSupports(messages::PingPong_Feature_COMPACT_POSE));
+    CHECK(!bridge->serverSupports(messages::PingPong_Feature_QUANTIZED_POSE));
+    CHECK(!bridge->serverSupports(messages::PingPong_Feature_ROUND_TRIP));
+    CHECK(bridge->getWireFormat() == WireFormat::CompactPose);
+    CHECK(position_arrives(server, *bridge));
+    CHECK(server.compact_poses == 1);
+}
+
+// a wire format the server didn't list isn't used, even if it was asked for
+static void test_unsupported_format() {
+    FakeServer server;
+    auto bridge = bridge_with(WireFormat::QuantizedPose);
+    CHECK(server.Accept(*bridge));
+
+    server.Send(server_hello({messages::PingPong_Feature_POSITION_BATCH, messages::PingPong_Feature_COMPACT_POSE}));
+    CHECK(run_until(*bridge, 1000, [&]() { return bridge->getHandshakeState() == HandshakeState::Complete; }));
+
+    CHECK(bridge->getWireFormat() == WireFormat::Protobuf);
+    CHECK(position_arrives(server, *bridge));
+    CHECK(server.compact_poses == 0 && server.quantized_poses == 0);
+}
+
+// the pose records have no room for velocities, a position that has them still goes out as a Position
+static void test_velocity_stays_protobuf() {
+    for (WireFormat format: {WireFormat::CompactPose, WireFormat::QuantizedPose}) {
+        FakeServer server;
+        auto bridge = bridge_with(format);
+        CHECK(server.Accept(*bridge));
+        server.Send(server_hello({messages::PingPong_Feature_COMPACT_POSE, messages::PingPong_Feature_QUANTIZED_POSE,
+            messages::PingPong_Feature_POSITION_VELOCITY}));
+        CHECK(run_until(*bridge, 1000, [&]() { return bridge->getHandshakeState() == HandshakeState::Complete; }));
+        CHECK(bridge->getWireFormat() == format);
+
+        messages::ProtobufMessage moving = position(7);
+        moving.mutable_position()->set_vx(2.0f);
+        moving.mutable_position()->set_avz(-1.0f);
+        bridge->sendMessage(moving);
+        std::vector<messages::ProtobufMessage> received;
+        server.Drain(*bridge, received);
+        const auto it = std::find_if(received.begin(), received.end(), [](const messages::ProtobufMessage &msg) { return msg.has_position(); });
+        CHECK(it != received.end());
+        if (it != received.end()) {
+            CHECK(it->SerializeAsString() == moving.SerializeAsString());
+        }
+        CHECK(server.compact_poses == 0 && server.quantized_poses == 0);
+
+        // without velocities the record is used again
+        CHECK(position_arrives(server, *bridge));
+        CHECK(server.compact_poses + server.quantized_poses == 1);
+    }
+}
+
+// a server older than the handshake never answers, it keeps getting what it always got
+static void test_old_server() {
+    FakeServer server;
+    auto bridge = bridge_with(WireFormat::CompactPose);
+    CHECK(server.Accept(*bridge));
+
+    CHECK(position_arrives(server, *bridge));
+    CHECK(bridge->getHandshakeState() == HandshakeState::Pending);
+    CHECK(run_until(*bridge, 2000, [&]() { return bridge->getHandshakeState() == HandshakeState::Unanswered; }));
+
+    CHECK(!bridge->serverSupports(messages::PingPong_Feature_POSITION_BATCH));
+    CHECK(bridge->getWireFormat() == WireFormat::Protobuf);
+    CHECK(position_arrives(server, *bridge));
+    CHECK(server.compact_poses == 0);
+}
+
+// features only last as long as the connection, the next server might be a different one
+static void test_reconnect() {
+    FakeServer server;
+    auto bridge = bridge_with(WireFormat::CompactPose);
+    CHECK(server.Accept(*bridge));
+    server.Send(server_hello({messages::PingPong_Feature_COMPACT_POSE}));
+    CHECK(run_until(*bridge, 1000, [&]() { return bridge->getHandshakeState() == HandshakeState::Complete; }));
+    CHECK(bridge->getWireFormat() == WireFormat::CompactPose);
+
+    const uint32_t connection_id = bridge->getConnectionId();
+    server.Disconnect();
+    // the bridge notices once a write fails
+    CHECK(run_until(*bridge, 2000, [&]() {
+        messages::ProtobufMessage msg = position(7);
+        bridge->sendMessage(msg);
+        return bridge->getConnectionId() != connection_id;
+    }));
+    CHECK(server.TryAccept(1000));
+
+    CHECK(bridge->getHandshakeState() == HandshakeState::Pending);
+    CHECK(!bridge->serverSupports(messages::PingPong_Feature_COMPACT_POSE));
+    CHECK(bridge->getWireFormat() == WireFormat::Protobuf);
+    std::vector<messages::ProtobufMessage> received;
+    server.Drain(*bridge, received);
+    CHECK(find_hello(received) != nullptr);
+}
+
+// answers every ping the bridge sent, and returns how many there were
+static int answer_pings(FakeServer &server, const std::vector<messages::ProtobufMessage> &received) {
+    int pings = 0;
+    for (const auto &msg: received) {
+        if (msg.has_ping_pong() && msg.ping_pong().ping_timestamp() != 0) {
+            messages::ProtobufMessage pong;
+            pong.mutable_ping_pong()->set_pong_timestamp(msg.ping_pong().ping_timestamp());
+            server.Send(pong);
+            pings += 1;
+        }
+    }
+    return pings;
+}
+
+// pings and pongs go out with the rest of the tick, which is still written once
+static void test_one_write_per_tick() {
+    FakeServer server;
+    auto bridge = bridge_with(WireFormat::Protobuf);
+    CHECK(server.Accept(*bridge));
+    server.Send(server_hello({messages::PingPong_Feature_ROUND_TRIP}));
+    CHECK(run_until(*bridge, 1000, [&]() { return bridge->getHandshakeState() == HandshakeState::Complete; }));
+
+    constexpr int TICKS = 200;
+    const uint64_t flushes = bridge->getBatchStats().flushes;
+    std::vector<messages::ProtobufMessage> received;
+    int pongs = 0;
+    for (int tick = 1; tick <= TICKS; ++tick) {
+        messages::ProtobufMessage ping;
+        ping.mutable_ping_pong()->set_ping_timestamp(tick);
+        server.Send(ping);
+
+        bridge->runFrame();
+        // nothing is written while reading, the pong waits for the flush
+        bridge->receiveMessages([](messages::ProtobufMessage &) {});
+        CHECK(bridge->getBatchStats().flushes == flushes + tick - 1);
+        messages::ProtobufMessage msg = position(7);
+        bridge->sendMessage(msg);
+        bridge->flush();
+
+        received.clear();
+        pollfd_t fd = {server.GetDescriptor(), POLLIN, 0};
+        (void)::poll(&fd, 1, 100);
+        server.Receive(received);
+        answer_pings(server, received);
+        pongs += static_cast<int>(std::count_if(received.begin(), received.end(), [&](const messages::ProtobufMessage &msg) {
+            return msg.has_ping_pong() && msg.ping_pong().pong_timestamp() == static_cast<uint64_t>(tick);
+        }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    CHECK(bridge->getBatchStats().flushes == flushes + TICKS);
+    // every ping was answered in the tick it arrived in
+    CHECK(pongs == TICKS);
+    const LinkStats &link = bridge->getLinkStats();
+    CHECK(link.pings_sent >= 2);
+    CHECK(link.pongs_received >= 2);
+}
+
+// with LatestPoseWins a ping only counts once it's written, it doesn't wait behind the backlog of a server that stopped reading
+static void test_ping_waits_for_room() {
+    FakeServer server;
+    BridgeConfig config;
+    config.backpressure = BackpressureMode::LatestPoseWins;
+    config.queue_size = 16 * 1024;
+    auto bridge = SlimeVRBridge::factory(config);
+    CHECK(server.Accept(*bridge));
+    server.Send(server_hello({messages::PingPong_Feature_ROUND_TRIP}));
+    CHECK(run_until(*bridge, 1000, [&]() { return bridge->getHandshakeState() == HandshakeState::Complete; }));
+
+    // big enough batches that the socket fills up quickly
+    messages::ProtobufMessage batch;
+    for (int32_t id = 0; id < 500; ++id) {
+        messages::Position &position = *batch.mutable_position_batch()->add_positions();
+        position.set_tracker_id(id);
+        position.set_qw(1.0f);
+    }
+    const auto tick = [&]() {
+        bridge->runFrame();
+        bridge->receiveMessages([](messages::ProtobufMessage &) {});
+        bridge->sendMessage(batch);
+        bridge->flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    };
+    // until the socket is full and nothing has been written for a while
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    int unwritten_ticks = 0;
+    while (unwritten_ticks < 50 && std::chrono::steady_clock::now() < deadline) {
+        const uint64_t before = bridge->getBatchStats().flushes;
+        tick();
+        unwritten_ticks = bridge->getBatchStats().flushes == before ? unwritten_ticks + 1 : 0;
+    }
+    CHECK(unwritten_ticks == 50);
+
+    // a couple of ping intervals with nothing written
+    const uint64_t pings_sent = bridge->getLinkStats().pings_sent;
+    const uint64_t flushes = bridge->getBatchStats().flushes;
+    const auto stalled = std::chrono::steady_clock::now() + std::chrono::milliseconds(600);
+    while (std::chrono::steady_clock::now() < stalled) {
+        tick();
+    }
+    CHECK(bridge->getBatchStats().flushes == flushes);
+    CHECK(bridge->getLinkStats().pings_sent == pings_sent);
+
+    // every ping counted is one the server gets
+    std::vector<messages::ProtobufMessage> received;
+    server.Drain(*bridge, received, 200);
+    const auto pings = std::count_if(received.begin(), received.end(), [](const messages::ProtobufMessage &msg) {
+        return msg.has_ping_pong() && msg.ping_pong().ping_timestamp() != 0;
+    });
+    CHECK(pings > 0);
+    CHECK(static_cast<uint64_t>(pings) + pings_sent >= bridge->getLinkStats().pings_sent);
+}
+
+// the round trip is the link's, not however long the rest of the tick took before the ping was written.
+// a server on its own thread answers every probe at once, and the feeder's tick is played out around it:
+// runFrame, OpenVR calls, reading what the server sent, the trackers, then the flush the ping goes out with.
+static void test_round_trip_excludes_tick() {
+    using namespace std::chrono_literals;
+    constexpr auto BEFORE_READ = 10ms;
+    constexpr auto AFTER_READ = 20ms;
+
+    FakeServer server;
+    auto bridge = bridge_with(WireFormat::Protobuf);
+    CHECK(server.Accept(*bridge));
+    server.Send(server_hello({messages::PingPong_Feature_ROUND_TRIP}));
+    CHECK(run_until(*bridge, 1000, [&]() { return bridge->getHandshakeState() == HandshakeState::Complete; }));
+
+    std::atomic<bool> stop = false;
+    std::thread echo([&]() {
+        std::vector<messages::ProtobufMessage> received;
+        while (!stop) {
+            pollfd_t fd = {server.GetDescriptor(), POLLIN, 0};
+            (void)::poll(&fd, 1, 1);
+            received.clear();
+            server.Receive(received);
+            answer_pings(server, received);
+        }
+    });
+
+    const auto end = std::chrono::steady_clock::now() + 1200ms;
+    while (std::chrono::steady_clock::now() < end) {
+        bridge->runFrame();
+        std::this_thread::sleep_for(BEFORE_READ);
+        bridge->receiveMessages([](messages::ProtobufMessage &) {});
+        std::this_thread::sleep_for(AFTER_READ);
+        bridge->flush();
+    }
+    stop = true;
+    echo.join();
+
+    const LinkStats &link = bridge->getLinkStats();
+    CHECK(link.pongs_received >= 2);
+    // written by the flush and read by the next tick's receiveMessages, the time before the flush isn't part of the round trip
+    CHECK(link.rtt_p99_us < std::chrono::microseconds(BEFORE_READ + AFTER_READ / 2).count());
+    fmt::print("round trip: {} pongs, {} us at most, with {} ms of tick after the read\n", link.pongs_received, link.rtt_p99_us, AFTER_READ.count());
+}
+
+int main() {
+    test_hello();
+    test_negotiated();
+    test_unsupported_format();
+    test_velocity_stays_protobuf();
+    test_old_server();
+    test_reconnect();
+    test_one_write_per_tick();
+    test_ping_waits_for_room();
+    test_round_trip_excludes_tick();
+    return test_result();
+}
@@ -0,0 +1,92 @@
+// what's sent along with each position: velocities with --send-velocity and the sample time with --send-timestamp,
+// each only if the server said it supports it, and neither one because of the other.
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include "run_feeder.hpp"
+#include "fake_server.hpp"
+
+static constexpr uint64_t TICKS = 50;
+
+// runs the feeder with flags against a server that supports features, and returns the last position it got
+static messages::Position replay(std::vector<std::string> flags, std::initializer_list<messages::PingPong_Feature> features) {
+    fake_openvr::Reset();
+    auto &runtime = fake_openvr::GetRuntime();
+    runtime.AddDevice(1, TrackedDeviceClass_GenericTracker);
+    runtime.pose_bindings["/actions/main/in/waist"] = 1;
+    runtime.devices[1].pose.vVelocity.v[0] = 0.5f;
+    runtime.devices[1].pose.vAngularVelocity.v[1] = 1.0f;
+
+    FakeServer server;
+    std::vector<messages::ProtobufMessage> received;
+    bool greeted = false;
+    runtime.on_tick = [&](uint64_t tick) {
+        if (server.TryAccept()) {
+            if (!greeted) {
+                messages::ProtobufMessage hello;
+                hello.mutable_ping_pong()->set_protocol_version(1);
+                for (auto feature: features) {
+                    hello.mutable_ping_pong()->add_features(feature);
+                }
+                server.Send(hello);
+                greeted = true;
+            }
+            server.Receive(received);
+        }
+        if (tick == TICKS) {
+            runtime.Quit();
+        }
+    };
+
+    std::vector<char *> argv;
+    std::string name = "feeder";
+    argv.push_back(name.data());
+    for (auto &flag: flags) {
+        argv.push_back(flag.data());
+    }
+    argv.push_back(nullptr);
+    CHECK(feeder_main(static_cast<int>(argv.size() - 1), argv.data()) == 0);
+
+    // the handshake is long over by the last tick, so its position shows what was negotiated
+    for (auto it = received.rbegin(); it != received.rend(); ++it) {
+        if (it->has_position()) return it->position();
+    }
+    CHECK(!"no position arrived");
+    return {};
+}
+
+static void test_send_velocity_and_timestamp() {
+    const std::initializer_list<messages::PingPong_Feature> both = {
+        messages::PingPong_Feature_POSITION_VELOCITY, messages::PingPong_Feature_POSITION_TIMESTAMP};
+
+    messages::Position position = replay({}, both);
+    CHECK(!HasVelocity(position));
+    CHECK(!position.has_timestamp());
+
+    position = replay({"--send-velocity"}, both);
+    CHECK(position.has_vx() && position.vx() == 0.5f);
+    CHECK(position.has_avy() && position.avy() == 1.0f);
+    CHECK(!position.has_timestamp());
+
+    position = replay({"--send-timestamp"}, both);
+    CHECK(!HasVelocity(position));
+    CHECK(position.has_timestamp() && position.timestamp() > 0);
+
+    position = replay({"--send-velocity", "--send-timestamp"}, both);
+    CHECK(HasVelocity(position));
+    CHECK(position.has_timestamp());
+
+    // asking for both only gets what the server supports
+    position = replay({"--send-velocity", "--send-timestamp"}, {messages::PingPong_Feature_POSITION_VELOCITY});
+    CHECK(HasVelocity(position));
+    CHECK(!position.has_timestamp());
+
+    position = replay({"--send-velocity", "--send-timestamp"}, {messages::PingPong_Feature_POSITION_TIMESTAMP});
+    CHECK(!HasVelocity(position));
+    CHECK(position.has_timestamp());
+}
+
+int main() {
+    test_send_velocity_and_timestamp();
+    return test_result();
+}
@@ -0,0 +1,81 @@
+// how long converting a tick's poses takes, one at a time with GetRotation and GetPosition against TransformPoses.
+// not run by ctest, timings depend too much on the machine. pass the number of rounds to change how long it runs.
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <fmt/core.h>
+#include "matrix_utils.h"
+
+// what Trackers::Update did for each tracker before the batch kernel: convert, then turn into the universe
+static void convert_one_at_a_time(const vr::HmdMatrix34_t *poses, uint32_t count, const vr::HmdVector3_t &translation, float yaw, float &sink) {
+    for (uint32_t i = 0; i < count; ++i) {
+        vr::HmdQuaternion_t q = GetRotation(poses[i]);
+        vr::HmdVector3_t pos = GetPosition(poses[i]);
+
+        double rot_w = cos(-yaw / 2);
+        double rot_y = sin(-yaw / 2);
+        vr::HmdQuaternion_t rotated = {
+            rot_w * q.w - rot_y * q.y,
+            rot_w * q.x + rot_y * q.z,
+            rot_w * q.y + rot_y * q.w,
+            rot_w * q.z - rot_y * q.x,
+        };
+        pos.v[0] += translation.v[0];
+        pos.v[1] += translation.v[1];
+        pos.v[2] += translation.v[2];
+        const float x = pos.v[0] * cos(-yaw) + pos.v[2] * sin(-yaw);
+        const float z = -pos.v[0] * sin(-yaw) + pos.v[2] * cos(-yaw);
+        sink += (float)rotated.w + x + pos.v[1] + z;
+    }
+}
+
+template <typename F>
+static double ns_per_pose(uint32_t count, uint64_t rounds, F &&convert) {
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t round = 0; round < rounds; ++round) {
+        convert();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ((double)rounds * count);
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    vr::HmdMatrix34_t poses[PoseBatch::Capacity];
+    for (auto &pose: poses) {
+        // not a rotation, but the work is the same
+        for (auto &row: pose.m) {
+            for (auto &element: row) {
+                element = unit(rng);
+            }
+        }
+    }
+    const vr::HmdVector3_t translation = {{0.5f, 0.0f, -1.25f}};
+    const float yaw = 0.7f;
+    const RigidTransform transform = RigidTransform::FromUniverse(translation, yaw);
+
+    float sink = 0.0f;
+    fmt::print("{:>8} {:>16} {:>16}\n", "trackers", "one at a time", "TransformPoses");
+    for (uint32_t count: {4u, 8u, 16u, 32u, 64u}) {
+        const double scalar = ns_per_pose(count, rounds, [&]() {
+            convert_one_at_a_time(poses, count, translation, yaw, sink);
+        });
+        PoseBatch batch;
+        const double batched = ns_per_pose(count, rounds, [&]() {
+            // gathering the matrices is part of the cost
+            batch.count = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                batch.Add(poses[i]);
+            }
+            TransformPoses(batch, transform);
+            sink += batch.qw[0];
+        });
+        fmt::print("{:>8} {:>13.2f} ns {:>13.2f} ns\n", count, scalar, batched);
+    }
+    // so none of it is optimised away
+    return sink == 12345.0f ? 1 : 0;
+}
@@ -0,0 +1,260 @@
+// the SoA pose kernels have to give the same poses as GetRotation and GetPosition, whichever one the CPU gets,
+// turn them into a universe just like the per-tracker code that came before them, and rotate the velocities with them.
+#include <cmath>
+#include <random>
+#include <vector>
+#include "matrix_utils.h"
+#include "pose_kernel.hpp"
+#include "test_util.hpp"
+
+bool TransformPosesAvx(PoseBatch &batch, const RigidTransform &transform);
+
+// TransformPosesAvx can only be called where the CPU has AVX
+static bool cpu_has_avx() {
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    return __builtin_cpu_supports("avx");
+#else
+    return false;
+#endif
+}
+
+// float poses against the double math of GetRotation, a bit of rounding is all there should be
+static constexpr double MAX_QUATERNION_ERROR = 1e-5;
+static constexpr double MAX_POSITION_ERROR = 1e-6;
+static constexpr double MAX_UNIVERSE_POSITION_ERROR = 1e-5;
+// velocities of up to 10 m/s and rad/s, rotated by a float matrix
+static constexpr double MAX_VELOCITY_ERROR = 2e-5;
+
+// rotation matrix of a unit quaternion, with a translation
+static vr::HmdMatrix34_t matrix(double w, double x, double y, double z, float tx, float ty, float tz) {
+    const double n = std::sqrt(w * w + x * x + y * y + z * z);
+    w /= n; x /= n; y /= n; z /= n;
+    return {{
+        {(float)(1 - 2 * (y * y + z * z)), (float)(2 * (x * y - w * z)), (float)(2 * (x * z + w * y)), tx},
+        {(float)(2 * (x * y + w * z)), (float)(1 - 2 * (x * x + z * z)), (float)(2 * (y * z - w * x)), ty},
+        {(float)(2 * (x * z - w * y)), (float)(2 * (y * z + w * x)), (float)(1 - 2 * (x * x + y * y)), tz},
+    }};
+}
+
+// random rotations and positions, plus the ones where GetRotation's square roots are all but 0
+static std::vector<vr::HmdMatrix34_t> test_poses(size_t count) {
+    std::vector<vr::HmdMatrix34_t> poses = {
+        matrix(1, 0, 0, 0, 0, 0, 0),
+        matrix(0, 1, 0, 0, 1, 2, 3),
+        matrix(0, 0, 1, 0, -1, -2, -3),
+        matrix(0, 0, 0, 1, 0.5f, 1.5f, -0.5f),
+        matrix(0, 1, 1, 0, 0, 0, 0),
+        matrix(1e-4, 1, 0, 1, 0, 0, 0),
+    };
+    std::mt19937 rng(42);
+    std::normal_distribution<double> gaussian;
+    std::uniform_real_distribution<float> metres(-5.0f, 5.0f);
+    while (poses.size() < count) {
+        poses.push_back(matrix(gaussian(rng), gaussian(rng), gaussian(rng), gaussian(rng), metres(rng), metres(rng), metres(rng)));
+    }
+    return poses;
+}
+
+static void check_batch(const PoseBatch &batch, const std::vector<vr::HmdMatrix34_t> &poses, size_t first) {
+    for (uint32_t slot = 0; slot < batch.count; ++slot) {
+        const vr::HmdMatrix34_t &pose = poses[first + slot];
+        const vr::HmdQuaternion_t expected_rotation = GetRotation(pose);
+        const vr::HmdVector3_t expected_position = GetPosition(pose);
+        const vr::HmdQuaternion_t rotation = batch.GetRotation(slot);
+        const vr::HmdVector3_t position = batch.GetPosition(slot);
+
+        CHECK(std::abs(rotation.w - expected_rotation.w) <= MAX_QUATERNION_ERROR);
+        CHECK(std::abs(rotation.x - expected_rotation.x) <= MAX_QUATERNION_ERROR);
+        CHECK(std::abs(rotation.y - expected_rotation.y) <= MAX_QUATERNION_ERROR);
+        CHECK(std::abs(rotation.z - expected_rotation.z) <= MAX_QUATERNION_ERROR);
+        for (int axis = 0; axis < 3; ++axis) {
+            CHECK(std::abs(position.v[axis] - expected_position.v[axis]) <= MAX_POSITION_ERROR);
+        }
+    }
+}
+
+// every batch size from empty to full, so the partial vectors at the end get checked too
+template <typename F>
+static void check_kernel(const char *name, F &&transform) {
+    const std::vector<vr::HmdMatrix34_t> poses = test_poses(PoseBatch::Capacity * 8);
+    const int failures = test_failures;
+    for (size_t first = 0; first + PoseBatch::Capacity <= poses.size(); first += PoseBatch::Capacity) {
+        for (uint32_t count = 0; count <= PoseBatch::Capacity; count += 5) {
+            PoseBatch batch;
+            for (uint32_t slot = 0; slot < count; ++slot) {
+                batch.Add(poses[first + slot]);
+            }
+            transform(batch);
+            check_batch(batch, poses, first);
+        }
+    }
+    fmt::print("{}: {}\n", name, test_failures == failures ? "matches GetRotation and GetPosition" : "doesn't match");
+}
+
+// how Trackers::Update moved each tracker into the chaperone universe before RigidTransform, kept as it was
+static void old_universe_math(vr::HmdQuaternion_t &new_rotation, vr::HmdVector3_t &new_position, const vr::HmdVector3_t &translation, float yaw) {
+    new_position.v[0] += translation.v[0];
+    new_position.v[1] += translation.v[1];
+    new_position.v[2] += translation.v[2];
+
+    auto tmp_w = cos(-yaw / 2);
+    auto tmp_y = sin(-yaw / 2);
+    auto new_w = tmp_w * new_rotation.w - tmp_y * new_rotation.y;
+    auto new_x = tmp_w * new_rotation.x + tmp_y * new_rotation.z;
+    auto new_y = tmp_w * new_rotation.y + tmp_y * new_rotation.w;
+    auto new_z = tmp_w * new_rotation.z - tmp_y * new_rotation.x;
+
+    new_rotation.w = new_w;
+    new_rotation.x = new_x;
+    new_rotation.y = new_y;
+    new_rotation.z = new_z;
+
+    float tmp_sin = sin(-yaw);
+    float tmp_cos = cos(-yaw);
+    auto pos_x = new_position.v[0] * tmp_cos + new_position.v[2] * tmp_sin;
+    auto pos_z = new_position.v[0] * -tmp_sin + new_position.v[2] * tmp_cos;
+
+    new_position.v[0] = pos_x;
+    new_position.v[2] = pos_z;
+}
+
+static void check_universe_transform() {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> metres(-5.0f, 5.0f);
+    std::uniform_real_distribution<float> radians(-3.14159265f, 3.14159265f);
+    const std::vector<vr::HmdMatrix34_t> poses = test_poses(PoseBatch::Capacity);
+    const int failures = test_failures;
+    for (int universe = 0; universe < 200; ++universe) {
+        const vr::HmdVector3_t translation = {{metres(rng), metres(rng), metres(rng)}};
+        const float yaw = universe == 0 ? 0.0f : radians(rng);
+
+        PoseBatch batch;
+        for (const auto &pose: poses) {
+            batch.Add(pose);
+        }
+        TransformPoses(batch, RigidTransform::FromUniverse(translation, yaw));
+
+        for (uint32_t slot = 0; slot < batch.count; ++slot) {
+            vr::HmdQuaternion_t expected_rotation = GetRotation(poses[slot]);
+            vr::HmdVector3_t expected_position = GetPosition(poses[slot]);
+            old_universe_math(expected_rotation, expected_position, translation, yaw);
+            const vr::HmdQuaternion_t rotation = batch.GetRotation(slot);
+            const vr::HmdVector3_t position = batch.GetPosition(slot);
+
+            CHECK(std::abs(rotation.w - expected_rotation.w) <= MAX_QUATERNION_ERROR);
+            CHECK(std::abs(rotation.x - expected_rotation.x) <= MAX_QUATERNION_ERROR);
+            CHECK(std::abs(rotation.y - expected_rotation.y) <= MAX_QUATERNION_ERROR);
+            CHECK(std::abs(rotation.z - expected_rotation.z) <= MAX_QUATERNION_ERROR);
+            for (int axis = 0; axis < 3; ++axis) {
+                // the translation is rotated before it's added now, so a little more rounding
+                CHECK(std::abs(position.v[axis] - expected_position.v[axis]) <= MAX_UNIVERSE_POSITION_ERROR);
+            }
+        }
+    }
+    fmt::print("universe transform: {}\n", test_failures == failures ? "matches the per-tracker math" : "doesn't match");
+}
+
+// a transform that turns any which way, unlike a universe's which only turns around the vertical axis
+static RigidTransform any_rotation(double w, double x, double y, double z) {
+    const double n = std::sqrt(w * w + x * x + y * y + z * z);
+    const vr::HmdMatrix34_t r = matrix(w, x, y, z, 0, 0, 0);
+    RigidTransform transform;
+    transform.qw = (float)(w / n);
+    transform.qx = (float)(x / n);
+    transform.qy = (float)(y / n);
+    transform.qz = (float)(z / n);
+    for (int row = 0; row < 3; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            transform.r[row][col] = r.m[row][col];
+        }
+    }
+    transform.t[0] = 1.0f;
+    transform.t[1] = -2.0f;
+    transform.t[2] = 3.0f;
+    return transform;
+}
+
+// v rotated by the transform's quaternion in doubles, q v q*. the kernels use the matrix, so this doesn't share their math.
+static vr::HmdVector3_t rotate(const RigidTransform &transform, const vr::HmdVector3_t &v) {
+    const double w = transform.qw, x = transform.qx, y = transform.qy, z = transform.qz;
+    const double vx = v.v[0], vy = v.v[1], vz = v.v[2];
+    // t = 2 (q.xyz cross v), then v + w t + q.xyz cross t
+    const double tx = 2 * (y * vz - z * vy), ty = 2 * (z * vx - x * vz), tz = 2 * (x * vy - y * vx);
+    return {{(float)(vx + w * tx + (y * tz - z * ty)), (float)(vy + w * ty + (z * tx - x * tz)), (float)(vz + w * tz + (x * ty - y * tx))}};
+}
+
+static bool close(const vr::HmdVector3_t &a, const vr::HmdVector3_t &b, double max_error) {
+    return std::abs(a.v[0] - b.v[0]) <= max_error && std::abs(a.v[1] - b.v[1]) <= max_error && std::abs(a.v[2] - b.v[2]) <= max_error;
+}
+
+// velocities are rotated but never translated, linear and angular alike. every kernel has to match the double math
+// and the scalar kernel, for the identity, universes and rotations around every axis, and for partial vectors at the end.
+template <typename F>
+static void check_velocities(const char *name, F &&transform_poses) {
+    std::mt19937 rng(11);
+    std::normal_distribution<double> gaussian;
+    std::uniform_real_distribution<float> speed(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> radians(-3.14159265f, 3.14159265f);
+    std::vector<RigidTransform> transforms = {RigidTransform(), RigidTransform::FromUniverse({{0.0f, 0.0f, 0.0f}}, 3.14159265f)};
+    while (transforms.size() < 50) {
+        transforms.push_back(RigidTransform::FromUniverse({{speed(rng), speed(rng), speed(rng)}}, radians(rng)));
+        transforms.push_back(any_rotation(gaussian(rng), gaussian(rng), gaussian(rng), gaussian(rng)));
+    }
+    const std::vector<vr::HmdMatrix34_t> matrices = test_poses(PoseBatch::Capacity);
+    std::vector<vr::TrackedDevicePose_t> poses(PoseBatch::Capacity);
+    for (size_t i = 0; i < poses.size(); ++i) {
+        poses[i].mDeviceToAbsoluteTracking = matrices[i];
+        for (int axis = 0; axis < 3; ++axis) {
+            // the first one stays still, a still tracker has to stay exactly still
+            poses[i].vVelocity.v[axis] = i == 0 ? 0.0f : speed(rng);
+            poses[i].vAngularVelocity.v[axis] = i == 0 ? 0.0f : speed(rng);
+        }
+    }
+
+    const int failures = test_failures;
+    for (const RigidTransform &transform: transforms) {
+        for (uint32_t count: {PoseBatch::Capacity - 3, PoseBatch::Capacity}) {
+            PoseBatch batch, scalar;
+            for (uint32_t slot = 0; slot < count; ++slot) {
+                batch.Add(poses[slot]);
+                scalar.Add(poses[slot]);
+            }
+            transform_poses(batch, transform);
+            TransformPosesWith<ScalarLanes>(scalar, transform);
+
+            for (uint32_t slot = 0; slot < count; ++slot) {
+                const vr::HmdVector3_t velocity = batch.GetVelocity(slot);
+                const vr::HmdVector3_t angular_velocity = batch.GetAngularVelocity(slot);
+                CHECK(close(velocity, rotate(transform, poses[slot].vVelocity), MAX_VELOCITY_ERROR));
+                CHECK(close(angular_velocity, rotate(transform, poses[slot].vAngularVelocity), MAX_VELOCITY_ERROR));
+                CHECK(close(velocity, scalar.GetVelocity(slot), MAX_VELOCITY_ERROR));
+                CHECK(close(angular_velocity, scalar.GetAngularVelocity(slot), MAX_VELOCITY_ERROR));
+            }
+            CHECK(close(batch.GetVelocity(0), {{0.0f, 0.0f, 0.0f}}, 0.0));
+            CHECK(close(batch.GetAngularVelocity(0), {{0.0f, 0.0f, 0.0f}}, 0.0));
+        }
+    }
+    fmt::print("{} velocities: {}\n", name, test_failures == failures ? "rotated like the double math" : "don't match");
+}
+
+int main() {
+    check_kernel("scalar", [](PoseBatch &batch) { TransformPosesWith<ScalarLanes>(batch, RigidTransform()); });
+    check_kernel("dispatched", [](PoseBatch &batch) { TransformPoses(batch); });
+
+    PoseBatch probe;
+    if (cpu_has_avx() && TransformPosesAvx(probe, RigidTransform())) {
+        check_kernel("avx", [](PoseBatch &batch) { TransformPosesAvx(batch, RigidTransform()); });
+    } else {
+        fmt::print("avx: no AVX here, skipped\n");
+    }
+
+    check_universe_transform();
+
+    check_velocities("scalar", [](PoseBatch &batch, const RigidTransform &transform) { TransformPosesWith<ScalarLanes>(batch, transform); });
+    check_velocities("dispatched", [](PoseBatch &batch, const RigidTransform &transform) { TransformPoses(batch, transform); });
+    if (cpu_has_avx() && TransformPosesAvx(probe, RigidTransform())) {
+        check_velocities("avx", [](PoseBatch &batch, const RigidTransform &transform) { TransformPosesAvx(batch, transform); });
+    }
+
+    return test_result();
+}
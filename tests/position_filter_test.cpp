@@ -0,0 +1,165 @@
+// which poses --min-position-delta, --min-rotation-delta, --keepalive and --skip-repeated-frames let through.
+// one tracker is moved by a script, and whatever tick each pose the server gets was sampled on is worked out from the pose itself.
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+#include "run_feeder.hpp"
+#include "fake_server.hpp"
+
+// startup is over by then: the tracker is detected and its first pose sent
+static constexpr uint64_t START = 30;
+static constexpr uint64_t MOVING_TICKS = 100;
+// the pose on START is still where it was, the quit comes before the tick after the last one
+static constexpr uint64_t MOVES = MOVING_TICKS - 1;
+static constexpr double DEGREES = 3.14159265358979323846 / 180.0;
+
+// ticks the tracker has moved for by tick, it holds still before START
+static double moved(uint64_t tick) {
+    return tick < START ? 0.0 : static_cast<double>(tick - START);
+}
+
+// runs the feeder with flags against a tracker that script poses before every tick,
+// and returns every position the server got for it in the order they came
+static std::vector<messages::Position> replay(std::vector<std::string> flags, std::function<void(uint64_t, vr::HmdMatrix34_t &)> script) {
+    fake_openvr::Reset();
+    auto &runtime = fake_openvr::GetRuntime();
+    runtime.AddDevice(1, TrackedDeviceClass_GenericTracker);
+    runtime.pose_bindings["/actions/main/in/waist"] = 1;
+
+    FakeServer server;
+    std::vector<messages::ProtobufMessage> received;
+    runtime.on_tick = [&](uint64_t tick) {
+        script(tick, runtime.devices[1].pose.mDeviceToAbsoluteTracking);
+        if (server.TryAccept()) {
+            server.Receive(received);
+        }
+        if (tick == START + MOVING_TICKS) {
+            runtime.Quit();
+        }
+    };
+
+    std::vector<char *> argv;
+    std::string name = "feeder";
+    argv.push_back(name.data());
+    for (auto &flag: flags) {
+        argv.push_back(flag.data());
+    }
+    argv.push_back(nullptr);
+    CHECK(feeder_main(static_cast<int>(argv.size() - 1), argv.data()) == 0);
+
+    // the last tick's flush may still be on its way
+    CHECK(server.TryAccept());
+    for (int quiet_ms = 0; quiet_ms < 100; ++quiet_ms) {
+        pollfd_t fd = {server.GetDescriptor(), POLLIN, 0};
+        if (::poll(&fd, 1, 1) == 1 && server.Receive(received) > 0) {
+            quiet_ms = 0;
+        }
+    }
+
+    std::vector<messages::Position> positions;
+    for (const auto &msg: received) {
+        if (msg.has_position()) positions.push_back(msg.position());
+    }
+    return positions;
+}
+
+// how far each value got from the one before it, for the values after the tracker started moving
+static std::vector<double> steps(const std::vector<messages::Position> &positions, double start, const std::function<double(const messages::Position &)> &value) {
+    std::vector<double> result;
+    double last = start;
+    for (const auto &position: positions) {
+        const double current = value(position);
+        if (current > start + 1e-6) {
+            result.push_back(current - last);
+            last = current;
+        }
+    }
+    return result;
+}
+
+static bool all_near(const std::vector<double> &values, double expected, double tolerance) {
+    for (double v: values) {
+        if (std::abs(v - expected) > tolerance) return false;
+    }
+    return !values.empty();
+}
+
+static double x_of(const messages::Position &position) {
+    return position.x();
+}
+
+// 3 mm a tick against a 10 mm dead band: every fourth pose is sent, the ones between are held back
+static void test_min_position_delta() {
+    const auto positions = replay({"--min-position-delta", "10", "--keepalive", "60000"}, [](uint64_t tick, vr::HmdMatrix34_t &m) {
+        m.m[0][3] = static_cast<float>(1.0 + 0.003 * moved(tick));
+    });
+    const std::vector<double> sent = steps(positions, 1.0, x_of);
+    CHECK(sent.size() == MOVES / 4);
+    CHECK(all_near(sent, 0.012, 1e-5));
+    fmt::print("min-position-delta: {} of {} moving poses sent\n", sent.size(), MOVES);
+}
+
+// 0.75 degrees a tick against 2 degrees: every third pose is sent. the position jumps 1 cm every tick,
+// which doesn't count once only a rotation threshold is set.
+static void test_min_rotation_delta() {
+    const auto positions = replay({"--min-rotation-delta", "2", "--keepalive", "60000"}, [](uint64_t tick, vr::HmdMatrix34_t &m) {
+        const double angle = 0.75 * DEGREES * moved(tick);
+        m = {{
+            {(float)std::cos(angle), 0.0f, (float)std::sin(angle), tick % 2 ? 1.005f : 0.995f},
+            {0.0f, 1.0f, 0.0f, 1.0f},
+            {(float)-std::sin(angle), 0.0f, (float)std::cos(angle), 0.0f},
+        }};
+    });
+    const std::vector<double> sent = steps(positions, 0.0, [](const messages::Position &position) {
+        return 2.0 * std::atan2(position.qy(), position.qw()) / DEGREES;
+    });
+    CHECK(sent.size() == MOVES / 3);
+    CHECK(all_near(sent, 2.25, 0.01));
+    fmt::print("min-rotation-delta: {} of {} turning poses sent\n", sent.size(), MOVES);
+}
+
+// creeping 0.1 mm a tick never gets past the dead band, the 200 ms keepalive sends it every 20 ticks anyway
+static void test_keepalive() {
+    const auto positions = replay({"--min-position-delta", "10", "--keepalive", "200"}, [](uint64_t tick, vr::HmdMatrix34_t &m) {
+        m.m[0][3] = static_cast<float>(1.0 + 0.0001 * tick);
+    });
+    const std::vector<double> sent = steps(positions, 1.0 + 0.0001 * START, x_of);
+    CHECK(sent.size() >= MOVING_TICKS / 20 - 1);
+    // the first one is however far the last keepalive before START was
+    CHECK(all_near(std::vector<double>(sent.begin() + (sent.empty() ? 0 : 1), sent.end()), 0.002, 1e-5));
+    fmt::print("keepalive: {} still poses sent in {} ticks\n", sent.size(), MOVING_TICKS);
+}
+
+// the compositor only presents a new frame every other tick: the ticks in between are skipped with
+// --skip-repeated-frames, even though the tracker moved, and sent without it
+static void test_skip_repeated_frames() {
+    const auto script = [](uint64_t tick, vr::HmdMatrix34_t &m) {
+        m.m[0][3] = static_cast<float>(1.0 + 0.01 * moved(tick));
+    };
+    const auto skip = [&](std::vector<std::string> flags) {
+        // replay resets the runtime, so the frame rate is set again from the first tick
+        return replay(flags, [&](uint64_t tick, vr::HmdMatrix34_t &m) {
+            fake_openvr::GetRuntime().ticks_per_frame = 2;
+            script(tick, m);
+        });
+    };
+
+    std::vector<double> sent = steps(skip({"--skip-repeated-frames"}), 1.0, x_of);
+    CHECK(sent.size() >= MOVES / 2 && sent.size() <= MOVES / 2 + 1);
+    // the first one depends on which tick a frame started on
+    CHECK(all_near(std::vector<double>(sent.begin() + (sent.empty() ? 0 : 1), sent.end()), 0.02, 1e-5));
+    fmt::print("skip-repeated-frames: {} of {} moving poses sent\n", sent.size(), MOVES);
+
+    sent = steps(skip({}), 1.0, x_of);
+    CHECK(sent.size() == MOVES);
+    CHECK(all_near(sent, 0.01, 1e-5));
+}
+
+int main() {
+    test_min_position_delta();
+    test_min_rotation_delta();
+    test_keepalive();
+    test_skip_repeated_frames();
+    return test_result();
+}
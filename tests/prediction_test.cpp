@@ -0,0 +1,127 @@
+// replays a tracker swinging back and forth to a server that only gets to use each position LINK_DELAY after it arrives,
+// and measures how far what the server uses is from where the tracker really is by then.
+// predicting ahead, by a fixed --predict or by the measured --predict-latency, has to get much closer than sending poses as they are.
+#include <atomic>
+#include <cmath>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include "run_feeder.hpp"
+#include "fake_server.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr auto LINK_DELAY = std::chrono::milliseconds(30);
+// half a metre either way, once every two seconds, so it tops out at about 1.6 m/s
+static constexpr double AMPLITUDE = 0.5;
+static constexpr double OMEGA = 3.14159265358979323846;
+// long enough for a few round trips to have been measured
+static constexpr double SETTLE_SECONDS = 1.0;
+static constexpr uint64_t TICKS = 300;
+
+static double trajectory(double seconds) {
+    return AMPLITUDE * std::sin(OMEGA * seconds);
+}
+
+struct Replay {
+    double mean_error = 0.0; // metres
+    uint64_t positions = 0;
+    float predicted_seconds = 0.0f; // what the feeder asked OpenVR for at the end
+};
+
+static Replay replay(std::vector<std::string> flags) {
+    fake_openvr::Reset();
+    auto &runtime = fake_openvr::GetRuntime();
+    runtime.AddDevice(1, TrackedDeviceClass_GenericTracker);
+    runtime.pose_bindings["/actions/main/in/waist"] = 1;
+
+    FakeServer server;
+    const Clock::time_point start = Clock::now();
+    const auto seconds_since_start = [&](Clock::time_point at) { return std::chrono::duration<double>(at - start).count(); };
+
+    // the server answers pings after two link delays, so the measured round trip has the delay in it both ways
+    std::atomic<bool> stop = false;
+    Replay result;
+    double total_error = 0.0;
+    std::thread server_thread([&]() {
+        while (!stop && !server.TryAccept(10)) {}
+        if (stop) return;
+        messages::ProtobufMessage hello;
+        hello.mutable_ping_pong()->set_protocol_version(1);
+        hello.mutable_ping_pong()->add_features(messages::PingPong_Feature_ROUND_TRIP);
+        server.Send(hello);
+
+        std::deque<std::pair<Clock::time_point, uint64_t>> pongs;
+        std::vector<messages::ProtobufMessage> received;
+        while (!stop) {
+            pollfd_t fd = {server.GetDescriptor(), POLLIN, 0};
+            (void)::poll(&fd, 1, 1);
+            received.clear();
+            server.Receive(received);
+            const Clock::time_point now = Clock::now();
+            for (const auto &msg: received) {
+                if (msg.has_ping_pong() && msg.ping_pong().ping_timestamp() != 0) {
+                    pongs.emplace_back(now + 2 * LINK_DELAY, msg.ping_pong().ping_timestamp());
+                }
+                if (msg.has_position() && seconds_since_start(now) > SETTLE_SECONDS) {
+                    total_error += std::abs(msg.position().x() - trajectory(seconds_since_start(now + LINK_DELAY)));
+                    result.positions += 1;
+                }
+            }
+            while (!pongs.empty() && pongs.front().first <= now) {
+                messages::ProtobufMessage pong;
+                pong.mutable_ping_pong()->set_pong_timestamp(pongs.front().second);
+                server.Send(pong);
+                pongs.pop_front();
+            }
+        }
+    });
+
+    runtime.on_tick = [&](uint64_t tick) {
+        const double seconds = seconds_since_start(Clock::now());
+        fake_openvr::Device &tracker = runtime.devices[1];
+        tracker.pose.mDeviceToAbsoluteTracking.m[0][3] = static_cast<float>(trajectory(seconds));
+        tracker.pose.vVelocity.v[0] = static_cast<float>(AMPLITUDE * OMEGA * std::cos(OMEGA * seconds));
+        if (tick == TICKS) {
+            result.predicted_seconds = runtime.predicted_seconds;
+            runtime.Quit();
+        }
+    };
+
+    std::vector<char *> argv;
+    std::string name = "feeder";
+    argv.push_back(name.data());
+    for (auto &flag: flags) {
+        argv.push_back(flag.data());
+    }
+    argv.push_back(nullptr);
+    CHECK(feeder_main(static_cast<int>(argv.size() - 1), argv.data()) == 0);
+    stop = true;
+    server_thread.join();
+
+    CHECK(result.positions > 0);
+    result.mean_error = result.positions ? total_error / result.positions : 0.0;
+    return result;
+}
+
+static void test_prediction_error() {
+    const Replay latest = replay({});
+    const Replay fixed = replay({"--predict", std::to_string(LINK_DELAY.count())});
+    const Replay measured = replay({"--predict-latency"});
+    fmt::print("prediction error over a {} ms link: {:.1f} mm without, {:.1f} mm with --predict {}, {:.1f} mm with --predict-latency ({:.1f} ms)\n",
+        LINK_DELAY.count(), latest.mean_error * 1000.0, fixed.mean_error * 1000.0, LINK_DELAY.count(),
+        measured.mean_error * 1000.0, measured.predicted_seconds * 1000.0f);
+
+    CHECK(latest.predicted_seconds == 0.0f);
+    CHECK(fixed.mean_error < latest.mean_error / 3);
+    // half the round trip, a little more for the time the feeder takes to read the pong
+    CHECK(measured.predicted_seconds >= 0.9f * std::chrono::duration<float>(LINK_DELAY).count());
+    CHECK(measured.predicted_seconds <= 1.5f * std::chrono::duration<float>(LINK_DELAY).count());
+    CHECK(measured.mean_error < latest.mean_error / 3);
+}
+
+int main() {
+    test_prediction_error();
+    return test_result();
+}
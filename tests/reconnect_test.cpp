@@ -0,0 +1,85 @@
+// the server going away and coming back: while its socket is gone the bridge waits longer and longer between attempts,
+// and once the socket is created again it connects on the very next frame, however long the wait was.
+#include <thread>
+#include <vector>
+#include "fake_server.hpp"
+#include "test_util.hpp"
+
+using namespace std::chrono_literals;
+
+// the shortest wait, what the bridge starts from on every disconnect
+static constexpr std::chrono::milliseconds MIN_RETRY_DELAY = 50ms;
+
+static bool wait_for_disconnect(SlimeVRBridge &bridge) {
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (bridge.status == BRIDGE_CONNECTED && std::chrono::steady_clock::now() < deadline) {
+        bridge.runFrame();
+        bridge.receiveMessages([](messages::ProtobufMessage &) {});
+        std::this_thread::sleep_for(1ms);
+    }
+    // reset() and the first attempt, which is due straight away
+    bridge.runFrame();
+    bridge.runFrame();
+    return bridge.status != BRIDGE_CONNECTED;
+}
+
+// runs the bridge at 1 ms a frame and returns the wait after every attempt it made
+static std::vector<std::chrono::milliseconds> run_disconnected(SlimeVRBridge &bridge, std::chrono::milliseconds duration, uint64_t &frames) {
+    std::vector<std::chrono::milliseconds> delays;
+    ReconnectStats last = bridge.getReconnectStats();
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+        bridge.runFrame();
+        frames += 1;
+        const ReconnectStats stats = bridge.getReconnectStats();
+        if (stats.attempts != last.attempts) {
+            delays.push_back(stats.retry_delay);
+        }
+        last = stats;
+        std::this_thread::sleep_for(1ms);
+    }
+    return delays;
+}
+
+static void test_backoff_and_reconnect() {
+    FakeServer server;
+    auto bridge = SlimeVRBridge::factory(BridgeConfig());
+    CHECK(server.Accept(*bridge));
+    CHECK(bridge->getReconnectStats().retry_delay == MIN_RETRY_DELAY);
+
+    // twice, the second time also checks the socket is watched again after a connection it made itself
+    for (int restart = 0; restart < 2; ++restart) {
+        server.Stop();
+        CHECK(wait_for_disconnect(*bridge));
+        const ReconnectStats first = bridge->getReconnectStats();
+        CHECK(first.retry_delay == 2 * MIN_RETRY_DELAY);
+
+        // attempts 50, 100 and 200 ms apart, not one every frame
+        uint64_t frames = 0;
+        const std::vector<std::chrono::milliseconds> delays = run_disconnected(*bridge, 400ms, frames);
+        CHECK(delays.size() >= 2 && delays.size() <= 4);
+        CHECK(frames > 100);
+        std::chrono::milliseconds expected = first.retry_delay;
+        for (auto delay: delays) {
+            expected *= 2;
+            CHECK(delay == expected);
+        }
+        CHECK(bridge->status == BRIDGE_DISCONNECTED);
+
+        // the next attempt is hundreds of ms away, the socket being created doesn't wait for it
+        const ReconnectStats waiting = bridge->getReconnectStats();
+        server.Restart();
+        CHECK(bridge->runFrame());
+        CHECK(server.TryAccept(100));
+        const ReconnectStats reconnected = bridge->getReconnectStats();
+        CHECK(reconnected.attempts == waiting.attempts + 1);
+        CHECK(reconnected.retry_delay == MIN_RETRY_DELAY);
+        fmt::print("restart {}: {} attempts in {} frames while the socket was gone, reconnected on the frame after it came back\n",
+            restart, delays.size() + 1, frames);
+    }
+}
+
+int main() {
+    test_backoff_and_reconnect();
+    return test_result();
+}
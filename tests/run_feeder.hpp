@@ -0,0 +1,26 @@
+#pragma once
+// main.cpp with its main renamed, so tests can run the feeder's loop against the fake OpenVR runtime
+#include <functional>
+#include "fake_openvr.hpp"
+#include "test_util.hpp"
+
+#define main feeder_main
+#include "main.cpp"
+#undef main
+
+// detect_sweep_ms at the default 100 ticks per second
+static constexpr uint64_t SWEEP_TICKS = detect_sweep_ms * 100 / 1000;
+
+// runs the feeder until ticks ticks have gone by, on_tick is called before each one with the number run so far
+inline void run_feeder(uint64_t ticks, std::function<void(fake_openvr::Runtime &, uint64_t)> on_tick) {
+    auto &runtime = fake_openvr::GetRuntime();
+    runtime.on_tick = [&](uint64_t tick) {
+        on_tick(runtime, tick);
+        if (tick == ticks) {
+            runtime.Quit();
+        }
+    };
+    char name[] = "feeder";
+    char *argv[] = {name, nullptr};
+    CHECK(feeder_main(1, argv) == 0);
+}
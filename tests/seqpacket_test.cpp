@@ -0,0 +1,105 @@
+// SocketMode::SeqPacket: every message is a packet of its own in both directions, with no size prefix,
+// and a server that only listens for streams still gets the size prefixed framing.
+#include <vector>
+#include "fake_server.hpp"
+#include "test_util.hpp"
+
+static messages::ProtobufMessage tracker_added(int32_t id) {
+    messages::ProtobufMessage msg;
+    msg.mutable_tracker_added()->set_tracker_id(id);
+    msg.mutable_tracker_added()->set_tracker_name(fmt::format("tracker {}", id));
+    return msg;
+}
+
+static messages::ProtobufMessage position(int32_t id, int tick) {
+    messages::ProtobufMessage msg;
+    msg.mutable_position()->set_tracker_id(id);
+    msg.mutable_position()->set_x(static_cast<float>(tick));
+    msg.mutable_position()->set_qw(1.0f);
+    return msg;
+}
+
+static std::unique_ptr<SlimeVRBridge> seqpacket_bridge() {
+    BridgeConfig config;
+    config.socket_mode = SocketMode::SeqPacket;
+    return SlimeVRBridge::factory(config);
+}
+
+// what the bridge sends in one flush, more frames than a single sendmmsg takes
+static std::vector<messages::ProtobufMessage> send_tick(SlimeVRBridge &bridge) {
+    std::vector<messages::ProtobufMessage> sent;
+    for (int32_t id = 0; id < 100; ++id) {
+        sent.push_back(tracker_added(id));
+        sent.push_back(position(id, 1));
+    }
+    for (auto &msg: sent) {
+        bridge.sendMessage(msg);
+    }
+    bridge.flush();
+    return sent;
+}
+
+// everything sent arrives once and in order, whatever else the bridge added to it
+static void check_received(const std::vector<messages::ProtobufMessage> &sent, const std::vector<messages::ProtobufMessage> &received) {
+    std::vector<std::string> expected;
+    for (const auto &msg: sent) {
+        expected.push_back(msg.SerializeAsString());
+    }
+    std::vector<std::string> actual;
+    for (const auto &msg: received) {
+        if (!msg.has_ping_pong()) actual.push_back(msg.SerializeAsString());
+    }
+    CHECK(actual == expected);
+}
+
+static bool handshake_completes(FakeServer &server, SlimeVRBridge &bridge) {
+    messages::ProtobufMessage hello;
+    hello.mutable_ping_pong()->set_protocol_version(1);
+    hello.mutable_ping_pong()->add_features(messages::PingPong_Feature_POSITION_BATCH);
+    server.Send(hello);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (bridge.getHandshakeState() != HandshakeState::Complete && std::chrono::steady_clock::now() < deadline) {
+        bridge.runFrame();
+        bridge.receiveMessages([](messages::ProtobufMessage &) {});
+    }
+    return bridge.getHandshakeState() == HandshakeState::Complete;
+}
+
+static void test_packet_per_message() {
+    FakeServer server(LocalSocketType::SeqPacket);
+    auto bridge = seqpacket_bridge();
+    CHECK(server.Accept(*bridge));
+
+    // the server's packets are read one message each too
+    CHECK(handshake_completes(server, *bridge));
+
+    const std::vector<messages::ProtobufMessage> sent = send_tick(*bridge);
+    std::vector<messages::ProtobufMessage> received;
+    server.Drain(*bridge, received);
+    check_received(sent, received);
+
+    // a packet holds exactly one message, with no size prefix
+    CHECK(server.packet_sizes.size() == received.size());
+    for (size_t i = 0; i < std::min(received.size(), server.packet_sizes.size()); ++i) {
+        CHECK(server.packet_sizes[i] == received[i].ByteSizeLong());
+    }
+}
+
+// connecting a seqpacket socket to a stream listener fails with EPROTOTYPE, the bridge connects again with a stream
+static void test_stream_fallback() {
+    FakeServer server(LocalSocketType::Stream);
+    auto bridge = seqpacket_bridge();
+    CHECK(server.Accept(*bridge));
+    CHECK(handshake_completes(server, *bridge));
+
+    const std::vector<messages::ProtobufMessage> sent = send_tick(*bridge);
+    std::vector<messages::ProtobufMessage> received;
+    server.Drain(*bridge, received);
+    check_received(sent, received);
+}
+
+int main() {
+    test_packet_per_message();
+    test_stream_fallback();
+    return test_result();
+}
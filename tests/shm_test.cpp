@@ -0,0 +1,200 @@
+// the shared memory transport against a server made with ShmEndpoint::Create, the reference reader for the feeder's output.
+// a feeder that takes over the segment must not lose what it sends before the server notices it.
+#include <algorithm>
+#include <thread>
+#include <sys/wait.h>
+#include "shm_ring.hpp"
+#include "bridge.hpp"
+#include "test_util.hpp"
+
+// where ShmBridge looks for the server
+static constexpr const char *SEGMENT_NAME = "/SlimeVRInput";
+
+// stands in for the SlimeVR server on the other end of the shared memory segment
+class FakeShmServer {
+public:
+    FakeShmServer() : endpoint(ShmEndpoint::Create(SEGMENT_NAME, 64 * 1024)) {}
+
+    void Send(const messages::ProtobufMessage &msg) {
+        std::string body = msg.SerializeAsString();
+        std::vector<uint8_t> frame(FrameDecoder::HEADER_SIZE + body.size());
+        LittleEndian::WriteU32(frame.data(), static_cast<uint32_t>(frame.size()));
+        std::memcpy(frame.data() + FrameDecoder::HEADER_SIZE, body.data(), body.size());
+        CHECK(endpoint.Write(frame.data(), frame.size()));
+    }
+
+    // appends every complete message the feeder has written, returns how many there were
+    size_t Receive(std::vector<messages::ProtobufMessage> &out) {
+        const auto regions = endpoint.PeekFeeder();
+        const size_t total = regions[0].size + regions[1].size;
+        uint8_t *dest = decoder.PrepareWrite(total);
+        std::memcpy(dest, regions[0].data, regions[0].size);
+        std::memcpy(dest + regions[0].size, regions[1].data, regions[1].size);
+        decoder.CommitWrite(total);
+        endpoint.Inbound().Consume(total);
+
+        size_t count = 0;
+        const uint8_t *body = nullptr;
+        size_t body_size = 0;
+        while (decoder.Next(body, body_size) == FrameDecoder::Result::Frame) {
+            CHECK(out.emplace_back().ParseFromArray(body, static_cast<int>(body_size)));
+            count += 1;
+        }
+        return count;
+    }
+
+    ShmEndpoint endpoint;
+
+private:
+    FrameDecoder decoder;
+};
+
+static std::unique_ptr<SlimeVRBridge> shm_bridge() {
+    BridgeConfig config;
+    config.transport = BridgeTransport::SharedMemory;
+    return SlimeVRBridge::factory(config);
+}
+
+static bool connect(SlimeVRBridge &bridge) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (std::chrono::steady_clock::now() < deadline) {
+        bridge.runFrame();
+        bridge.flush();
+        if (bridge.status == BRIDGE_CONNECTED) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+static messages::ProtobufMessage tracker_added(int32_t id) {
+    messages::ProtobufMessage msg;
+    msg.mutable_tracker_added()->set_tracker_id(id);
+    msg.mutable_tracker_added()->set_tracker_serial("serial");
+    return msg;
+}
+
+static bool has_hello(const std::vector<messages::ProtobufMessage> &received) {
+    return std::any_of(received.begin(), received.end(), [](const messages::ProtobufMessage &msg) {
+        return msg.has_ping_pong() && msg.ping_pong().protocol_version() != 0;
+    });
+}
+
+static std::vector<int32_t> added_ids(const std::vector<messages::ProtobufMessage> &received) {
+    std::vector<int32_t> ids;
+    for (const auto &msg: received) {
+        if (msg.has_tracker_added()) ids.push_back(msg.tracker_added().tracker_id());
+    }
+    return ids;
+}
+
+// both directions work, and the server can tell which feeder is attached
+static void test_connects() {
+    FakeShmServer server;
+    {
+        auto bridge = shm_bridge();
+        CHECK(connect(*bridge));
+        CHECK(server.endpoint.GetFeederPid() == ::getpid());
+        CHECK(server.endpoint.IsPeerAlive());
+
+        CHECK(server.endpoint.WaitReadable(1000));
+        std::vector<messages::ProtobufMessage> received;
+        server.Receive(received);
+        CHECK(has_hello(received));
+
+        messages::ProtobufMessage hello;
+        hello.mutable_ping_pong()->set_protocol_version(1);
+        hello.mutable_ping_pong()->add_features(messages::PingPong_Feature_POSITION_BATCH);
+        server.Send(hello);
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (bridge->getHandshakeState() == HandshakeState::Pending && std::chrono::steady_clock::now() < deadline) {
+            bridge->runFrame();
+            bridge->receiveMessages([](messages::ProtobufMessage &) {});
+        }
+        CHECK(bridge->getHandshakeState() == HandshakeState::Complete);
+        CHECK(bridge->serverSupports(messages::PingPong_Feature_POSITION_BATCH));
+
+        messages::ProtobufMessage msg = tracker_added(3);
+        bridge->sendMessage(msg);
+        bridge->flush();
+        received.clear();
+        CHECK(server.endpoint.WaitReadable(1000));
+        server.Receive(received);
+        CHECK(added_ids(received) == std::vector<int32_t>{3});
+    }
+    // detaches when it goes away
+    CHECK(server.endpoint.GetFeederPid() == 0);
+}
+
+// the server sleeps until the feeder writes, and not for longer than it was asked to
+static void test_wait_readable() {
+    FakeShmServer server;
+    auto bridge = shm_bridge();
+    CHECK(connect(*bridge));
+    std::vector<messages::ProtobufMessage> received;
+    CHECK(server.endpoint.WaitReadable(1000));
+    server.Receive(received);
+
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!server.endpoint.WaitReadable(50));
+    CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(40));
+
+    std::thread writer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        messages::ProtobufMessage msg = tracker_added(4);
+        bridge->sendMessage(msg);
+        bridge->flush();
+    });
+    start = std::chrono::steady_clock::now();
+    CHECK(server.endpoint.WaitReadable(5000));
+    CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    writer.join();
+    received.clear();
+    server.Receive(received);
+    CHECK(added_ids(received) == std::vector<int32_t>{4});
+}
+
+// a feeder that died without detaching left frames behind. the one that takes over writes its hello and trackers
+// straight away, before the server has looked at the segment again: only the dead feeder's frames are dropped.
+static void test_takeover_keeps_new_frames() {
+    FakeShmServer server;
+
+    const pid_t child = ::fork();
+    if (child == 0) {
+        std::optional<ShmEndpoint> endpoint = ShmEndpoint::Open(SEGMENT_NAME);
+        if (!endpoint) ::_exit(1);
+        messages::ProtobufMessage msg = tracker_added(99);
+        std::string body = msg.SerializeAsString();
+        std::vector<uint8_t> frame(FrameDecoder::HEADER_SIZE + body.size());
+        LittleEndian::WriteU32(frame.data(), static_cast<uint32_t>(frame.size()));
+        std::memcpy(frame.data() + FrameDecoder::HEADER_SIZE, body.data(), body.size());
+        // gone without running the destructor, as if it had crashed
+        ::_exit(endpoint->Write(frame.data(), frame.size()) ? 0 : 1);
+    }
+    int child_status = 0;
+    CHECK(::waitpid(child, &child_status, 0) == child);
+    CHECK(WIFEXITED(child_status) && WEXITSTATUS(child_status) == 0);
+    CHECK(server.endpoint.GetFeederPid() == child);
+
+    auto bridge = shm_bridge();
+    CHECK(connect(*bridge));
+    CHECK(server.endpoint.GetFeederPid() == ::getpid());
+    for (int32_t id: {1, 2}) {
+        messages::ProtobufMessage msg = tracker_added(id);
+        bridge->sendMessage(msg);
+    }
+    bridge->flush();
+
+    std::vector<messages::ProtobufMessage> received;
+    server.Receive(received);
+    CHECK(has_hello(received));
+    CHECK((added_ids(received) == std::vector<int32_t>{1, 2}));
+}
+
+int main() {
+    test_connects();
+    test_wait_readable();
+    test_takeover_keeps_new_frames();
+    return test_result();
+}
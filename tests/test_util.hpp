@@ -0,0 +1,22 @@
+#pragma once
+#include <fmt/core.h>
+
+// failed checks are counted rather than aborting, so a single run shows everything that's wrong
+inline int test_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fmt::print("{}:{}: CHECK({}) failed\n", __FILE__, __LINE__, #cond); \
+            test_failures += 1; \
+        } \
+    } while (0)
+
+// exit code for main
+inline int test_result() {
+    if (test_failures > 0) {
+        fmt::print("{} checks failed\n", test_failures);
+        return 1;
+    }
+    fmt::print("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,103 @@
+// how long Trackers::Tick takes with all 64 device slots taken by trackers, against the fake OpenVR runtime.
+// only Tick is timed, not the flush or the server reading what it sent.
+// not run by ctest, timings depend too much on the machine. pass the number of ticks to change how long it runs.
+#include <algorithm>
+#include <cstdlib>
+#include "run_feeder.hpp"
+#include "fake_server.hpp"
+
+struct TickTimes {
+    double avg_ns = 0.0;
+    double p99_ns = 0.0;
+    double positions_per_tick = 0.0;
+};
+
+// every tracker moves a little each tick unless still is set, so the filter has something to suppress
+static TickTimes measure(uint64_t ticks, const PositionFilter &filter, const PoseOptions &pose_options, bool still) {
+    fake_openvr::Reset();
+    auto &runtime = fake_openvr::GetRuntime();
+    runtime.AddDevice(0, TrackedDeviceClass_HMD);
+    for (TrackedDeviceIndex_t index = 1; index < k_unMaxTrackedDeviceCount; ++index) {
+        runtime.AddDevice(index, TrackedDeviceClass_GenericTracker);
+    }
+
+    FakeServer server;
+    auto bridge = SlimeVRBridge::factory(BridgeConfig());
+    CHECK(server.Accept(*bridge));
+    messages::ProtobufMessage hello;
+    hello.mutable_ping_pong()->set_protocol_version(1);
+    hello.mutable_ping_pong()->add_features(messages::PingPong_Feature_POSITION_BATCH);
+    server.Send(hello);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (bridge->getHandshakeState() == HandshakeState::Pending && std::chrono::steady_clock::now() < deadline) {
+        bridge->runFrame();
+        bridge->receiveMessages([](messages::ProtobufMessage &) {});
+    }
+
+    std::optional<Trackers> trackers = Trackers::Create(*bridge, TrackingUniverseStanding, filter, pose_options);
+    CHECK(trackers.has_value());
+    if (!trackers) {
+        return {};
+    }
+    // trackers without a role wait a few detections before they're sent as they are, like at startup
+    trackers->UpdateActions();
+    for (int detection = 0; detection < 1000 && trackers->Detect(detection == 0, true); ++detection) {}
+
+    std::vector<uint64_t> tick_ns;
+    tick_ns.reserve(ticks);
+    std::vector<messages::ProtobufMessage> received;
+    for (uint64_t tick = 0; tick < ticks; ++tick) {
+        if (!still) {
+            for (auto &device: runtime.devices) {
+                device.pose.mDeviceToAbsoluteTracking.m[1][3] = 1.0f + 0.001f * (float)(tick % 100);
+            }
+        }
+        bridge->runFrame();
+        const auto start = std::chrono::steady_clock::now();
+        trackers->Tick(tick == 0);
+        tick_ns.push_back(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+        bridge->flush();
+
+        // read so the socket never fills up, what Tick decided to send is in its stats
+        received.clear();
+        server.Receive(received);
+    }
+
+    TickTimes times;
+    uint64_t total = 0;
+    for (uint64_t ns: tick_ns) total += ns;
+    times.avg_ns = static_cast<double>(total) / tick_ns.size();
+    std::sort(tick_ns.begin(), tick_ns.end());
+    times.p99_ns = static_cast<double>(tick_ns[static_cast<size_t>(0.99 * (tick_ns.size() - 1))]);
+    times.positions_per_tick = static_cast<double>(trackers->GetPositionStats().sent) / ticks;
+    return times;
+}
+
+static void print(const char *name, const TickTimes &times) {
+    fmt::print("{:>24} {:>10.0f} ns {:>10.0f} ns {:>10.1f} ns {:>10.1f}\n",
+        name, times.avg_ns, times.p99_ns, times.avg_ns / k_unMaxTrackedDeviceCount, times.positions_per_tick);
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t ticks = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+
+    PositionFilter unfiltered;
+    PositionFilter dead_band;
+    dead_band.min_position_delta = 0.0005f;
+    dead_band.min_rotation_delta = 0.5f * 3.14159265f / 180.0f;
+    PoseOptions one_each;
+    PoseOptions batched;
+    batched.batch_positions = true;
+
+    // detection prints every tracker it finds, so the table comes after all of it
+    const TickTimes moving = measure(ticks, unfiltered, one_each, false);
+    const TickTimes moving_batched = measure(ticks, unfiltered, batched, false);
+    const TickTimes still = measure(ticks, dead_band, one_each, true);
+
+    fmt::print("\nTrackers::Tick over {} ticks of {} trackers\n", ticks, k_unMaxTrackedDeviceCount);
+    fmt::print("{:>24} {:>13} {:>13} {:>13} {:>10}\n", "", "avg", "p99", "per tracker", "sent");
+    print("moving", moving);
+    print("moving, position batch", moving_batched);
+    print("still, dead band", still);
+    return 0;
+}
@@ -0,0 +1,161 @@
+// how long a position takes from flush() to the server, and how many positions a second get through,
+// over a stream or seqpacket unix socket and over shared memory.
+// not run by ctest, timings depend too much on the machine. pass the number of positions to send to change how long it runs.
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include <fmt/core.h>
+#include "fake_server.hpp"
+#include "shm_ring.hpp"
+
+static uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static void print(const char *name, std::vector<uint64_t> &latencies_ns, double positions_per_second) {
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    uint64_t total = 0;
+    for (uint64_t latency: latencies_ns) total += latency;
+    const auto at = [&](double fraction) { return latencies_ns[static_cast<size_t>(fraction * (latencies_ns.size() - 1))] / 1000.0; };
+    fmt::print("{:>10} {:>10.1f} us {:>10.1f} us {:>10.1f} us {:>10.1f} us {:>12.0f}/s\n",
+        name, total / 1000.0 / latencies_ns.size(), at(0.5), at(0.99), at(1.0), positions_per_second);
+}
+
+// one position at a time, the next is only sent once the server has the last one. the send time travels in the timestamp.
+// receive runs on the server's thread, waits for something to arrive and returns the send times of the positions that did.
+template <typename Receive>
+static std::vector<uint64_t> measure(SlimeVRBridge &bridge, uint64_t count, Receive &&receive) {
+    std::vector<uint64_t> latencies_ns;
+    latencies_ns.reserve(count);
+    std::atomic<uint64_t> received = 0;
+    std::thread server([&]() {
+        std::vector<uint64_t> sent_ns;
+        while (received < count) {
+            sent_ns.clear();
+            receive(sent_ns);
+            const uint64_t arrived = now_ns();
+            for (uint64_t sent: sent_ns) {
+                latencies_ns.push_back(arrived - sent);
+            }
+            received += sent_ns.size();
+        }
+    });
+
+    messages::ProtobufMessage msg;
+    msg.mutable_position()->set_tracker_id(1);
+    msg.mutable_position()->set_qw(1.0f);
+    for (uint64_t i = 0; i < count; ++i) {
+        bridge.runFrame();
+        msg.mutable_position()->set_timestamp(now_ns());
+        bridge.sendMessage(msg);
+        bridge.flush();
+        while (received <= i) {
+            std::this_thread::yield();
+        }
+        // the server starts every wait from asleep, like it would between ticks
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    server.join();
+    return latencies_ns;
+}
+
+// ticks of TRACKERS positions each, as fast as the server reads them. the bridge never has more than a few ticks
+// in flight, so nothing is dropped. receive is as for measure.
+template <typename Receive>
+static double positions_per_second(SlimeVRBridge &bridge, uint64_t count, Receive &&receive) {
+    constexpr int TRACKERS = 16;
+    constexpr uint64_t MAX_IN_FLIGHT = 8 * TRACKERS;
+    std::atomic<uint64_t> received = 0;
+    const auto start = std::chrono::steady_clock::now();
+    std::thread server([&]() {
+        std::vector<uint64_t> sent_ns;
+        while (received < count) {
+            sent_ns.clear();
+            receive(sent_ns);
+            received += sent_ns.size();
+        }
+    });
+
+    messages::ProtobufMessage msg;
+    msg.mutable_position()->set_qw(1.0f);
+    for (uint64_t sent = 0; sent < count; ) {
+        bridge.runFrame();
+        for (int id = 0; id < TRACKERS && sent < count; ++id, ++sent) {
+            msg.mutable_position()->set_tracker_id(id);
+            msg.mutable_position()->set_timestamp(sent);
+            bridge.sendMessage(msg);
+        }
+        bridge.flush();
+        while (sent - received > MAX_IN_FLIGHT) {
+            std::this_thread::yield();
+        }
+    }
+    server.join();
+    return count / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void bench_socket(const char *name, SocketMode mode, uint64_t count) {
+    FakeServer server(mode == SocketMode::SeqPacket ? LocalSocketType::SeqPacket : LocalSocketType::Stream);
+    BridgeConfig config;
+    config.socket_mode = mode;
+    auto bridge = SlimeVRBridge::factory(config);
+    if (!server.Accept(*bridge)) {
+        fmt::print("{}: couldn't connect\n", name);
+        return;
+    }
+    std::vector<messages::ProtobufMessage> received;
+    const auto receive = [&](std::vector<uint64_t> &sent_ns) {
+        pollfd_t fd = {server.GetDescriptor(), POLLIN, 0};
+        (void)::poll(&fd, 1, 100);
+        received.clear();
+        server.Receive(received);
+        for (const auto &msg: received) {
+            if (msg.has_position()) sent_ns.push_back(msg.position().timestamp());
+        }
+    };
+    std::vector<uint64_t> latencies_ns = measure(*bridge, count, receive);
+    print(name, latencies_ns, positions_per_second(*bridge, 100 * count, receive));
+}
+
+static void bench_shm(uint64_t count) {
+    ShmEndpoint server = ShmEndpoint::Create("/SlimeVRInput", 256 * 1024);
+    BridgeConfig config;
+    config.transport = BridgeTransport::SharedMemory;
+    auto bridge = SlimeVRBridge::factory(config);
+    while (bridge->status != BRIDGE_CONNECTED) {
+        bridge->runFrame();
+    }
+    FrameDecoder decoder;
+    messages::ProtobufMessage msg;
+    const auto receive = [&](std::vector<uint64_t> &sent_ns) {
+        (void)server.WaitReadable(100);
+        const auto regions = server.PeekFeeder();
+        const size_t total = regions[0].size + regions[1].size;
+        uint8_t *dest = decoder.PrepareWrite(total);
+        std::memcpy(dest, regions[0].data, regions[0].size);
+        std::memcpy(dest + regions[0].size, regions[1].data, regions[1].size);
+        decoder.CommitWrite(total);
+        server.Inbound().Consume(total);
+
+        const uint8_t *body = nullptr;
+        size_t body_size = 0;
+        while (decoder.Next(body, body_size) == FrameDecoder::Result::Frame) {
+            if (msg.ParseFromArray(body, static_cast<int>(body_size)) && msg.has_position()) sent_ns.push_back(msg.position().timestamp());
+        }
+    };
+    std::vector<uint64_t> latencies_ns = measure(*bridge, count, receive);
+    print("shm", latencies_ns, positions_per_second(*bridge, 100 * count, receive));
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000;
+
+    fmt::print("latency of {} positions from flush() to the server reading them, throughput of {} in ticks of 16\n", count, 100 * count);
+    fmt::print("{:>10} {:>13} {:>13} {:>13} {:>13} {:>14}\n", "bridge", "avg", "p50", "p99", "max", "throughput");
+    bench_socket("stream", SocketMode::Stream, count);
+    bench_socket("seqpacket", SocketMode::SeqPacket, count);
+    bench_shm(count);
+    return 0;
+}
@@ -0,0 +1,142 @@
+// how long finding the current universe takes with a big chaperone file: a UniverseTable rebuild, a lookup in it,
+// and the search through the whole file that every lookup did before there was a table.
+// not run by ctest, timings depend too much on the machine.
+// pass the number of rounds, the number of universes to generate, or a real chaperone_info.vrchap to read instead.
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include "run_feeder.hpp"
+
+// what the universe lookup did on every universe change before UniverseTable: export, parse until the universe turns up
+static std::optional<UniverseTranslation> search_universe(simdjson::ondemand::parser &json_parser, uint64_t target) {
+    uint32_t length = 0;
+    VRChaperoneSetup()->ExportLiveToBuffer(nullptr, &length);
+    auto json = simdjson::padded_string(length - 1);
+    if (!VRChaperoneSetup()->ExportLiveToBuffer(json.data(), &length)) {
+        return std::nullopt;
+    }
+    simdjson::ondemand::document doc = json_parser.iterate(json);
+    for (simdjson::ondemand::object uni: doc["universes"]) {
+        auto res = uni.find_field_unordered("universeID");
+        if (res.error()) {
+            continue;
+        }
+        simdjson::ondemand::value elem = res.value_unsafe();
+        uint64_t parsed_universe;
+        auto is_integer = elem.is_integer();
+        if (!is_integer.error() && is_integer.value_unsafe()) {
+            parsed_universe = elem.get_uint64();
+        } else {
+            parsed_universe = elem.get_uint64_in_string();
+        }
+        if (parsed_universe == target) {
+            return UniverseTranslation::parse(uni["standing"].get_object().value());
+        }
+    }
+    return std::nullopt;
+}
+
+// laid out like SteamVR writes chaperone_info.vrchap: a room's collision bounds before the poses, the id last
+static std::string generate_chaperone(int universes, std::vector<uint64_t> &ids) {
+    std::mt19937_64 rng(16);
+    std::uniform_real_distribution<double> metres(-3.0, 3.0);
+    std::uniform_real_distribution<double> radians(-3.14159, 3.14159);
+    std::string json = R"({"jsonid": "chaperone_info", "universes": [)";
+    for (int universe = 0; universe < universes; ++universe) {
+        if (universe > 0) json += ", ";
+        json += R"({"collision_bounds": [)";
+        // a wall of four corners every side of an octagon
+        for (int wall = 0; wall < 8; ++wall) {
+            if (wall > 0) json += ", ";
+            json += fmt::format("[[{:.6f}, 0.0, {:.6f}], [{:.6f}, 2.43, {:.6f}], [{:.6f}, 2.43, {:.6f}], [{:.6f}, 0.0, {:.6f}]]",
+                metres(rng), metres(rng), metres(rng), metres(rng), metres(rng), metres(rng), metres(rng), metres(rng));
+        }
+        ids.push_back(rng() >> 1);
+        json += fmt::format(R"(], "play_area": [{:.6f}, {:.6f}], )", metres(rng) + 3.0, metres(rng) + 3.0);
+        json += fmt::format(R"("seated": {{"translation": [{:.6f}, {:.6f}, {:.6f}], "yaw": {:.6f}}}, )", metres(rng), metres(rng), metres(rng), radians(rng));
+        json += fmt::format(R"("standing": {{"translation": [{:.6f}, {:.6f}, {:.6f}], "yaw": {:.6f}}}, )", metres(rng), metres(rng), metres(rng), radians(rng));
+        json += fmt::format(R"("time": "Fri Oct 16 12:00:00 2026", "universeID": "{}"}})", ids.back());
+    }
+    return json + R"(], "version": 5})";
+}
+
+// the ids in a real file, to look them up
+static std::vector<uint64_t> universe_ids(simdjson::ondemand::parser &json_parser, const std::string &json) {
+    std::vector<uint64_t> ids;
+    simdjson::padded_string padded(json);
+    simdjson::ondemand::document doc = json_parser.iterate(padded);
+    for (simdjson::ondemand::object uni: doc["universes"]) {
+        simdjson::ondemand::value elem = uni.find_field_unordered("universeID").value();
+        auto is_integer = elem.is_integer();
+        ids.push_back(!is_integer.error() && is_integer.value_unsafe() ? elem.get_uint64().value() : elem.get_uint64_in_string().value());
+    }
+    return ids;
+}
+
+template <typename F>
+static double ns_per_call(uint64_t calls, F &&call) {
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < calls; ++i) {
+        call(i);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200;
+    const int universes = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    fake_openvr::Reset();
+    auto &runtime = fake_openvr::GetRuntime();
+    simdjson::ondemand::parser json_parser;
+
+    // from disk either way, a generated file goes through a temporary one
+    std::filesystem::path path;
+    std::vector<uint64_t> ids;
+    if (argc > 3) {
+        path = argv[3];
+    } else {
+        path = std::filesystem::temp_directory_path() / "universe_bench_chaperone_info.vrchap";
+        std::ofstream(path, std::ios::binary) << generate_chaperone(universes, ids);
+    }
+    std::stringstream contents;
+    contents << std::ifstream(path, std::ios::binary).rdbuf();
+    runtime.chaperone_json = contents.str();
+    if (argc > 3) {
+        ids = universe_ids(json_parser, runtime.chaperone_json);
+    } else {
+        std::filesystem::remove(path);
+    }
+    if (ids.empty()) {
+        fmt::print("no universes in {}\n", path.string());
+        return 1;
+    }
+
+    UniverseTable table;
+    const double rebuild_ns = ns_per_call(rounds, [&](uint64_t) { table.Rebuild(json_parser); });
+
+    // every universe in turn, then ones that aren't there
+    float sink = 0.0f;
+    const uint64_t lookups = rounds * 10000;
+    const double find_ns = ns_per_call(lookups, [&](uint64_t i) {
+        sink += table.Find(ids[i % ids.size()])->translation.v[0];
+    });
+    const double miss_ns = ns_per_call(lookups, [&](uint64_t i) {
+        sink += table.Find(i * 2 + 1).has_value() ? 1.0f : 0.0f;
+    });
+    const double search_first_ns = ns_per_call(rounds, [&](uint64_t) { sink += search_universe(json_parser, ids.front())->yaw; });
+    const double search_last_ns = ns_per_call(rounds, [&](uint64_t) { sink += search_universe(json_parser, ids.back())->yaw; });
+    if (sink == 12345.0f) fmt::print(" ");
+
+    fmt::print("{} universes, {:.1f} KiB of chaperone data\n", ids.size(), runtime.chaperone_json.size() / 1024.0);
+    fmt::print("{:>36} {:>12.1f} us\n", "UniverseTable::Rebuild", rebuild_ns / 1000.0);
+    fmt::print("{:>36} {:>12.1f} ns\n", "UniverseTable::Find", find_ns);
+    fmt::print("{:>36} {:>12.1f} ns\n", "UniverseTable::Find, not there", miss_ns);
+    fmt::print("{:>36} {:>12.1f} us\n", "search every lookup, first universe", search_first_ns / 1000.0);
+    fmt::print("{:>36} {:>12.1f} us\n", "search every lookup, last universe", search_last_ns / 1000.0);
+    return 0;
+}
@@ -0,0 +1,57 @@
+// the chaperone universe is looked up again until the table has the one the runtime says it's in,
+// SteamVR can switch universes before it has written the new one out.
+#include <string>
+#include "run_feeder.hpp"
+
+static std::string chaperone_json(std::initializer_list<int> universes) {
+    std::string json = R"({"jsonid": "chaperone_info", "universes": [)";
+    for (int universe: universes) {
+        if (json.back() == '}') json += ", ";
+        json += fmt::format(R"({{"universeID": "{}", "standing": {{"translation": [0.5, 0.0, {}], "yaw": 0.25}}}})", universe, universe);
+    }
+    return json + R"(], "version": 5})";
+}
+
+static void test_universe_written_late() {
+    fake_openvr::Reset();
+    auto &runtime = fake_openvr::GetRuntime();
+    runtime.chaperone_json = chaperone_json({1});
+    runtime.universe_id = 1;
+
+    constexpr uint64_t SWITCH = 20;
+    constexpr uint64_t WRITTEN = SWITCH + SWEEP_TICKS + 10;
+    constexpr uint64_t FOUND = WRITTEN + SWEEP_TICKS + 10;
+    constexpr uint64_t TICKS = FOUND + 2 * SWEEP_TICKS;
+    uint64_t exports_before_switch = 0;
+    uint64_t exports_at_switch = 0;
+    uint64_t exports_found = 0;
+    run_feeder(TICKS, [&](fake_openvr::Runtime &runtime, uint64_t tick) {
+        if (tick == 10) {
+            exports_before_switch = runtime.calls.chaperone_exports;
+        }
+        if (tick == SWITCH) {
+            // universe 1 was found straight away, so nothing was looked up since
+            CHECK(runtime.calls.chaperone_exports == exports_before_switch);
+            exports_at_switch = runtime.calls.chaperone_exports;
+            runtime.universe_id = 2;
+            runtime.PushEvent(VREvent_ChaperoneUniverseHasChanged);
+        }
+        if (tick == WRITTEN) {
+            // universe 2 isn't there, but the old one still is, so the lookup has to keep trying
+            CHECK(runtime.calls.chaperone_exports - exports_at_switch >= 2);
+            runtime.chaperone_json = chaperone_json({1, 2});
+        }
+        if (tick == FOUND) {
+            exports_found = runtime.calls.chaperone_exports;
+        }
+    });
+
+    // found on the first retry after it was written, nothing was looked up after that
+    CHECK(exports_found > 0);
+    CHECK(runtime.calls.chaperone_exports == exports_found);
+}
+
+int main() {
+    test_universe_written_late();
+    return test_result();
+}
@@ -0,0 +1,173 @@
+// what each wire format costs a position: bytes on the wire, and the time to encode and decode it.
+// then the same for a PositionBatch with a whole tick's trackers in it, against a Position frame each.
+// not run by ctest, timings depend too much on the machine. pass the number of rounds to change how long it runs.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <fmt/core.h>
+#include "frame_decoder.hpp"
+#include "wire_format.hpp"
+
+// the bandwidth is worked out for this many trackers at the default tick rate
+static constexpr int TRACKERS = 16;
+static constexpr int TICKS_PER_SECOND = 100;
+
+struct Result {
+    size_t bytes; // per frame, header included
+    double encode_ns;
+    double decode_ns;
+};
+
+template <typename F>
+static double ns_per_position(size_t positions, uint64_t rounds, F &&run) {
+    const auto start = std::chrono::steady_clock::now();
+    for (uint64_t round = 0; round < rounds; ++round) {
+        run();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ((double)rounds * positions);
+}
+
+// encode writes a body for a position and returns its size, decode reads one back
+template <typename Encode, typename Decode>
+static Result measure(const std::vector<messages::ProtobufMessage> &sent, uint64_t rounds, Encode &&encode, Decode &&decode) {
+    std::vector<uint8_t> bodies(sent.size() * 64);
+    std::vector<size_t> sizes(sent.size());
+    size_t total = 0;
+    Result result = {};
+    result.encode_ns = ns_per_position(sent.size(), rounds, [&]() {
+        total = 0;
+        for (size_t i = 0; i < sent.size(); ++i) {
+            sizes[i] = encode(sent[i], bodies.data() + i * 64);
+            total += sizes[i];
+        }
+    });
+    result.bytes = FrameDecoder::HEADER_SIZE + total / sent.size();
+
+    messages::Position position;
+    float sink = 0.0f;
+    result.decode_ns = ns_per_position(sent.size(), rounds, [&]() {
+        for (size_t i = 0; i < sent.size(); ++i) {
+            decode(bodies.data() + i * 64, sizes[i], position);
+            sink += position.x();
+        }
+    });
+    // so none of it is optimised away
+    if (sink == 12345.0f) fmt::print(" ");
+    return result;
+}
+
+static void print(const char *name, const Result &result) {
+    const double kib_per_second = (double)result.bytes * TRACKERS * TICKS_PER_SECOND / 1024.0;
+    fmt::print("{:>10} {:>8} B {:>10.1f} KiB/s {:>10.1f} ns {:>10.1f} ns\n", name, result.bytes, kib_per_second, result.encode_ns, result.decode_ns);
+}
+
+// one tick's PositionBatch of the first count positions, encoded with encode and parsed back with libprotobuf.
+// the times are per batch.
+template <typename Encode>
+static Result measure_batch(const std::vector<messages::ProtobufMessage> &sent, size_t count, uint64_t rounds, Encode &&encode) {
+    messages::ProtobufMessage batch;
+    for (size_t i = 0; i < count; ++i) {
+        messages::Position &position = *batch.mutable_position_batch()->add_positions();
+        position = sent[i].position();
+        position.set_tracker_id(static_cast<int32_t>(i));
+    }
+    std::vector<uint8_t> body(batch.ByteSizeLong());
+    size_t size = 0;
+    Result result = {};
+    result.encode_ns = ns_per_position(1, rounds, [&]() {
+        size = encode(batch, body.data());
+    });
+    result.bytes = FrameDecoder::HEADER_SIZE + size;
+
+    messages::ProtobufMessage parsed;
+    float sink = 0.0f;
+    result.decode_ns = ns_per_position(1, rounds, [&]() {
+        parsed.ParseFromArray(body.data(), static_cast<int>(size));
+        sink += parsed.position_batch().positions(0).x();
+    });
+    if (sink == 12345.0f) fmt::print(" ");
+    return result;
+}
+
+static void print_batch(size_t count, const char *name, const Result &result, size_t frame_each) {
+    fmt::print("{:>8} {:>10} {:>8} B {:>8} B {:>10.1f} B {:>10.1f} ns {:>10.1f} ns\n",
+        count, name, result.bytes, frame_each * count, (double)result.bytes / count, result.encode_ns, result.decode_ns);
+}
+
+int main(int argc, char *argv[]) {
+    const uint64_t rounds = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+
+    // what the feeder sends for a tracker without velocities: every field of a pose, and the data source
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> metres(-2.0f, 2.0f);
+    std::normal_distribution<float> gaussian;
+    std::vector<messages::ProtobufMessage> sent(256);
+    for (size_t i = 0; i < sent.size(); ++i) {
+        messages::Position &position = *sent[i].mutable_position();
+        float q[4] = {gaussian(rng), gaussian(rng), gaussian(rng), gaussian(rng)};
+        const float norm = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        position.set_tracker_id(static_cast<int32_t>(i % TRACKERS));
+        position.set_x(metres(rng));
+        position.set_y(metres(rng) + 2.0f);
+        position.set_z(metres(rng));
+        position.set_qw(q[0] / norm);
+        position.set_qx(q[1] / norm);
+        position.set_qy(q[2] / norm);
+        position.set_qz(q[3] / norm);
+        position.set_data_source(messages::Position_DataSource_FULL);
+    }
+    const uint64_t timestamp_us = 1234567890;
+
+    fmt::print("{} trackers at {} Hz\n", TRACKERS, TICKS_PER_SECOND);
+    fmt::print("{:>10} {:>10} {:>16} {:>13} {:>13}\n", "format", "frame", "bandwidth", "encode", "decode");
+
+    const auto parse = [](const uint8_t *body, size_t size, messages::Position &position) {
+        messages::ProtobufMessage msg;
+        msg.ParseFromArray(body, static_cast<int>(size));
+        position = msg.position();
+    };
+    print("protobuf", measure(sent, rounds, [](const messages::ProtobufMessage &msg, uint8_t *out) {
+        const size_t size = msg.ByteSizeLong();
+        msg.SerializeToArray(out, static_cast<int>(size));
+        return size;
+    }, parse));
+    // the same bytes as protobuf, so it decodes the same way
+    print("hot", measure(sent, rounds, [](const messages::ProtobufMessage &msg, uint8_t *out) {
+        return HotMessageEncoder::Encode(msg, out);
+    }, parse));
+    print("compact", measure(sent, rounds, [&](const messages::ProtobufMessage &msg, uint8_t *out) {
+        CompactPose::Encode(msg.position(), timestamp_us, out);
+        return CompactPose::BODY_SIZE;
+    }, [](const uint8_t *body, size_t size, messages::Position &position) {
+        uint64_t timestamp;
+        CompactPose::Decode(body, size, position, timestamp);
+    }));
+    print("quantized", measure(sent, rounds, [&](const messages::ProtobufMessage &msg, uint8_t *out) {
+        QuantizedPose::Encode(msg.position(), timestamp_us, out);
+        return QuantizedPose::BODY_SIZE;
+    }, [](const uint8_t *body, size_t size, messages::Position &position) {
+        uint64_t timestamp;
+        QuantizedPose::Decode(body, size, position, timestamp);
+    }));
+
+    // what --position-batch sends instead, the frame for a Position each is the protobuf one above
+    const size_t frame_each = FrameDecoder::HEADER_SIZE + sent[0].ByteSizeLong();
+    fmt::print("\n{:>8} {:>10} {:>10} {:>10} {:>12} {:>13} {:>13}\n", "trackers", "encoder", "batch", "one each", "per tracker", "encode", "parse");
+    for (size_t count: {8, 16, 64}) {
+        // fewer rounds for bigger batches, so each size takes about as long
+        const uint64_t batch_rounds = std::max<uint64_t>(rounds * 16 / count, 1);
+        print_batch(count, "protobuf", measure_batch(sent, count, batch_rounds, [](const messages::ProtobufMessage &msg, uint8_t *out) {
+            const size_t size = msg.ByteSizeLong();
+            msg.SerializeToArray(out, static_cast<int>(size));
+            return size;
+        }), frame_each);
+        print_batch(count, "hot", measure_batch(sent, count, batch_rounds, [](const messages::ProtobufMessage &msg, uint8_t *out) {
+            return HotMessageEncoder::Encode(msg, out);
+        }), frame_each);
+    }
+    return 0;
+}
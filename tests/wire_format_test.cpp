@@ -0,0 +1,336 @@
+// HotMessageEncoder has to produce exactly what libprotobuf does for every message it takes on,
+// the pose records have to bring back everything they carry, and QuantizedPose has to stay within its error bounds.
+// pass the largest QuantizedPose rotation error to accept, in degrees, to check against another bound.
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include "wire_format.hpp"
+#include "test_util.hpp"
+
+// floats the generated code treats specially: -0 is still sent, NaN and infinities are just bits
+static float special_float(std::mt19937 &rng) {
+    static const float values[] = {
+        0.0f, -0.0f, 1.0f, -1.0f,
+        std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::denorm_min(),
+        std::numeric_limits<float>::max(),
+    };
+    std::uniform_int_distribution<size_t> pick(0, std::size(values) * 2);
+    const size_t i = pick(rng);
+    if (i < std::size(values)) return values[i];
+    return std::uniform_real_distribution<float>(-10.0f, 10.0f)(rng);
+}
+
+// negative ids take ten bytes, large ones several
+static int32_t tracker_id(std::mt19937 &rng) {
+    static const int32_t values[] = {0, 1, 127, 128, 16383, 16384, -1, std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min()};
+    std::uniform_int_distribution<size_t> pick(0, std::size(values) - 1);
+    return values[pick(rng)];
+}
+
+// every optional field is set or left unset at random
+static void random_position(std::mt19937 &rng, messages::Position &position) {
+    std::bernoulli_distribution set;
+    position.set_tracker_id(tracker_id(rng));
+    if (set(rng)) position.set_x(special_float(rng));
+    if (set(rng)) position.set_y(special_float(rng));
+    if (set(rng)) position.set_z(special_float(rng));
+    position.set_qx(special_float(rng));
+    position.set_qy(special_float(rng));
+    position.set_qz(special_float(rng));
+    position.set_qw(special_float(rng));
+    if (set(rng)) position.set_data_source(static_cast<messages::Position_DataSource>(std::uniform_int_distribution<int>(0, 3)(rng)));
+    if (set(rng)) position.set_vx(special_float(rng));
+    if (set(rng)) position.set_vy(special_float(rng));
+    if (set(rng)) position.set_vz(special_float(rng));
+    if (set(rng)) position.set_avx(special_float(rng));
+    if (set(rng)) position.set_avy(special_float(rng));
+    if (set(rng)) position.set_avz(special_float(rng));
+    if (set(rng)) position.set_timestamp(std::uniform_int_distribution<uint64_t>()(rng) >> std::uniform_int_distribution<int>(0, 63)(rng));
+}
+
+static void random_message(std::mt19937 &rng, messages::ProtobufMessage &msg) {
+    msg.Clear();
+    switch (std::uniform_int_distribution<int>(0, 2)(rng)) {
+        case 0:
+            random_position(rng, *msg.mutable_position());
+            break;
+        case 1: {
+            const int count = std::uniform_int_distribution<int>(0, 20)(rng);
+            for (int i = 0; i < count; ++i) {
+                random_position(rng, *msg.mutable_position_batch()->add_positions());
+            }
+            // an empty batch still has to be sent, as an empty submessage
+            msg.mutable_position_batch();
+            break;
+        }
+        default: {
+            messages::TrackerStatus &status = *msg.mutable_tracker_status();
+            status.set_tracker_id(tracker_id(rng));
+            status.set_status(static_cast<messages::TrackerStatus_Status>(std::uniform_int_distribution<int>(0, 4)(rng)));
+            if (std::bernoulli_distribution()(rng)) {
+                static const messages::TrackerStatus_Confidence confidences[] = {
+                    messages::TrackerStatus_Confidence_NO, messages::TrackerStatus_Confidence_LOW,
+                    messages::TrackerStatus_Confidence_MEDIUM, messages::TrackerStatus_Confidence_HIGH,
+                };
+                status.set_confidence(confidences[std::uniform_int_distribution<int>(0, 3)(rng)]);
+            }
+            break;
+        }
+    }
+}
+
+static void test_matches_libprotobuf() {
+    // a new field in ProtobufMessages.proto switches the encoder off, it has to be taught the field before this passes
+    CHECK(HotMessageEncoder::MatchesSchema());
+    if (!HotMessageEncoder::MatchesSchema()) {
+        return;
+    }
+
+    std::mt19937 rng(19);
+    messages::ProtobufMessage msg;
+    std::vector<uint8_t> encoded;
+    int mismatches = 0;
+    constexpr int MESSAGES = 100000;
+    for (int i = 0; i < MESSAGES; ++i) {
+        random_message(rng, msg);
+        CHECK(HotMessageEncoder::Handles(msg));
+        const std::string expected = msg.SerializeAsString();
+        const size_t size = HotMessageEncoder::Size(msg);
+        CHECK(size == expected.size());
+
+        // room past the end, so a write beyond Size shows up as a changed guard byte
+        encoded.assign(size + 16, 0xA5);
+        CHECK(HotMessageEncoder::Encode(msg, encoded.data()) == size);
+        CHECK(encoded[size] == 0xA5);
+        if (std::memcmp(encoded.data(), expected.data(), std::min(size, expected.size())) != 0) {
+            mismatches += 1;
+        }
+    }
+    CHECK(mismatches == 0);
+    fmt::print("hot message encoder: {} of {} messages differ from libprotobuf\n", mismatches, MESSAGES);
+}
+
+// extra entries and every other kind of message are left to libprotobuf
+static void test_leaves_the_rest() {
+    messages::ProtobufMessage msg;
+    msg.mutable_tracker_status()->mutable_extra()->insert({"key", "value"});
+    CHECK(!HotMessageEncoder::Handles(msg));
+    msg.mutable_tracker_added()->set_tracker_id(1);
+    CHECK(!HotMessageEncoder::Handles(msg));
+    msg.mutable_user_action()->set_name("reset");
+    CHECK(!HotMessageEncoder::Handles(msg));
+    msg.mutable_ping_pong();
+    CHECK(!HotMessageEncoder::Handles(msg));
+    msg.Clear();
+    CHECK(!HotMessageEncoder::Handles(msg));
+}
+
+// the angle between two rotations, in degrees. neither has to be normalised, and q and -q are the same rotation.
+static double rotation_error(const double a[4], const double b[4]) {
+    double dot = 0.0, norm_a = 0.0, norm_b = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        dot += a[i] * b[i];
+        norm_a += a[i] * a[i];
+        norm_b += b[i] * b[i];
+    }
+    const double cos_half = std::min(1.0, std::abs(dot) / std::sqrt(norm_a * norm_b));
+    return 2.0 * std::acos(cos_half) * 180.0 / 3.14159265358979323846;
+}
+
+// a position with every field the feeder can send, as --send-velocity sends it
+static messages::Position moving_position(int32_t id) {
+    messages::Position position;
+    position.set_tracker_id(id);
+    position.set_data_source(messages::Position_DataSource_FULL);
+    position.set_x(1.5f);
+    position.set_y(-0.25f);
+    position.set_z(3.0f);
+    position.set_qw(0.5f);
+    position.set_qx(-0.5f);
+    position.set_qy(0.5f);
+    position.set_qz(0.5f);
+    position.set_vx(0.125f);
+    position.set_vy(-2.0f);
+    position.set_vz(0.0f);
+    position.set_avx(-0.0f);
+    position.set_avy(6.5f);
+    position.set_avz(-1.0f);
+    position.set_timestamp(0x0123456789ABULL);
+    return position;
+}
+
+// velocities and the timestamp come back from libprotobuf as they went in, on their own and in a batch
+static void test_velocity_round_trip() {
+    messages::ProtobufMessage msg;
+    *msg.mutable_position() = moving_position(5);
+    messages::ProtobufMessage batch;
+    for (int32_t id = 0; id < 3; ++id) {
+        *batch.mutable_position_batch()->add_positions() = moving_position(id);
+    }
+
+    for (const messages::ProtobufMessage *sent: {&msg, &batch}) {
+        CHECK(HotMessageEncoder::Handles(*sent));
+        std::vector<uint8_t> encoded(HotMessageEncoder::Size(*sent));
+        CHECK(HotMessageEncoder::Encode(*sent, encoded.data()) == encoded.size());
+        messages::ProtobufMessage received;
+        CHECK(received.ParseFromArray(encoded.data(), static_cast<int>(encoded.size())));
+        CHECK(received.SerializeAsString() == sent->SerializeAsString());
+
+        const messages::Position &position = received.has_position() ? received.position() : received.position_batch().positions(2);
+        CHECK(position.has_vx() && position.has_vy() && position.has_vz());
+        CHECK(position.has_avx() && position.has_avy() && position.has_avz());
+        CHECK(position.vx() == 0.125f && position.vy() == -2.0f && position.vz() == 0.0f);
+        CHECK(position.avx() == 0.0f && std::signbit(position.avx()) && position.avy() == 6.5f && position.avz() == -1.0f);
+        CHECK(position.timestamp() == 0x0123456789ABULL);
+    }
+}
+
+// CompactPose brings back the tracker, data source, pose and timestamp exactly, QuantizedPose all but the pose exactly.
+// neither has room for velocities, HasVelocity tells the bridge to send those positions as a ProtobufMessage.
+static void test_pose_records() {
+    const messages::Position position = moving_position(-7);
+    CHECK(HasVelocity(position));
+    messages::Position still = position;
+    still.clear_vx();
+    still.clear_vy();
+    still.clear_vz();
+    still.clear_avx();
+    still.clear_avy();
+    CHECK(HasVelocity(still));
+    still.clear_avz();
+    CHECK(!HasVelocity(still));
+
+    const uint64_t timestamp_us = 0xFEDCBA9876543210ULL;
+    uint8_t compact[CompactPose::BODY_SIZE];
+    CompactPose::Encode(position, timestamp_us, compact);
+    messages::Position decoded;
+    uint64_t decoded_timestamp_us = 0;
+    CHECK(CompactPose::Decode(compact, sizeof(compact), decoded, decoded_timestamp_us));
+    CHECK(decoded_timestamp_us == timestamp_us);
+    // the timestamp comes back on its own, not in the Position
+    still.clear_timestamp();
+    CHECK(decoded.SerializeAsString() == still.SerializeAsString());
+    CHECK(!HasVelocity(decoded));
+
+    uint8_t quantized[QuantizedPose::BODY_SIZE];
+    QuantizedPose::Encode(position, timestamp_us, quantized);
+    CHECK(QuantizedPose::Decode(quantized, sizeof(quantized), decoded, decoded_timestamp_us));
+    CHECK(decoded_timestamp_us == timestamp_us);
+    CHECK(decoded.tracker_id() == -7);
+    CHECK(decoded.data_source() == messages::Position_DataSource_FULL);
+    // whole millimetres come back exactly, the rotation within its bound
+    CHECK(decoded.x() == 1.5f && decoded.y() == -0.25f && decoded.z() == 3.0f);
+    const double sent[4] = {position.qw(), position.qx(), position.qy(), position.qz()};
+    const double received[4] = {decoded.qw(), decoded.qx(), decoded.qy(), decoded.qz()};
+    CHECK(rotation_error(sent, received) <= 0.01);
+    CHECK(!HasVelocity(decoded));
+    CHECK(!decoded.has_timestamp());
+}
+
+// random rotations, plus the ones on the edges of the smallest three encoding: identity, a component
+// of exactly 1/sqrt(2) on either side, and ones that aren't normalised
+static std::vector<std::array<float, 4>> test_rotations(size_t count) {
+    const float h = 0.70710678f;
+    std::vector<std::array<float, 4>> rotations = {
+        {1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}, {-1, 0, 0, 0},
+        {h, h, 0, 0}, {h, 0, -h, 0}, {0, 0, h, h}, {0.5f, 0.5f, 0.5f, 0.5f}, {-0.5f, 0.5f, -0.5f, 0.5f},
+        {2, 0, 0, 0}, {0.1f, 0.2f, 0.3f, 0.4f}, {30, -40, 10, 5},
+    };
+    std::mt19937 rng(22);
+    std::normal_distribution<float> gaussian;
+    while (rotations.size() < count) {
+        rotations.push_back({gaussian(rng), gaussian(rng), gaussian(rng), gaussian(rng)});
+    }
+    return rotations;
+}
+
+static void test_quantized_error_bound(double max_rotation_error) {
+    // rounding to the millimetre, plus what a float loses holding the position
+    constexpr double MAX_POSITION_ERROR = 0.0005;
+    const auto position_tolerance = [](float metres) {
+        return MAX_POSITION_ERROR + std::abs(metres) * 2 * std::numeric_limits<float>::epsilon();
+    };
+
+    const std::vector<std::array<float, 4>> rotations = test_rotations(1000000);
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> metres(-100.0f, 100.0f);
+    messages::Position position;
+    messages::Position decoded;
+    uint8_t body[QuantizedPose::BODY_SIZE];
+    double worst_rotation = 0.0;
+    double worst_position = 0.0;
+    for (size_t i = 0; i < rotations.size(); ++i) {
+        const std::array<float, 4> &q = rotations[i];
+        position.set_tracker_id(static_cast<int32_t>(i % 3 == 0 ? -static_cast<int32_t>(i) : static_cast<int32_t>(i)));
+        position.set_data_source(static_cast<messages::Position_DataSource>(i % 4));
+        position.set_x(i % 7 == 0 ? 0.0f : metres(rng));
+        position.set_y(metres(rng));
+        position.set_z(metres(rng));
+        position.set_qw(q[0]);
+        position.set_qx(q[1]);
+        position.set_qy(q[2]);
+        position.set_qz(q[3]);
+        const uint64_t timestamp_us = 0x0123456789ABCDEFULL + i;
+        QuantizedPose::Encode(position, timestamp_us, body);
+
+        uint64_t decoded_timestamp_us = 0;
+        CHECK(QuantizedPose::Is(body, sizeof(body)));
+        CHECK(QuantizedPose::Decode(body, sizeof(body), decoded, decoded_timestamp_us));
+        CHECK(decoded_timestamp_us == timestamp_us);
+        CHECK(decoded.tracker_id() == position.tracker_id());
+        CHECK(decoded.data_source() == position.data_source());
+
+        const double sent[4] = {q[0], q[1], q[2], q[3]};
+        const double received[4] = {decoded.qw(), decoded.qx(), decoded.qy(), decoded.qz()};
+        const double rotation = rotation_error(sent, received);
+        CHECK(rotation <= max_rotation_error);
+        worst_rotation = std::max(worst_rotation, rotation);
+
+        const float axes[3][2] = {{position.x(), decoded.x()}, {position.y(), decoded.y()}, {position.z(), decoded.z()}};
+        for (const auto &axis: axes) {
+            const double error = std::abs(static_cast<double>(axis[0]) - axis[1]);
+            CHECK(error <= position_tolerance(axis[0]));
+            worst_position = std::max(worst_position, error);
+        }
+    }
+    fmt::print("quantized pose: rotation off by at most {:.4f} degrees (allowed {}), position by {:.3f} mm\n",
+        worst_rotation, max_rotation_error, worst_position * 1000.0);
+
+    // nothing sensible to send, but what arrives is still a valid pose: the identity at the origin
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+    position.set_x(nan);
+    position.set_y(inf);
+    position.set_z(-inf);
+    position.set_qw(nan);
+    position.set_qx(0.0f);
+    position.set_qy(0.0f);
+    position.set_qz(0.0f);
+    QuantizedPose::Encode(position, 0, body);
+    uint64_t timestamp_us = 0;
+    CHECK(QuantizedPose::Decode(body, sizeof(body), decoded, timestamp_us));
+    CHECK(decoded.x() == 0.0f && decoded.y() == 0.0f && decoded.z() == 0.0f);
+    CHECK(decoded.qw() == 1.0f && decoded.qx() == 0.0f && decoded.qy() == 0.0f && decoded.qz() == 0.0f);
+}
+
+int main(int argc, char *argv[]) {
+    // what the QuantizedPose documentation promises
+    const double max_rotation_error = argc > 1 ? std::strtod(argv[1], nullptr) : 0.01;
+
+    test_matches_libprotobuf();
+    test_leaves_the_rest();
+    test_velocity_round_trip();
+    test_pose_records();
+    test_quantized_error_bound(max_rotation_error);
+    return test_result();
+}